@@ -203,6 +203,7 @@ static void avconv_cleanup(int ret)
     if (vstats_file)
         fclose(vstats_file);
     av_free(vstats_filename);
+    probe_cache_uninit();
 
     av_freep(&input_streams);
     av_freep(&input_files);
@@ -302,6 +303,40 @@ static void update_sample_fmt(AVCodecContext *dec, AVCodec *dec_codec,
     }
 }
 
+static InputStream *get_input_stream(OutputStream *ost);
+
+/*
+ * Estimate how long ago the input data corresponding to an output packet was
+ * demuxed, by matching the packet timestamp against the timestamps of the
+ * most recently demuxed packets of its source stream.
+ */
+static void update_latency(OutputStream *ost, int64_t dts)
+{
+    OutputFile *of  = output_files[ost->file_index];
+    InputStream *ist = get_input_stream(ost);
+    uint64_t i, nb;
+
+    if (!ist || dts == AV_NOPTS_VALUE)
+        return;
+
+    dts = av_rescale_q(dts, ost->st->time_base, AV_TIME_BASE_Q);
+    if (of->start_time != AV_NOPTS_VALUE)
+        dts += of->start_time;
+
+    nb = FFMIN(ist->nb_demux_times, DEMUX_TIMES_SIZE);
+    for (i = 1; i <= nb; i++) {
+        int idx = (ist->nb_demux_times - i) % DEMUX_TIMES_SIZE;
+
+        if (ist->demux_dts[idx] <= dts) {
+            ost->last_latency   = av_gettime() - ist->demux_time[idx];
+            ost->max_latency    = FFMAX(ost->max_latency, ost->last_latency);
+            ost->total_latency += ost->last_latency;
+            ost->nb_latencies++;
+            break;
+        }
+    }
+}
+
 static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
 {
     AVBitStreamFilterContext *bsfc = ost->bitstream_filters;
@@ -376,6 +411,11 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
         print_error("av_interleaved_write_frame()", ret);
         exit_program(1);
     }
+
+    /* measured once the muxer has returned, so the time spent interleaving
+     * and writing the packet is included */
+    if (low_latency)
+        update_latency(ost, ost->last_mux_dts);
 }
 
 static int check_recording_time(OutputStream *ost)
@@ -843,6 +883,11 @@ static void print_final_stats(int64_t total_size)
             av_log(NULL, AV_LOG_VERBOSE, "%"PRIu64" packets muxed (%"PRIu64" bytes); ",
                    ost->packets_written, ost->data_size);
 
+            if (ost->nb_latencies)
+                av_log(NULL, AV_LOG_VERBOSE, "latency avg %0.1fms max %0.1fms; ",
+                       ost->total_latency / 1000.0 / ost->nb_latencies,
+                       ost->max_latency / 1000.0);
+
             av_log(NULL, AV_LOG_VERBOSE, "\n");
         }
 
@@ -963,6 +1008,32 @@ static void print_report(int is_last_report, int64_t timer_start)
         snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " drop=%d",
                  nb_frames_drop);
 
+    if (!is_last_report) {
+        int64_t queue_size = 0;
+        int nb_queued = 0;
+
+        for (i = 0; i < nb_output_files; i++) {
+            int64_t size;
+            int nb_packets;
+
+            av_interleaved_queue_size(output_files[i]->ctx, &nb_packets, &size);
+            nb_queued  += nb_packets;
+            queue_size += size;
+        }
+        if (nb_queued)
+            snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
+                     " muxq=%d/%0.0fkB", nb_queued, queue_size / 1024.0);
+    }
+
+    if (low_latency) {
+        int64_t latency = 0;
+
+        for (i = 0; i < nb_output_streams; i++)
+            latency = FFMAX(latency, output_streams[i]->last_latency);
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
+                 " latency=%0.0fms", latency / 1000.0);
+    }
+
     av_log(NULL, AV_LOG_INFO, "%s    \r", buf);
 
     fflush(stderr);
@@ -1599,6 +1670,44 @@ static InputStream *get_input_stream(OutputStream *ost)
     return NULL;
 }
 
+/*
+ * We want CFR output if and only if one of those is true:
+ * 1) user specified output framerate with -r
+ * 2) user specified -vsync cfr
+ * 3) output format is CFR and the user didn't force vsync to
+ *    something else than CFR
+ *
+ * in such a case, set ost->frame_rate
+ */
+static void init_output_frame_rate(OutputStream *ost, InputStream *ist,
+                                   AVFormatContext *oc)
+{
+    if (ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+        !ost->frame_rate.num && ist &&
+        (video_sync_method ==  VSYNC_CFR ||
+         (video_sync_method ==  VSYNC_AUTO &&
+          !(oc->oformat->flags & (AVFMT_NOTIMESTAMPS | AVFMT_VARIABLE_FPS))))) {
+        if (ist->framerate.num)
+            ost->frame_rate = ist->framerate;
+        else if (ist->st->avg_frame_rate.num)
+            ost->frame_rate = ist->st->avg_frame_rate;
+        else {
+            av_log(NULL, AV_LOG_WARNING, "Constant framerate requested "
+                   "for the output stream #%d:%d, but no information "
+                   "about the input framerate is available. Falling "
+                   "back to a default value of 25fps. Use the -r option "
+                   "if you want a different framerate.\n",
+                   ost->file_index, ost->index);
+            ost->frame_rate = (AVRational){ 25, 1 };
+        }
+
+        if (ost->enc && ost->enc->supported_framerates && !ost->force_fps) {
+            int idx = av_find_nearest_q_idx(ost->frame_rate, ost->enc->supported_framerates);
+            ost->frame_rate = ost->enc->supported_framerates[idx];
+        }
+    }
+}
+
 static void parse_forced_key_frames(char *kf, OutputStream *ost,
                                     AVCodecContext *avctx)
 {
@@ -1778,45 +1887,34 @@ static int transcode_init(void)
                 ist->decoding_needed = 1;
             ost->encoding_needed = 1;
 
-            /*
-             * We want CFR output if and only if one of those is true:
-             * 1) user specified output framerate with -r
-             * 2) user specified -vsync cfr
-             * 3) output format is CFR and the user didn't force vsync to
-             *    something else than CFR
-             *
-             * in such a case, set ost->frame_rate
-             */
-            if (codec->codec_type == AVMEDIA_TYPE_VIDEO &&
-                !ost->frame_rate.num && ist &&
-                (video_sync_method ==  VSYNC_CFR ||
-                 (video_sync_method ==  VSYNC_AUTO &&
-                  !(oc->oformat->flags & (AVFMT_NOTIMESTAMPS | AVFMT_VARIABLE_FPS))))) {
-                if (ist->framerate.num)
-                    ost->frame_rate = ist->framerate;
-                else if (ist->st->avg_frame_rate.num)
-                    ost->frame_rate = ist->st->avg_frame_rate;
-                else {
-                    av_log(NULL, AV_LOG_WARNING, "Constant framerate requested "
-                           "for the output stream #%d:%d, but no information "
-                           "about the input framerate is available. Falling "
-                           "back to a default value of 25fps. Use the -r option "
-                           "if you want a different framerate.\n",
-                           ost->file_index, ost->index);
-                    ost->frame_rate = (AVRational){ 25, 1 };
-                }
-
-                if (ost->enc && ost->enc->supported_framerates && !ost->force_fps) {
-                    int idx = av_find_nearest_q_idx(ost->frame_rate, ost->enc->supported_framerates);
-                    ost->frame_rate = ost->enc->supported_framerates[idx];
-                }
-            }
+            init_output_frame_rate(ost, ist, oc);
 
             if (!ost->filter &&
                 (codec->codec_type == AVMEDIA_TYPE_VIDEO ||
                  codec->codec_type == AVMEDIA_TYPE_AUDIO)) {
                     FilterGraph *fg;
                     fg = init_simple_filtergraph(ist, ost);
+
+                    /* run the filters common to several outputs of the same
+                     * input stream only once */
+                    for (j = i + 1; j < nb_output_streams; j++) {
+                        OutputStream *ost2 = output_streams[j];
+
+                        if (ost2->filter || ost2->stream_copy || !ost2->enc ||
+                            ost2->attachment_filename ||
+                            get_input_stream(ost2) != ist ||
+                            !can_share_simple_filtergraph(ost, ost2))
+                            continue;
+
+                        av_log(NULL, AV_LOG_VERBOSE, "Output stream #%d:%d "
+                               "shares filters with output stream #%d:%d\n",
+                               ost2->file_index, ost2->index,
+                               ost->file_index, ost->index);
+                        init_output_frame_rate(ost2, ist,
+                                               output_files[ost2->file_index]->ctx);
+                        add_simple_filtergraph_output(fg, ost2);
+                    }
+
                     if (configure_filtergraph(fg)) {
                         av_log(NULL, AV_LOG_FATAL, "Error opening filters!\n");
                         exit_program(1);
@@ -2369,6 +2467,12 @@ static int process_input(void)
         }
     }
 
+    if (low_latency && pkt.dts != AV_NOPTS_VALUE) {
+        int idx = ist->nb_demux_times++ % DEMUX_TIMES_SIZE;
+        ist->demux_dts[idx]  = av_rescale_q(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q);
+        ist->demux_time[idx] = av_gettime();
+    }
+
     ret = output_packet(ist, &pkt);
     if (ret < 0) {
         av_log(NULL, AV_LOG_ERROR, "Error while decoding stream #%d:%d\n",
@@ -2542,10 +2646,73 @@ static int64_t getmaxrss(void)
 #endif
 }
 
+static void run_transcode(void)
+{
+    int64_t ti;
+
+    if (nb_output_files <= 0 && nb_input_files == 0) {
+        show_usage();
+        av_log(NULL, AV_LOG_WARNING, "Use -h to get full help or, even better, run 'man %s'\n", program_name);
+        exit_program(1);
+    }
+
+    /* file converter / grab */
+    if (nb_output_files <= 0) {
+        fprintf(stderr, "At least one output file must be specified\n");
+        exit_program(1);
+    }
+
+    ti = getutime();
+    if (transcode() < 0)
+        exit_program(1);
+    ti = getutime() - ti;
+    if (do_benchmark) {
+        int maxrss = getmaxrss() / 1024;
+        printf("bench: utime=%0.3fs maxrss=%ikB\n", ti / 1000000.0, maxrss);
+    }
+
+    exit_program(0);
+}
+
+#if HAVE_PTHREADS
+/* the inputs are probed concurrently, which opens decoders from several threads */
+static int lockmgr(void **mutex, enum AVLockOp op)
+{
+    pthread_mutex_t **m = (pthread_mutex_t **)mutex;
+
+    switch (op) {
+    case AV_LOCK_CREATE:
+        *m = av_malloc(sizeof(**m));
+        if (!*m || pthread_mutex_init(*m, NULL)) {
+            av_freep(m);
+            return 1;
+        }
+        return 0;
+    case AV_LOCK_OBTAIN:
+        return !!pthread_mutex_lock(*m);
+    case AV_LOCK_RELEASE:
+        return !!pthread_mutex_unlock(*m);
+    case AV_LOCK_DESTROY:
+        pthread_mutex_destroy(*m);
+        av_freep(m);
+        return 0;
+    }
+    return 1;
+}
+#endif
+
+/* run one job of a batch, in its own process */
+static void run_batch_job(int argc, char **argv)
+{
+    if (avconv_parse_options(argc, argv) < 0)
+        exit_program(1);
+
+    run_transcode();
+}
+
 int main(int argc, char **argv)
 {
     int ret;
-    int64_t ti;
 
     register_exit(avconv_cleanup);
 
@@ -2559,6 +2726,9 @@ int main(int argc, char **argv)
     avfilter_register_all();
     av_register_all();
     avformat_network_init();
+#if HAVE_PTHREADS
+    av_lockmgr_register(lockmgr);
+#endif
 
     show_banner();
 
@@ -2567,27 +2737,16 @@ int main(int argc, char **argv)
     if (ret < 0)
         exit_program(1);
 
-    if (nb_output_files <= 0 && nb_input_files == 0) {
-        show_usage();
-        av_log(NULL, AV_LOG_WARNING, "Use -h to get full help or, even better, run 'man %s'\n", program_name);
-        exit_program(1);
-    }
-
-    /* file converter / grab */
-    if (nb_output_files <= 0) {
-        fprintf(stderr, "At least one output file must be specified\n");
-        exit_program(1);
-    }
-
-    ti = getutime();
-    if (transcode() < 0)
-        exit_program(1);
-    ti = getutime() - ti;
-    if (do_benchmark) {
-        int maxrss = getmaxrss() / 1024;
-        printf("bench: utime=%0.3fs maxrss=%ikB\n", ti / 1000000.0, maxrss);
+    if (batch_filename) {
+        if (nb_input_files || nb_output_files) {
+            av_log(NULL, AV_LOG_FATAL, "Input and output files cannot be "
+                   "given together with -batch.\n");
+            exit_program(1);
+        }
+        ret = avconv_run_batch(batch_filename, batch_jobs, run_batch_job);
+        exit_program(ret != 0);
     }
 
-    exit_program(0);
+    run_transcode();
     return 0;
 }
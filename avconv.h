@@ -261,6 +261,13 @@ typedef struct InputStream {
     enum AVPixelFormat hwaccel_pix_fmt;
     enum AVPixelFormat hwaccel_retrieved_pix_fmt;
 
+    /* low latency mode: timestamps (in AV_TIME_BASE) and wallclock times
+     * of the most recently demuxed packets */
+#define DEMUX_TIMES_SIZE 256
+    int64_t demux_dts[DEMUX_TIMES_SIZE];
+    int64_t demux_time[DEMUX_TIMES_SIZE];
+    uint64_t nb_demux_times;
+
     /* stats */
     // combined size of all the packets read
     uint64_t data_size;
@@ -355,6 +362,11 @@ typedef struct OutputStream {
     // number of frames/samples sent to the encoder
     uint64_t frames_encoded;
     uint64_t samples_encoded;
+    // latency between demuxing and muxing, in low latency mode
+    int64_t  last_latency;
+    int64_t  max_latency;
+    int64_t  total_latency;
+    uint64_t nb_latencies;
 } OutputStream;
 
 typedef struct OutputFile {
@@ -382,6 +394,9 @@ extern FilterGraph **filtergraphs;
 extern int        nb_filtergraphs;
 
 extern char *vstats_filename;
+extern char *batch_filename;
+extern int   batch_jobs;
+extern char *probe_cache_filename;
 
 extern float audio_drift_threshold;
 extern float dts_delta_threshold;
@@ -396,8 +411,11 @@ extern int do_pkt_dump;
 extern int copy_ts;
 extern int copy_tb;
 extern int exit_on_error;
+extern int low_latency;
 extern int print_stats;
 extern int qp_hist;
+extern int filter_nbthreads;
+extern int audio_frame_size;
 
 extern const AVIOInterruptCB int_cb;
 
@@ -418,9 +436,33 @@ int configure_filtergraph(FilterGraph *fg);
 int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out);
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist);
 FilterGraph *init_simple_filtergraph(InputStream *ist, OutputStream *ost);
+void add_simple_filtergraph_output(FilterGraph *fg, OutputStream *ost);
+int can_share_simple_filtergraph(OutputStream *ost1, OutputStream *ost2);
 
 int avconv_parse_options(int argc, char **argv);
 
+/**
+ * Run the avconv command lines listed in a file, nb_workers of them at a
+ * time (or as many as there are CPUs if nb_workers is 0).
+ *
+ * @param run_job called in a new process for each job; must not return
+ * @return the number of failed jobs or a negative error code
+ */
+int avconv_run_batch(const char *filename, int nb_workers,
+                     void (*run_job)(int argc, char **argv));
+
+/* probe cache, see avconv_probe.c */
+int  probe_cache_load(const char *filename);
+/**
+ * Set the cached stream parameters of an opened input before probing it.
+ *
+ * @return 1 if the parameters were found in the cache, 0 otherwise
+ */
+int  probe_cache_apply(AVFormatContext *ic);
+int  probe_cache_store(AVFormatContext *ic);
+int  probe_cache_save(const char *filename);
+void probe_cache_uninit(void);
+
 int vdpau_init(AVCodecContext *s);
 int dxva2_init(AVCodecContext *s);
 
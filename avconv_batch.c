@@ -0,0 +1,250 @@
+/*
+ * avconv batch mode
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Each line of the job list is a complete avconv command line without the
+ * program name. The jobs are run in processes forked from the batch process
+ * once all the (de)muxers, codecs and filters are registered, so a job only
+ * pays for parsing its own options and opening its own files.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if HAVE_FORK
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "avconv.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/file.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#if HAVE_FORK
+typedef struct BatchJob {
+    int      line;
+    char   **argv;
+    int      argc;
+    int64_t  start;
+    int64_t  latency;
+    pid_t    pid;
+} BatchJob;
+
+static void free_jobs(BatchJob *jobs, int nb_jobs)
+{
+    int i, j;
+
+    for (i = 0; i < nb_jobs; i++) {
+        for (j = 0; j < jobs[i].argc; j++)
+            av_free(jobs[i].argv[j]);
+        av_free(jobs[i].argv);
+    }
+    av_free(jobs);
+}
+
+/* split a job line into an argument vector, argv[0] is the program name */
+static int split_job_line(BatchJob *job, const char *line)
+{
+    const char *p = line;
+
+    if (!(job->argv = av_mallocz(sizeof(*job->argv) * (strlen(line) / 2 + 3))))
+        return AVERROR(ENOMEM);
+    if (!(job->argv[job->argc++] = av_strdup(program_name)))
+        return AVERROR(ENOMEM);
+
+    while (*p) {
+        if (!(job->argv[job->argc++] = av_get_token(&p, " \t")))
+            return AVERROR(ENOMEM);
+        while (*p == ' ' || *p == '\t')
+            p++;
+    }
+    return 0;
+}
+
+static int read_jobs(const char *filename, BatchJob **jobs, int *nb_jobs)
+{
+    uint8_t *buf;
+    size_t size, pos = 0;
+    int ret, line = 0;
+
+    ret = av_file_map(filename, &buf, &size, 0, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error reading job list %s.\n", filename);
+        return ret;
+    }
+
+    while (pos < size) {
+        size_t len = 0, start;
+        char *str;
+
+        line++;
+        while (pos < size && (buf[pos] == ' ' || buf[pos] == '\t'))
+            pos++;
+        start = pos;
+        while (pos + len < size && buf[pos + len] != '\n' && buf[pos + len] != '\r')
+            len++;
+        pos += len + 1;
+
+        /* skip empty lines and comments */
+        if (!len || buf[start] == '#')
+            continue;
+
+        if ((ret = av_reallocp_array(jobs, *nb_jobs + 1, sizeof(**jobs))) < 0)
+            goto fail;
+        memset(&(*jobs)[*nb_jobs], 0, sizeof(**jobs));
+        (*jobs)[*nb_jobs].line = line;
+        (*nb_jobs)++;
+
+        if (!(str = av_malloc(len + 1))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        memcpy(str, buf + start, len);
+        str[len] = 0;
+
+        ret = split_job_line(&(*jobs)[*nb_jobs - 1], str);
+        av_free(str);
+        if (ret < 0)
+            goto fail;
+    }
+    ret = 0;
+
+fail:
+    av_file_unmap(buf, size);
+    return ret;
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    int64_t la = ((const BatchJob *)a)->latency;
+    int64_t lb = ((const BatchJob *)b)->latency;
+    return (la > lb) - (la < lb);
+}
+
+static double latency_percentile(BatchJob *jobs, int nb_jobs, int percent)
+{
+    return jobs[FFMIN(nb_jobs - 1, nb_jobs * percent / 100)].latency / 1000000.0;
+}
+
+int avconv_run_batch(const char *filename, int nb_workers,
+                     void (*run_job)(int argc, char **argv))
+{
+    BatchJob *jobs = NULL;
+    int nb_jobs = 0, nb_started = 0, nb_running = 0, nb_failed = 0;
+    int64_t start, elapsed;
+    int i, ret;
+
+    if ((ret = read_jobs(filename, &jobs, &nb_jobs)) < 0)
+        goto fail;
+    if (!nb_jobs) {
+        av_log(NULL, AV_LOG_WARNING, "No jobs in %s.\n", filename);
+        goto fail;
+    }
+    if (nb_workers <= 0)
+        nb_workers = av_cpu_count();
+
+    av_log(NULL, AV_LOG_INFO, "Running %d jobs from %s, %d at a time.\n",
+           nb_jobs, filename, nb_workers);
+
+    start = av_gettime();
+    while (nb_started < nb_jobs || nb_running) {
+        int status;
+        pid_t pid;
+
+        while (nb_running < nb_workers && nb_started < nb_jobs) {
+            BatchJob *job = &jobs[nb_started];
+
+            fflush(stdout);
+            fflush(stderr);
+            job->start = av_gettime();
+            job->pid   = fork();
+            if (job->pid < 0) {
+                ret = AVERROR(errno);
+                av_log(NULL, AV_LOG_ERROR, "Cannot start job on line %d.\n",
+                       job->line);
+                if (!nb_running)
+                    goto fail;
+                break;
+            } else if (!job->pid) {
+                /* never returns */
+                run_job(job->argc, job->argv);
+                exit(1);
+            }
+            nb_started++;
+            nb_running++;
+        }
+
+        pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            ret = AVERROR(errno);
+            goto fail;
+        }
+
+        for (i = 0; i < nb_started; i++) {
+            if (jobs[i].pid != pid)
+                continue;
+            jobs[i].latency = av_gettime() - jobs[i].start;
+            if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+                av_log(NULL, AV_LOG_ERROR, "Job on line %d failed.\n",
+                       jobs[i].line);
+                nb_failed++;
+            }
+            nb_running--;
+            break;
+        }
+    }
+
+    elapsed = FFMAX(av_gettime() - start, 1);
+
+    qsort(jobs, nb_jobs, sizeof(*jobs), compare_latency);
+    av_log(NULL, AV_LOG_INFO, "batch: %d jobs, %d failed, %0.3fs, %0.2f jobs/s\n",
+           nb_jobs, nb_failed, elapsed / 1000000.0, nb_jobs * 1000000.0 / elapsed);
+    av_log(NULL, AV_LOG_INFO, "batch: job latency p50=%0.3fs p90=%0.3fs "
+           "p99=%0.3fs max=%0.3fs\n",
+           latency_percentile(jobs, nb_jobs, 50),
+           latency_percentile(jobs, nb_jobs, 90),
+           latency_percentile(jobs, nb_jobs, 99),
+           jobs[nb_jobs - 1].latency / 1000000.0);
+    ret = nb_failed;
+
+fail:
+    free_jobs(jobs, nb_jobs);
+    return ret;
+}
+#else
+int avconv_run_batch(const char *filename, int nb_workers,
+                     void (*run_job)(int argc, char **argv))
+{
+    av_log(NULL, AV_LOG_ERROR, "Batch mode is not supported on this system.\n");
+    return AVERROR(ENOSYS);
+}
+#endif
@@ -105,6 +105,156 @@ FilterGraph *init_simple_filtergraph(InputStream *ist, OutputStream *ost)
     return fg;
 }
 
+void add_simple_filtergraph_output(FilterGraph *fg, OutputStream *ost)
+{
+    GROW_ARRAY(fg->outputs, fg->nb_outputs);
+    if (!(fg->outputs[fg->nb_outputs - 1] = av_mallocz(sizeof(*fg->outputs[0]))))
+        exit(1);
+    fg->outputs[fg->nb_outputs - 1]->ost   = ost;
+    fg->outputs[fg->nb_outputs - 1]->graph = fg;
+
+    ost->filter = fg->outputs[fg->nb_outputs - 1];
+}
+
+/* Return a pointer to the end of the filter starting at p in a linear
+ * filterchain description, i.e. to the separating comma or to the
+ * terminating zero, or NULL if the description is not a plain chain. */
+static const char *skip_chain_filter(const char *p)
+{
+    while (*p && *p != ',') {
+        if (*p == '[' || *p == ';')
+            return NULL;
+        if (*p == '\\' && p[1]) {
+            p++;
+        } else if (*p == '\'') {
+            if (!(p = strchr(p + 1, '\'')))
+                return NULL;
+        }
+        p++;
+    }
+    return p;
+}
+
+static int chain_filter_equal(const char *a, const char *a_end,
+                              const char *b, const char *b_end)
+{
+    while (a < a_end && av_isspace(*a))
+        a++;
+    while (a_end > a && av_isspace(a_end[-1]))
+        a_end--;
+    while (b < b_end && av_isspace(*b))
+        b++;
+    while (b_end > b && av_isspace(b_end[-1]))
+        b_end--;
+
+    return a_end - a == b_end - b && !memcmp(a, b, a_end - a);
+}
+
+/* Return the number of leading filters two linear filterchains have in common,
+ * store the number of those that are not null filters in nb_nontrivial. */
+static int common_chain_prefix(const char *a, const char *b, int *nb_nontrivial)
+{
+    int nb_common = 0;
+
+    *nb_nontrivial = 0;
+    while (*a && *b) {
+        const char *a_end = skip_chain_filter(a);
+        const char *b_end = skip_chain_filter(b);
+
+        if (!a_end || !b_end || !chain_filter_equal(a, a_end, b, b_end))
+            break;
+
+        nb_common++;
+        if (!chain_filter_equal(a, a_end, "null",  "null"  + 4) &&
+            !chain_filter_equal(a, a_end, "anull", "anull" + 5))
+            (*nb_nontrivial)++;
+
+        a = *a_end ? a_end + 1 : a_end;
+        b = *b_end ? b_end + 1 : b_end;
+    }
+    return nb_common;
+}
+
+static const char *skip_chain_filters(const char *p, int nb_filters)
+{
+    while (nb_filters-- > 0) {
+        p = skip_chain_filter(p);
+        if (*p)
+            p++;
+    }
+    return p;
+}
+
+static int dict_equal(AVDictionary *a, AVDictionary *b)
+{
+    AVDictionaryEntry *e = NULL, *t;
+
+    if (av_dict_count(a) != av_dict_count(b))
+        return 0;
+    while ((e = av_dict_get(a, "", e, AV_DICT_IGNORE_SUFFIX)))
+        if (!(t = av_dict_get(b, e->key, NULL, 0)) || strcmp(e->value, t->value))
+            return 0;
+    return 1;
+}
+
+int can_share_simple_filtergraph(OutputStream *ost1, OutputStream *ost2)
+{
+    int nb_nontrivial;
+
+    if (ost1->st->codec->codec_type != ost2->st->codec->codec_type ||
+        ost1->sws_flags != ost2->sws_flags ||
+        !dict_equal(ost1->resample_opts, ost2->resample_opts))
+        return 0;
+
+    common_chain_prefix(ost1->avfilter, ost2->avfilter, &nb_nontrivial);
+    return nb_nontrivial > 0;
+}
+
+/* Build the description of a simple filtergraph feeding several output
+ * streams: the filters common to all the output chains are run once and
+ * their output is split into the remaining per-output filters. */
+static char *describe_shared_filtergraph(FilterGraph *fg)
+{
+    const char *desc = fg->outputs[0]->ost->avfilter;
+    int video = fg->outputs[0]->ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO;
+    int nb_common = INT_MAX, nb_nontrivial, i;
+    AVIOContext *pb;
+    uint8_t *ret;
+
+    for (i = 1; i < fg->nb_outputs; i++)
+        nb_common = FFMIN(nb_common,
+                          common_chain_prefix(desc, fg->outputs[i]->ost->avfilter,
+                                              &nb_nontrivial));
+
+    if (avio_open_dyn_buf(&pb) < 0)
+        return NULL;
+
+    if (nb_common) {
+        const char *end = skip_chain_filters(desc, nb_common - 1);
+        avio_write(pb, desc, skip_chain_filter(end) - desc);
+        avio_w8(pb, ',');
+    }
+    avio_printf(pb, "%s=%d", video ? "split" : "asplit", fg->nb_outputs);
+    for (i = 0; i < fg->nb_outputs; i++)
+        avio_printf(pb, "[shared%d]", i);
+
+    for (i = 0; i < fg->nb_outputs; i++) {
+        const char *rest = skip_chain_filters(fg->outputs[i]->ost->avfilter,
+                                              nb_common);
+
+        avio_printf(pb, ";[shared%d]", i);
+        if (*rest)
+            avio_write(pb, rest, strlen(rest));
+        else
+            avio_printf(pb, "%s", video ? "null" : "anull");
+        avio_printf(pb, "[out%d]", i);
+    }
+    avio_w8(pb, 0);
+    avio_close_dyn_buf(pb, &ret);
+
+    return ret;
+}
+
 static void init_input_filter(FilterGraph *fg, AVFilterInOut *in)
 {
     InputStream *ist = NULL;
@@ -486,11 +636,11 @@ static int configure_input_audio_filter(FilterGraph *fg, InputFilter *ifilter,
     int ret, pad_idx = 0;
 
     snprintf(args, sizeof(args), "time_base=%d/%d:sample_rate=%d:sample_fmt=%s"
-             ":channel_layout=0x%"PRIx64,
+             ":channel_layout=0x%"PRIx64":frame_size=%d",
              1, ist->st->codec->sample_rate,
              ist->st->codec->sample_rate,
              av_get_sample_fmt_name(ist->st->codec->sample_fmt),
-             ist->st->codec->channel_layout);
+             ist->st->codec->channel_layout, audio_frame_size);
     snprintf(name, sizeof(name), "graph %d input from stream %d:%d", fg->index,
              ist->file_index, ist->st->index);
 
@@ -582,10 +732,13 @@ int configure_filtergraph(FilterGraph *fg)
     int ret, i, init = !fg->graph, simple = !fg->graph_desc;
     const char *graph_desc = simple ? fg->outputs[0]->ost->avfilter :
                                       fg->graph_desc;
+    char *shared_desc = NULL;
 
     avfilter_graph_free(&fg->graph);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    if (filter_nbthreads)
+        fg->graph->nb_threads = filter_nbthreads;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -603,12 +756,23 @@ int configure_filtergraph(FilterGraph *fg)
         if (strlen(args))
             args[strlen(args) - 1] = '\0';
         fg->graph->resample_lavr_opts = av_strdup(args);
+
+        if (fg->nb_outputs > 1) {
+            if (!(shared_desc = describe_shared_filtergraph(fg)))
+                return AVERROR(ENOMEM);
+            av_log(NULL, AV_LOG_VERBOSE, "Shared filtergraph for %d output "
+                   "streams: %s\n", fg->nb_outputs, shared_desc);
+            graph_desc = shared_desc;
+        }
     }
 
-    if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
+    ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs);
+    av_freep(&shared_desc);
+    if (ret < 0)
         return ret;
 
-    if (simple && (!inputs || inputs->next || !outputs || outputs->next)) {
+    if (simple && fg->nb_outputs == 1 &&
+        (!inputs || inputs->next || !outputs || outputs->next)) {
         av_log(NULL, AV_LOG_ERROR, "Simple filtergraph '%s' does not have "
                "exactly one input and output.\n", graph_desc);
         return AVERROR(EINVAL);
@@ -625,8 +789,14 @@ int configure_filtergraph(FilterGraph *fg)
     if (!init || simple) {
         /* we already know the mappings between lavfi outputs and output streams,
          * so we can finish the setup */
-        for (cur = outputs, i = 0; cur; cur = cur->next, i++)
-            configure_output_filter(fg, fg->outputs[i], cur);
+        for (cur = outputs, i = 0; cur; cur = cur->next, i++) {
+            OutputFilter *ofilter = fg->outputs[i];
+
+            /* outputs of a shared simple graph are labeled by their index */
+            if (simple && fg->nb_outputs > 1)
+                ofilter = fg->outputs[strtol(cur->name + 3, NULL, 10)];
+            configure_output_filter(fg, ofilter, cur);
+        }
         avfilter_inout_free(&outputs);
 
         if ((ret = avfilter_graph_config(fg->graph, NULL)) < 0)
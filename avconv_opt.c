@@ -40,6 +40,7 @@
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/time.h"
 
 #define MATCH_PER_STREAM_OPT(name, type, outvar, fmtctx, st)\
 {\
@@ -64,6 +65,9 @@ const HWAccel hwaccels[] = {
 };
 
 char *vstats_filename;
+char *batch_filename;
+int   batch_jobs;
+char *probe_cache_filename;
 
 float audio_drift_threshold = 0.1;
 float dts_delta_threshold   = 10;
@@ -77,8 +81,11 @@ int do_pkt_dump       = 0;
 int copy_ts           = 0;
 int copy_tb           = 1;
 int exit_on_error     = 0;
+int low_latency       = 0;
 int print_stats       = 1;
 int qp_hist           = 0;
+int filter_nbthreads  = 0;
+int audio_frame_size  = 0;
 
 static int file_overwrite     = 0;
 static int file_skip          = 0;
@@ -122,7 +129,7 @@ static void init_options(OptionsContext *o)
 {
     memset(o, 0, sizeof(*o));
 
-    o->mux_max_delay  = 0.7;
+    o->mux_max_delay  = low_latency ? 0 : 0.7;
     o->start_time     = AV_NOPTS_VALUE;
     o->recording_time = INT64_MAX;
     o->limit_filesize = UINT64_MAX;
@@ -623,36 +630,44 @@ static void dump_attachment(AVStream *st, const char *filename)
     avio_close(out);
 }
 
-static int open_input_file(OptionsContext *o, const char *filename)
+typedef struct InputProbe {
+    OptionsContext   o;
+    const char      *filename;
+    AVInputFormat   *iformat;
+    AVFormatContext *ic;
+    AVDictionary   **opts;              // codec options for avformat_find_stream_info
+    int              orig_nb_streams;   // number of streams before avformat_find_stream_info
+    int              cached;            // stream parameters taken from the probe cache
+    int              ret;
+    int64_t          probe_time;
+#if HAVE_PTHREADS
+    pthread_t        thread;
+#endif
+} InputProbe;
+
+static void init_input_file(InputProbe *p)
 {
-    InputFile *f;
+    OptionsContext *o = &p->o;
     AVFormatContext *ic;
-    AVInputFormat *file_iformat = NULL;
-    int err, i, ret;
-    int64_t timestamp;
     uint8_t buf[128];
-    AVDictionary **opts;
-    AVDictionary *unused_opts = NULL;
-    AVDictionaryEntry *e = NULL;
-    int orig_nb_streams;                     // number of streams before avformat_find_stream_info
 
     if (o->format) {
-        if (!(file_iformat = av_find_input_format(o->format))) {
+        if (!(p->iformat = av_find_input_format(o->format))) {
             av_log(NULL, AV_LOG_FATAL, "Unknown input format: '%s'\n", o->format);
             exit_program(1);
         }
     }
 
-    if (!strcmp(filename, "-"))
-        filename = "pipe:";
+    if (!strcmp(p->filename, "-"))
+        p->filename = "pipe:";
 
-    using_stdin |= !strncmp(filename, "pipe:", 5) ||
-                    !strcmp(filename, "/dev/stdin");
+    using_stdin |= !strncmp(p->filename, "pipe:", 5) ||
+                    !strcmp(p->filename, "/dev/stdin");
 
     /* get default parameters from command line */
     ic = avformat_alloc_context();
     if (!ic) {
-        print_error(filename, AVERROR(ENOMEM));
+        print_error(p->filename, AVERROR(ENOMEM));
         exit_program(1);
     }
     if (o->nb_audio_sample_rate) {
@@ -663,8 +678,8 @@ static int open_input_file(OptionsContext *o, const char *filename)
         /* because we set audio_channels based on both the "ac" and
          * "channel_layout" options, we need to check that the specified
          * demuxer actually has the "channels" option before setting it */
-        if (file_iformat && file_iformat->priv_class &&
-            av_opt_find(&file_iformat->priv_class, "channels", NULL, 0,
+        if (p->iformat && p->iformat->priv_class &&
+            av_opt_find(&p->iformat->priv_class, "channels", NULL, 0,
                         AV_OPT_SEARCH_FAKE_OBJ)) {
             snprintf(buf, sizeof(buf), "%d",
                      o->audio_channels[o->nb_audio_channels - 1].u.i);
@@ -674,8 +689,8 @@ static int open_input_file(OptionsContext *o, const char *filename)
     if (o->nb_frame_rates) {
         /* set the format-level framerate option;
          * this is important for video grabbers, e.g. x11 */
-        if (file_iformat && file_iformat->priv_class &&
-            av_opt_find(&file_iformat->priv_class, "framerate", NULL, 0,
+        if (p->iformat && p->iformat->priv_class &&
+            av_opt_find(&p->iformat->priv_class, "framerate", NULL, 0,
                         AV_OPT_SEARCH_FAKE_OBJ)) {
             av_dict_set(&o->g->format_opts, "framerate",
                         o->frame_rates[o->nb_frame_rates - 1].u.str, 0);
@@ -688,32 +703,80 @@ static int open_input_file(OptionsContext *o, const char *filename)
         av_dict_set(&o->g->format_opts, "pixel_format", o->frame_pix_fmts[o->nb_frame_pix_fmts - 1].u.str, 0);
 
     ic->flags |= AVFMT_FLAG_NONBLOCK;
+    if (low_latency)
+        ic->flags |= AVFMT_FLAG_NOBUFFER;
     ic->interrupt_callback = int_cb;
 
-    /* open the input file with generic libav function */
-    err = avformat_open_input(&ic, filename, file_iformat, &o->g->format_opts);
-    if (err < 0) {
-        print_error(filename, err);
-        exit_program(1);
-    }
-    assert_avoptions(o->g->format_opts);
+    p->ic = ic;
+}
+
+static void *open_input_thread(void *arg)
+{
+    InputProbe *p = arg;
 
-    /* apply forced codec ids */
-    for (i = 0; i < ic->nb_streams; i++)
-        choose_decoder(o, ic, ic->streams[i]);
+    /* open the input file with generic libav function */
+    p->ret = avformat_open_input(&p->ic, p->filename, p->iformat,
+                                 &p->o.g->format_opts);
+    return NULL;
+}
 
-    /* Set AVCodecContext options for avformat_find_stream_info */
-    opts = setup_find_stream_info_opts(ic, o->g->codec_opts);
-    orig_nb_streams = ic->nb_streams;
+static void *find_stream_info_thread(void *arg)
+{
+    InputProbe *p = arg;
+    int64_t t = av_gettime();
 
     /* If not enough info to get the stream parameters, we decode the
        first frames to get it. (used in mpeg case for example) */
-    ret = avformat_find_stream_info(ic, opts);
-    if (ret < 0) {
+    p->ret = avformat_find_stream_info(p->ic, p->opts);
+    p->probe_time = av_gettime() - t;
+    return NULL;
+}
+
+/* run func on all the inputs, concurrently if possible, since opening and
+ * probing network inputs mostly means waiting for data */
+static void run_input_probes(InputProbe *probes, int nb_probes,
+                             void *(*func)(void *))
+{
+    int i, nb_threads = 0;
+
+#if HAVE_PTHREADS
+    if (nb_probes > 1) {
+        for (; nb_threads < nb_probes; nb_threads++)
+            if (pthread_create(&probes[nb_threads].thread, NULL, func,
+                               &probes[nb_threads]))
+                break;
+    }
+#endif
+    for (i = nb_threads; i < nb_probes; i++)
+        func(&probes[i]);
+#if HAVE_PTHREADS
+    for (i = 0; i < nb_threads; i++)
+        pthread_join(probes[i].thread, NULL);
+#endif
+}
+
+static int open_input_file(InputProbe *p)
+{
+    OptionsContext *o = &p->o;
+    const char *filename = p->filename;
+    AVFormatContext *ic = p->ic;
+    InputFile *f;
+    int i, ret;
+    int64_t timestamp;
+    AVDictionaryEntry *e = NULL;
+    AVDictionary *unused_opts = NULL;
+
+    if (p->ret < 0) {
         av_log(NULL, AV_LOG_FATAL, "%s: could not find codec parameters\n", filename);
         avformat_close_input(&ic);
         exit_program(1);
     }
+    av_log(NULL, AV_LOG_VERBOSE, "%s: probed in %0.3fs%s\n", filename,
+           p->probe_time / 1000000.0, p->cached ? " (cached stream parameters)" : "");
+
+    if (probe_cache_filename && ic->nb_streams == p->orig_nb_streams &&
+        (ret = probe_cache_store(ic)) < 0)
+        return ret;
 
     timestamp = (o->start_time == AV_NOPTS_VALUE) ? 0 : o->start_time;
     /* add the stream start time */
@@ -794,13 +857,102 @@ static int open_input_file(OptionsContext *o, const char *filename)
         }
     }
 
-    for (i = 0; i < orig_nb_streams; i++)
-        av_dict_free(&opts[i]);
-    av_freep(&opts);
+    for (i = 0; i < p->orig_nb_streams; i++)
+        av_dict_free(&p->opts[i]);
+    av_freep(&p->opts);
 
     return 0;
 }
 
+static int open_input_files(OptionGroupList *l)
+{
+    InputProbe *probes;
+    int64_t start = av_gettime();
+    int i, ret = 0;
+
+    if (!l->nb_groups)
+        return 0;
+
+    probes = av_mallocz(sizeof(*probes) * l->nb_groups);
+    if (!probes)
+        return AVERROR(ENOMEM);
+
+    if (probe_cache_filename &&
+        (ret = probe_cache_load(probe_cache_filename)) < 0)
+        goto fail;
+
+    for (i = 0; i < l->nb_groups; i++) {
+        OptionGroup *g = &l->groups[i];
+        InputProbe  *p = &probes[i];
+
+        init_options(&p->o);
+        p->o.g      = g;
+        p->filename = g->arg;
+
+        ret = parse_optgroup(&p->o, g);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error parsing options for input file "
+                   "%s.\n", g->arg);
+            goto fail;
+        }
+
+        av_log(NULL, AV_LOG_DEBUG, "Opening an input file: %s.\n", g->arg);
+        init_input_file(p);
+    }
+
+    run_input_probes(probes, l->nb_groups, open_input_thread);
+
+    for (i = 0; i < l->nb_groups; i++) {
+        InputProbe *p = &probes[i];
+        AVFormatContext *ic = p->ic;
+        int j;
+
+        if (p->ret < 0) {
+            print_error(p->filename, p->ret);
+            exit_program(1);
+        }
+        assert_avoptions(p->o.g->format_opts);
+
+        /* apply forced codec ids */
+        for (j = 0; j < ic->nb_streams; j++)
+            choose_decoder(&p->o, ic, ic->streams[j]);
+
+        if (probe_cache_filename)
+            p->cached = probe_cache_apply(ic);
+
+        /* Set AVCodecContext options for avformat_find_stream_info */
+        p->opts = setup_find_stream_info_opts(ic, p->o.g->codec_opts);
+        p->orig_nb_streams = ic->nb_streams;
+    }
+
+    run_input_probes(probes, l->nb_groups, find_stream_info_thread);
+
+    for (i = 0; i < l->nb_groups; i++) {
+        ret = open_input_file(&probes[i]);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error opening input file %s.\n",
+                   probes[i].filename);
+            goto fail;
+        }
+        av_log(NULL, AV_LOG_DEBUG, "Successfully opened the file.\n");
+    }
+
+    av_log(NULL, AV_LOG_VERBOSE, "Opened %d input files in %0.3fs.\n",
+           l->nb_groups, (av_gettime() - start) / 1000000.0);
+
+    if (probe_cache_filename &&
+        (ret = probe_cache_save(probe_cache_filename)) < 0)
+        av_log(NULL, AV_LOG_WARNING, "Error writing the probe cache %s.\n",
+               probe_cache_filename);
+    ret = 0;
+
+fail:
+    for (i = 0; i < l->nb_groups; i++)
+        uninit_options(&probes[i].o);
+    av_freep(&probes);
+    return ret;
+}
+
 static uint8_t *get_line(AVIOContext *s)
 {
     AVIOContext *line;
@@ -920,6 +1072,12 @@ static OutputStream *new_output_stream(OptionsContext *o, AVFormatContext *oc, e
                    preset, ost->file_index, ost->index);
             exit_program(1);
         }
+
+        /* no reordering delay and no frame threading delay */
+        if (low_latency && type == AVMEDIA_TYPE_VIDEO) {
+            av_dict_set(&ost->opts, "bf",          "0",     AV_DICT_DONT_OVERWRITE);
+            av_dict_set(&ost->opts, "thread_type", "slice", AV_DICT_DONT_OVERWRITE);
+        }
     } else {
         ost->opts = filter_codec_opts(o->g->codec_opts, AV_CODEC_ID_NONE, oc, st, NULL);
     }
@@ -1622,6 +1780,8 @@ loop_end:
     }
     oc->max_delay = (int)(o->mux_max_delay * AV_TIME_BASE);
     oc->flags |= AVFMT_FLAG_NONBLOCK;
+    if (low_latency)
+        oc->flags |= AVFMT_FLAG_FLUSH_PACKETS | AVFMT_FLAG_LOW_LATENCY;
 
     /* copy metadata */
     for (i = 0; i < o->nb_metadata_map; i++) {
@@ -2138,7 +2298,7 @@ int avconv_parse_options(int argc, char **argv)
     }
 
     /* open input files */
-    ret = open_files(&octx.groups[GROUP_INFILE], "input", open_input_file);
+    ret = open_input_files(&octx.groups[GROUP_INFILE]);
     if (ret < 0) {
         av_log(NULL, AV_LOG_FATAL, "Error opening input files: ");
         goto fail;
@@ -2245,6 +2405,8 @@ const OptionDef options[] = {
         "timestamp discontinuity delta threshold", "threshold" },
     { "xerror",         OPT_BOOL | OPT_EXPERT,                       { &exit_on_error },
         "exit on error", "error" },
+    { "low_latency",    OPT_BOOL | OPT_EXPERT,                       { &low_latency },
+        "minimize the latency of the output path and measure it" },
     { "copyinkf",       OPT_BOOL | OPT_EXPERT | OPT_SPEC |
                         OPT_OUTPUT,                                  { .off = OFFSET(copy_initial_nonkeyframes) },
         "copy initial non-keyframes" },
@@ -2267,8 +2429,16 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
         "read complex filtergraph description from a file", "filename" },
+    { "filter_threads", HAS_ARG | OPT_INT | OPT_EXPERT,              { &filter_nbthreads },
+        "number of threads used by each filtergraph (0=auto)", "number" },
     { "stats",          OPT_BOOL,                                    { &print_stats },
         "print progress report during encoding", },
+    { "batch",          HAS_ARG | OPT_STRING | OPT_EXPERT,           { &batch_filename },
+        "run the command lines listed in a file", "filename" },
+    { "batch_jobs",     HAS_ARG | OPT_INT | OPT_EXPERT,              { &batch_jobs },
+        "number of batch jobs to run in parallel", "number" },
+    { "probe_cache",    HAS_ARG | OPT_STRING | OPT_EXPERT,           { &probe_cache_filename },
+        "reuse the stream parameters of known inputs from the given file", "filename" },
     { "attach",         HAS_ARG | OPT_PERFILE | OPT_EXPERT |
                         OPT_OUTPUT,                                  { .func_arg = opt_attach },
         "add an attachment to the output file", "filename" },
@@ -2365,6 +2535,8 @@ const OptionDef options[] = {
         "force audio tag/fourcc", "fourcc/tag" },
     { "vol",            OPT_AUDIO | HAS_ARG  | OPT_INT,                            { &audio_volume },
         "change audio volume (256=normal)" , "volume" },
+    { "filter_frame_size", OPT_AUDIO | HAS_ARG | OPT_INT | OPT_EXPERT,             { &audio_frame_size },
+        "regroup the decoded audio into frames of this many samples before filtering", "samples" },
     { "sample_fmt",     OPT_AUDIO | HAS_ARG  | OPT_EXPERT | OPT_SPEC |
                         OPT_STRING | OPT_INPUT | OPT_OUTPUT,                       { .off = OFFSET(sample_fmts) },
         "set sample format", "format" },
@@ -0,0 +1,380 @@
+/*
+ * avconv probe cache
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The probe cache remembers the stream parameters found by
+ * avformat_find_stream_info() for each input, keyed by its URL and format.
+ * When the same input is opened again with the same streams, the cached
+ * parameters are set before probing, so that avformat_find_stream_info() only
+ * has to read up to the first packet of each stream instead of analyzing the
+ * input until all the parameters are found.
+ *
+ * Each line of the cache file describes one input as a list of key=value
+ * pairs separated by ':', per-stream keys are prefixed with the stream index.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avconv.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/file.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/samplefmt.h"
+
+static AVDictionary **cache_entries;
+static int         nb_cache_entries;
+
+static AVDictionary *find_entry(const char *url, const char *format)
+{
+    int i;
+
+    for (i = 0; i < nb_cache_entries; i++) {
+        AVDictionaryEntry *u = av_dict_get(cache_entries[i], "url",    NULL, 0);
+        AVDictionaryEntry *f = av_dict_get(cache_entries[i], "format", NULL, 0);
+
+        if (u && f && !strcmp(u->value, url) && !strcmp(f->value, format))
+            return cache_entries[i];
+    }
+    return NULL;
+}
+
+static const char *get_str(AVDictionary *entry, int stream, const char *key)
+{
+    AVDictionaryEntry *e;
+    char name[64];
+
+    snprintf(name, sizeof(name), "%d.%s", stream, key);
+    e = av_dict_get(entry, name, NULL, 0);
+    return e ? e->value : NULL;
+}
+
+static int64_t get_int(AVDictionary *entry, int stream, const char *key)
+{
+    const char *val = get_str(entry, stream, key);
+    return val ? strtoll(val, NULL, 10) : 0;
+}
+
+static AVRational get_rational(AVDictionary *entry, int stream, const char *key)
+{
+    const char *val = get_str(entry, stream, key);
+    AVRational q = { 0, 1 };
+
+    if (!val || sscanf(val, "%d/%d", &q.num, &q.den) != 2 || q.den <= 0)
+        return (AVRational){ 0, 1 };
+    return q;
+}
+
+static void set_str(AVDictionary **entry, int stream, const char *key,
+                    const char *val)
+{
+    char name[64];
+
+    if (!val)
+        return;
+    snprintf(name, sizeof(name), "%d.%s", stream, key);
+    av_dict_set(entry, name, val, 0);
+}
+
+static void set_int(AVDictionary **entry, int stream, const char *key,
+                    int64_t val)
+{
+    char buf[32];
+
+    if (!val)
+        return;
+    snprintf(buf, sizeof(buf), "%"PRId64, val);
+    set_str(entry, stream, key, buf);
+}
+
+static void set_rational(AVDictionary **entry, int stream, const char *key,
+                         AVRational q)
+{
+    char buf[32];
+
+    if (!q.num || !q.den)
+        return;
+    snprintf(buf, sizeof(buf), "%d/%d", q.num, q.den);
+    set_str(entry, stream, key, buf);
+}
+
+static int set_extradata(AVCodecContext *avctx, const char *hex)
+{
+    int i, size = strlen(hex) / 2;
+
+    avctx->extradata = av_mallocz(size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!avctx->extradata)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < size; i++) {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            av_freep(&avctx->extradata);
+            return AVERROR_INVALIDDATA;
+        }
+        avctx->extradata[i] = byte;
+    }
+    avctx->extradata_size = size;
+    return 0;
+}
+
+int probe_cache_load(const char *filename)
+{
+    uint8_t *buf;
+    size_t size, pos = 0;
+    int ret;
+
+    /* a missing cache is simply empty */
+    if (av_file_map(filename, &buf, &size, 0, NULL) < 0)
+        return 0;
+
+    while (pos < size) {
+        AVDictionary *entry = NULL;
+        size_t len = 0;
+        char *line;
+
+        while (pos + len < size && buf[pos + len] != '\n')
+            len++;
+        if (!(line = av_malloc(len + 1))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        memcpy(line, buf + pos, len);
+        line[len] = 0;
+        pos += len + 1;
+
+        ret = av_dict_parse_string(&entry, line, "=", ":", 0);
+        av_free(line);
+        if (ret < 0 || !av_dict_get(entry, "url", NULL, 0) ||
+            !av_dict_get(entry, "format", NULL, 0)) {
+            av_dict_free(&entry);
+            continue;
+        }
+
+        if ((ret = av_reallocp_array(&cache_entries, nb_cache_entries + 1,
+                                     sizeof(*cache_entries))) < 0) {
+            nb_cache_entries = 0;
+            av_dict_free(&entry);
+            goto fail;
+        }
+        cache_entries[nb_cache_entries++] = entry;
+    }
+    ret = 0;
+
+fail:
+    av_file_unmap(buf, size);
+    return ret;
+}
+
+int probe_cache_apply(AVFormatContext *ic)
+{
+    AVDictionary *entry = find_entry(ic->filename, ic->iformat->name);
+    AVDictionaryEntry *e;
+    int i;
+
+    if (!entry)
+        return 0;
+
+    /* only use the parameters if the input still has the same streams */
+    e = av_dict_get(entry, "nb_streams", NULL, 0);
+    if (!e || strtol(e->value, NULL, 10) != ic->nb_streams)
+        return 0;
+    for (i = 0; i < ic->nb_streams; i++) {
+        const AVCodecDescriptor *desc;
+        const char *codec = get_str(entry, i, "codec");
+
+        desc = codec ? avcodec_descriptor_get_by_name(codec) : NULL;
+        if (!desc || desc->id != ic->streams[i]->codec->codec_id)
+            return 0;
+    }
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream        *st = ic->streams[i];
+        AVCodecContext *dec = st->codec;
+        const char     *val;
+
+        switch (dec->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            if (!dec->width || !dec->height) {
+                dec->width  = get_int(entry, i, "width");
+                dec->height = get_int(entry, i, "height");
+            }
+            if (dec->pix_fmt == AV_PIX_FMT_NONE &&
+                (val = get_str(entry, i, "pix_fmt")))
+                dec->pix_fmt = av_get_pix_fmt(val);
+            if (!dec->sample_aspect_ratio.num)
+                dec->sample_aspect_ratio = get_rational(entry, i, "sar");
+            if (!dec->has_b_frames)
+                dec->has_b_frames = get_int(entry, i, "has_b_frames");
+            if (!st->avg_frame_rate.num)
+                st->avg_frame_rate = get_rational(entry, i, "avg_frame_rate");
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            if (!dec->sample_rate)
+                dec->sample_rate    = get_int(entry, i, "sample_rate");
+            if (!dec->channels)
+                dec->channels       = get_int(entry, i, "channels");
+            if (!dec->channel_layout)
+                dec->channel_layout = get_int(entry, i, "channel_layout");
+            if (dec->sample_fmt == AV_SAMPLE_FMT_NONE &&
+                (val = get_str(entry, i, "sample_fmt")))
+                dec->sample_fmt = av_get_sample_fmt(val);
+            if (!dec->frame_size)
+                dec->frame_size = get_int(entry, i, "frame_size");
+            break;
+        }
+        if (!dec->bit_rate)
+            dec->bit_rate = get_int(entry, i, "bit_rate");
+        if (dec->profile == FF_PROFILE_UNKNOWN && get_str(entry, i, "profile"))
+            dec->profile = get_int(entry, i, "profile");
+        if (dec->level == FF_LEVEL_UNKNOWN && get_str(entry, i, "level"))
+            dec->level = get_int(entry, i, "level");
+        if (!dec->extradata && (val = get_str(entry, i, "extradata")) &&
+            set_extradata(dec, val) < 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+int probe_cache_store(AVFormatContext *ic)
+{
+    AVDictionary *entry = NULL, *old;
+    char buf[32];
+    int i, j, ret;
+
+    av_dict_set(&entry, "url",    ic->filename,      0);
+    av_dict_set(&entry, "format", ic->iformat->name, 0);
+    snprintf(buf, sizeof(buf), "%d", ic->nb_streams);
+    av_dict_set(&entry, "nb_streams", buf, 0);
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream        *st = ic->streams[i];
+        AVCodecContext *dec = st->codec;
+        const AVCodecDescriptor *desc = avcodec_descriptor_get(dec->codec_id);
+
+        set_str(&entry, i, "codec", desc ? desc->name : "none");
+        switch (dec->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            set_int(&entry, i, "width",  dec->width);
+            set_int(&entry, i, "height", dec->height);
+            set_str(&entry, i, "pix_fmt", av_get_pix_fmt_name(dec->pix_fmt));
+            set_rational(&entry, i, "sar", dec->sample_aspect_ratio);
+            set_int(&entry, i, "has_b_frames", dec->has_b_frames);
+            set_rational(&entry, i, "avg_frame_rate", st->avg_frame_rate);
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            set_int(&entry, i, "sample_rate",    dec->sample_rate);
+            set_int(&entry, i, "channels",       dec->channels);
+            set_int(&entry, i, "channel_layout", dec->channel_layout);
+            set_str(&entry, i, "sample_fmt", av_get_sample_fmt_name(dec->sample_fmt));
+            set_int(&entry, i, "frame_size",     dec->frame_size);
+            break;
+        }
+        set_int(&entry, i, "bit_rate", dec->bit_rate);
+        if (dec->profile != FF_PROFILE_UNKNOWN) {
+            snprintf(buf, sizeof(buf), "%d", dec->profile);
+            set_str(&entry, i, "profile", buf);
+        }
+        if (dec->level != FF_LEVEL_UNKNOWN) {
+            snprintf(buf, sizeof(buf), "%d", dec->level);
+            set_str(&entry, i, "level", buf);
+        }
+        if (dec->extradata_size > 0) {
+            char *hex = av_malloc(2 * dec->extradata_size + 1);
+            if (!hex) {
+                av_dict_free(&entry);
+                return AVERROR(ENOMEM);
+            }
+            for (j = 0; j < dec->extradata_size; j++)
+                snprintf(hex + 2 * j, 3, "%02x", dec->extradata[j]);
+            set_str(&entry, i, "extradata", hex);
+            av_free(hex);
+        }
+    }
+
+    if ((old = find_entry(ic->filename, ic->iformat->name))) {
+        for (i = 0; cache_entries[i] != old; i++)
+            ;
+        av_dict_free(&cache_entries[i]);
+        cache_entries[i] = entry;
+        return 0;
+    }
+
+    if ((ret = av_reallocp_array(&cache_entries, nb_cache_entries + 1,
+                                 sizeof(*cache_entries))) < 0) {
+        nb_cache_entries = 0;
+        av_dict_free(&entry);
+        return ret;
+    }
+    cache_entries[nb_cache_entries++] = entry;
+    return 0;
+}
+
+static void write_escaped(FILE *f, const char *str)
+{
+    for (; *str; str++) {
+        if (strchr("\\:='\"", *str))
+            fputc('\\', f);
+        fputc(*str, f);
+    }
+}
+
+int probe_cache_save(const char *filename)
+{
+    FILE *f = fopen(filename, "w");
+    int i;
+
+    if (!f)
+        return AVERROR(errno);
+
+    for (i = 0; i < nb_cache_entries; i++) {
+        AVDictionaryEntry *e = NULL;
+        int first = 1;
+
+        while ((e = av_dict_get(cache_entries[i], "", e, AV_DICT_IGNORE_SUFFIX))) {
+            if (!first)
+                fputc(':', f);
+            write_escaped(f, e->key);
+            fputc('=', f);
+            write_escaped(f, e->value);
+            first = 0;
+        }
+        fputc('\n', f);
+    }
+
+    return fclose(f) ? AVERROR(errno) : 0;
+}
+
+void probe_cache_uninit(void)
+{
+    int i;
+
+    for (i = 0; i < nb_cache_entries; i++)
+        av_dict_free(&cache_entries[i]);
+    av_freep(&cache_entries);
+    nb_cache_entries = 0;
+}
@@ -269,6 +269,34 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *out;
+    AVFrame **in;       ///< samples read from each active input, or NULL
+    int plane_size;
+} ThreadData;
+
+static int mix_planes(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MixContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int planes = s->planar ? s->nb_channels : 1;
+    int start  = (planes *  jobnr     ) / nb_jobs;
+    int end    = (planes * (jobnr + 1)) / nb_jobs;
+    int i, p;
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        if (!td->in[i])
+            continue;
+        for (p = start; p < end; p++) {
+            s->fdsp.vector_fmac_scalar((float *)td->out->extended_data[p],
+                                       (float *)td->in[i]->extended_data[p],
+                                       s->input_scale[i], td->plane_size);
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Read samples from the input FIFOs, mix, and write to the output link.
  */
@@ -276,7 +304,9 @@ static int output_frame(AVFilterLink *outlink, int nb_samples)
 {
     AVFilterContext *ctx = outlink->src;
     MixContext      *s = ctx->priv;
-    AVFrame *out_buf, *in_buf;
+    AVFrame *out_buf, *in_bufs[32] = { NULL };
+    ThreadData td;
+    int planes = s->planar ? s->nb_channels : 1;
     int i;
 
     calculate_scales(s, nb_samples);
@@ -285,31 +315,30 @@ static int output_frame(AVFilterLink *outlink, int nb_samples)
     if (!out_buf)
         return AVERROR(ENOMEM);
 
-    in_buf = ff_get_audio_buffer(outlink, nb_samples);
-    if (!in_buf) {
-        av_frame_free(&out_buf);
-        return AVERROR(ENOMEM);
-    }
-
     for (i = 0; i < s->nb_inputs; i++) {
         if (s->input_state[i] == INPUT_ON) {
-            int planes, plane_size, p;
+            in_bufs[i] = ff_get_audio_buffer(outlink, nb_samples);
+            if (!in_bufs[i]) {
+                while (i >= 0)
+                    av_frame_free(&in_bufs[i--]);
+                av_frame_free(&out_buf);
+                return AVERROR(ENOMEM);
+            }
 
-            av_audio_fifo_read(s->fifos[i], (void **)in_buf->extended_data,
+            av_audio_fifo_read(s->fifos[i], (void **)in_bufs[i]->extended_data,
                                nb_samples);
-
-            planes     = s->planar ? s->nb_channels : 1;
-            plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
-            plane_size = FFALIGN(plane_size, 16);
-
-            for (p = 0; p < planes; p++) {
-                s->fdsp.vector_fmac_scalar((float *)out_buf->extended_data[p],
-                                           (float *) in_buf->extended_data[p],
-                                           s->input_scale[i], plane_size);
-            }
         }
     }
-    av_frame_free(&in_buf);
+
+    td.out        = out_buf;
+    td.in         = in_bufs;
+    td.plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
+    td.plane_size = FFALIGN(td.plane_size, 16);
+    ctx->internal->execute(ctx, mix_planes, &td, NULL,
+                           ff_audio_nb_jobs(ctx, planes, nb_samples));
+
+    for (i = 0; i < s->nb_inputs; i++)
+        av_frame_free(&in_bufs[i]);
 
     out_buf->pts = s->next_pts;
     if (s->next_pts != AV_NOPTS_VALUE)
@@ -564,5 +593,5 @@ AVFilter ff_af_amix = {
     .inputs    = NULL,
     .outputs   = avfilter_af_amix_outputs,
 
-    .flags     = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags     = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -179,14 +179,42 @@ static float get_volume(CompandContext *s, float in_lin)
     return expf(out_log);
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int compand_channels_nodelay(AVFilterContext *ctx, void *arg,
+                                    int jobnr, int nb_jobs)
+{
+    CompandContext *s    = ctx->priv;
+    ThreadData *td       = arg;
+    const int nb_samples = td->in->nb_samples;
+    int start = (s->nb_channels *  jobnr     ) / nb_jobs;
+    int end   = (s->nb_channels * (jobnr + 1)) / nb_jobs;
+    int chan, i;
+
+    for (chan = start; chan < end; chan++) {
+        const float *src = (float *)td->in->extended_data[chan];
+        float *dst = (float *)td->out->extended_data[chan];
+        ChanParam *cp = &s->channels[chan];
+
+        for (i = 0; i < nb_samples; i++) {
+            update_volume(cp, fabs(src[i]));
+
+            dst[i] = av_clipf(src[i] * get_volume(s, cp->volume), -1.0f, 1.0f);
+        }
+    }
+
+    return 0;
+}
+
 static int compand_nodelay(AVFilterContext *ctx, AVFrame *frame)
 {
     CompandContext *s    = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
-    const int channels   = s->nb_channels;
     const int nb_samples = frame->nb_samples;
     AVFrame *out_frame;
-    int chan, i;
+    ThreadData td;
     int err;
 
     if (av_frame_is_writable(frame)) {
@@ -205,17 +233,10 @@ static int compand_nodelay(AVFilterContext *ctx, AVFrame *frame)
         }
     }
 
-    for (chan = 0; chan < channels; chan++) {
-        const float *src = (float *)frame->extended_data[chan];
-        float *dst = (float *)out_frame->extended_data[chan];
-        ChanParam *cp = &s->channels[chan];
-
-        for (i = 0; i < nb_samples; i++) {
-            update_volume(cp, fabs(src[i]));
-
-            dst[i] = av_clipf(src[i] * get_volume(s, cp->volume), -1.0f, 1.0f);
-        }
-    }
+    td.in  = frame;
+    td.out = out_frame;
+    ctx->internal->execute(ctx, compand_channels_nodelay, &td, NULL,
+                           ff_audio_nb_jobs(ctx, s->nb_channels, frame->nb_samples));
 
     if (frame != out_frame)
         av_frame_free(&frame);
@@ -225,26 +246,21 @@ static int compand_nodelay(AVFilterContext *ctx, AVFrame *frame)
 
 #define MOD(a, b) (((a) >= (b)) ? (a) - (b) : (a))
 
-static int compand_delay(AVFilterContext *ctx, AVFrame *frame)
+static int compand_channels_delay(AVFilterContext *ctx, void *arg,
+                                  int jobnr, int nb_jobs)
 {
     CompandContext *s    = ctx->priv;
-    AVFilterLink *inlink = ctx->inputs[0];
-    const int channels   = s->nb_channels;
-    const int nb_samples = frame->nb_samples;
-    int chan, i, dindex  = 0, oindex, count = 0;
-    AVFrame *out_frame   = NULL;
-    int err;
-
-    if (s->pts == AV_NOPTS_VALUE) {
-        s->pts = (frame->pts == AV_NOPTS_VALUE) ? 0 : frame->pts;
-    }
-
-    for (chan = 0; chan < channels; chan++) {
-        AVFrame *delay_frame = s->delay_frame;
-        const float *src     = (float *)frame->extended_data[chan];
-        float *dbuf          = (float *)delay_frame->extended_data[chan];
-        ChanParam *cp        = &s->channels[chan];
-        float *dst;
+    ThreadData *td       = arg;
+    const int nb_samples = td->in->nb_samples;
+    int start = (s->nb_channels *  jobnr     ) / nb_jobs;
+    int end   = (s->nb_channels * (jobnr + 1)) / nb_jobs;
+    int chan, i, dindex, oindex, count;
+
+    for (chan = start; chan < end; chan++) {
+        const float *src = (float *)td->in->extended_data[chan];
+        float *dbuf      = (float *)s->delay_frame->extended_data[chan];
+        float *dst       = td->out ? (float *)td->out->extended_data[chan] : NULL;
+        ChanParam *cp    = &s->channels[chan];
 
         count  = s->delay_count;
         dindex = s->delay_index;
@@ -252,42 +268,60 @@ static int compand_delay(AVFilterContext *ctx, AVFrame *frame)
             const float in = src[i];
             update_volume(cp, fabs(in));
 
-            if (count >= s->delay_samples) {
-                if (!out_frame) {
-                    out_frame = ff_get_audio_buffer(inlink, nb_samples - i);
-                    if (!out_frame) {
-                        av_frame_free(&frame);
-                        return AVERROR(ENOMEM);
-                    }
-                    err = av_frame_copy_props(out_frame, frame);
-                    if (err < 0) {
-                        av_frame_free(&out_frame);
-                        av_frame_free(&frame);
-                        return err;
-                    }
-                    out_frame->pts = s->pts;
-                    s->pts += av_rescale_q(nb_samples - i,
-                        (AVRational){ 1, inlink->sample_rate },
-                        inlink->time_base);
-                }
-
-                dst = (float *)out_frame->extended_data[chan];
+            if (count >= s->delay_samples)
                 dst[oindex++] = av_clipf(dbuf[dindex] *
                         get_volume(s, cp->volume), -1.0f, 1.0f);
-            } else {
+            else
                 count++;
-            }
 
             dbuf[dindex] = in;
             dindex = MOD(dindex + 1, s->delay_samples);
         }
     }
 
-    s->delay_count = count;
-    s->delay_index = dindex;
+    return 0;
+}
+
+static int compand_delay(AVFilterContext *ctx, AVFrame *frame)
+{
+    CompandContext *s    = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const int nb_samples = frame->nb_samples;
+    /* the samples output once the delay line is full */
+    const int nb_out     = nb_samples -
+                           FFMIN(nb_samples, s->delay_samples - s->delay_count);
+    ThreadData td        = { .in = frame };
+    int err;
+
+    if (s->pts == AV_NOPTS_VALUE) {
+        s->pts = (frame->pts == AV_NOPTS_VALUE) ? 0 : frame->pts;
+    }
+
+    if (nb_out > 0) {
+        td.out = ff_get_audio_buffer(inlink, nb_out);
+        if (!td.out) {
+            av_frame_free(&frame);
+            return AVERROR(ENOMEM);
+        }
+        err = av_frame_copy_props(td.out, frame);
+        if (err < 0) {
+            av_frame_free(&td.out);
+            av_frame_free(&frame);
+            return err;
+        }
+        td.out->pts = s->pts;
+        s->pts += av_rescale_q(nb_out, (AVRational){ 1, inlink->sample_rate },
+                               inlink->time_base);
+    }
+
+    ctx->internal->execute(ctx, compand_channels_delay, &td, NULL,
+                           ff_audio_nb_jobs(ctx, s->nb_channels, nb_samples));
+
+    s->delay_count = FFMIN(s->delay_samples, s->delay_count + nb_samples);
+    s->delay_index = (s->delay_index + nb_samples) % s->delay_samples;
 
     av_frame_free(&frame);
-    return out_frame ? ff_filter_frame(ctx->outputs[0], out_frame) : 0;
+    return td.out ? ff_filter_frame(ctx->outputs[0], td.out) : 0;
 }
 
 static int compand_drain(AVFilterLink *outlink)
@@ -600,4 +634,5 @@ AVFilter ff_af_compand = {
     .uninit         = uninit,
     .inputs         = compand_inputs,
     .outputs        = compand_outputs,
+    .flags          = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -236,10 +236,47 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int plane_samples;
+} ThreadData;
+
+static int scale_planes(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VolumeContext *vol = ctx->priv;
+    ThreadData *td     = arg;
+    int start = (vol->planes *  jobnr     ) / nb_jobs;
+    int end   = (vol->planes * (jobnr + 1)) / nb_jobs;
+    int p;
+
+    if (vol->precision == PRECISION_FIXED) {
+        for (p = start; p < end; p++) {
+            vol->scale_samples(td->out->extended_data[p],
+                               td->in->extended_data[p], td->plane_samples,
+                               vol->volume_i);
+        }
+    } else if (av_get_packed_sample_fmt(vol->sample_fmt) == AV_SAMPLE_FMT_FLT) {
+        for (p = start; p < end; p++) {
+            vol->fdsp.vector_fmul_scalar((float *)td->out->extended_data[p],
+                                         (const float *)td->in->extended_data[p],
+                                         vol->volume, td->plane_samples);
+        }
+    } else {
+        for (p = start; p < end; p++) {
+            vol->fdsp.vector_dmul_scalar((double *)td->out->extended_data[p],
+                                         (const double *)td->in->extended_data[p],
+                                         vol->volume, td->plane_samples);
+        }
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
 {
-    VolumeContext *vol    = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterContext *ctx  = inlink->dst;
+    VolumeContext *vol    = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     int nb_samples        = buf->nb_samples;
     AVFrame *out_buf;
     AVFrameSideData *sd = av_frame_get_side_data(buf, AV_FRAME_DATA_REPLAYGAIN);
@@ -302,32 +339,15 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
     }
 
     if (vol->precision != PRECISION_FIXED || vol->volume_i > 0) {
-        int p, plane_samples;
+        ThreadData td = { .in = buf, .out = out_buf };
 
         if (av_sample_fmt_is_planar(buf->format))
-            plane_samples = FFALIGN(nb_samples, vol->samples_align);
+            td.plane_samples = FFALIGN(nb_samples, vol->samples_align);
         else
-            plane_samples = FFALIGN(nb_samples * vol->channels, vol->samples_align);
+            td.plane_samples = FFALIGN(nb_samples * vol->channels, vol->samples_align);
 
-        if (vol->precision == PRECISION_FIXED) {
-            for (p = 0; p < vol->planes; p++) {
-                vol->scale_samples(out_buf->extended_data[p],
-                                   buf->extended_data[p], plane_samples,
-                                   vol->volume_i);
-            }
-        } else if (av_get_packed_sample_fmt(vol->sample_fmt) == AV_SAMPLE_FMT_FLT) {
-            for (p = 0; p < vol->planes; p++) {
-                vol->fdsp.vector_fmul_scalar((float *)out_buf->extended_data[p],
-                                             (const float *)buf->extended_data[p],
-                                             vol->volume, plane_samples);
-            }
-        } else {
-            for (p = 0; p < vol->planes; p++) {
-                vol->fdsp.vector_dmul_scalar((double *)out_buf->extended_data[p],
-                                             (const double *)buf->extended_data[p],
-                                             vol->volume, plane_samples);
-            }
-        }
+        ctx->internal->execute(ctx, scale_planes, &td, NULL,
+                               ff_audio_nb_jobs(ctx, vol->planes, nb_samples));
     }
 
     emms_c();
@@ -365,4 +385,5 @@ AVFilter ff_af_volume = {
     .init           = init,
     .inputs         = avfilter_af_volume_inputs,
     .outputs        = avfilter_af_volume_outputs,
+    .flags          = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -21,8 +21,20 @@
 
 #include "audio.h"
 #include "avfilter.h"
+#include "framepool.h"
 #include "internal.h"
 
+/* minimal number of samples for a job to be worth running in a thread */
+#define MIN_SAMPLES_PER_JOB 4096
+
+int ff_audio_nb_jobs(AVFilterContext *ctx, int nb_planes, int nb_samples)
+{
+    int nb_jobs = FFMIN(ctx->graph->nb_threads, nb_planes);
+    int64_t total = (int64_t)nb_planes * nb_samples;
+
+    return FFMAX(1, FFMIN(nb_jobs, total / MIN_SAMPLES_PER_JOB));
+}
+
 AVFrame *ff_null_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     return ff_get_audio_buffer(link->dst->outputs[0], nb_samples);
@@ -30,22 +42,15 @@ AVFrame *ff_null_get_audio_buffer(AVFilterLink *link, int nb_samples)
 
 AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
-    AVFrame *frame = av_frame_alloc();
+    AVFrame *frame;
     int channels = av_get_channel_layout_nb_channels(link->channel_layout);
-    int ret;
 
+    frame = ff_frame_pool_get_audio(&link->frame_pool, link->format,
+                                    link->channel_layout, nb_samples);
     if (!frame)
         return NULL;
 
-    frame->nb_samples     = nb_samples;
-    frame->format         = link->format;
-    frame->channel_layout = link->channel_layout;
-    frame->sample_rate    = link->sample_rate;
-    ret = av_frame_get_buffer(frame, 0);
-    if (ret < 0) {
-        av_frame_free(&frame);
-        return NULL;
-    }
+    frame->sample_rate = link->sample_rate;
 
     av_samples_set_silence(frame->extended_data, 0, nb_samples, channels,
                            link->format);
@@ -58,7 +63,8 @@ AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *ret = NULL;
 
-    if (link->dstpad->get_audio_buffer)
+    /* see ff_get_video_buffer() */
+    if (link->dstpad->get_audio_buffer && !link->pipeline)
         ret = link->dstpad->get_audio_buffer(link, nb_samples);
 
     if (!ret)
@@ -38,4 +38,17 @@ AVFrame *ff_null_get_audio_buffer(AVFilterLink *link, int nb_samples);
  */
 AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples);
 
+/**
+ * Get the number of jobs to split the processing of planar audio into, one
+ * or more planes per job.
+ *
+ * Small frames are not split, as waking up the threads would cost more than
+ * processing them.
+ *
+ * @param ctx        the filter processing the audio
+ * @param nb_planes  the number of planes of the frame
+ * @param nb_samples the number of samples in each plane
+ */
+int ff_audio_nb_jobs(AVFilterContext *ctx, int nb_planes, int nb_samples);
+
 #endif /* AVFILTER_AUDIO_H */
@@ -32,6 +32,7 @@
 #include "audio.h"
 #include "avfilter.h"
 #include "formats.h"
+#include "framepool.h"
 #include "internal.h"
 #include "video.h"
 
@@ -241,10 +242,20 @@ void ff_dlog_link(void *ctx, AVFilterLink *link, int end)
     }
 }
 
+static int filter_frame_direct(AVFilterLink *link, AVFrame *frame);
+
 int ff_request_frame(AVFilterLink *link)
 {
     FF_DPRINTF_START(NULL, request_frame); ff_dlog_link(NULL, link, 1);
 
+    if (link->pipeline) {
+        AVFrame *frame;
+        int ret = ff_pipeline_get_frame(link->pipeline, &frame);
+        if (ret < 0)
+            return ret;
+        return filter_frame_direct(link, frame);
+    }
+
     if (link->srcpad->request_frame)
         return link->srcpad->request_frame(link);
     else if (link->src->inputs[0])
@@ -256,6 +267,9 @@ int ff_poll_frame(AVFilterLink *link)
 {
     int i, min = INT_MAX;
 
+    if (link->pipeline)
+        return ff_pipeline_poll_frame(link->pipeline);
+
     if (link->srcpad->poll_frame)
         return link->srcpad->poll_frame(link);
 
@@ -360,8 +374,9 @@ static const AVClass *filter_child_class_next(const AVClass *prev)
 #define FLAGS AV_OPT_FLAG_VIDEO_PARAM
 static const AVOption avfilter_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
-        { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
-        { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .unit = "thread_type" },
+        { .i64 = AVFILTER_THREAD_SLICE | AVFILTER_THREAD_PIPELINE }, 0, INT_MAX, FLAGS, "thread_type" },
+        { "slice",    NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE    }, .unit = "thread_type" },
+        { "pipeline", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_PIPELINE }, .unit = "thread_type" },
     { NULL },
 };
 
@@ -485,6 +500,17 @@ static void free_link(AVFilterLink *link)
     ff_formats_unref(&link->out_samplerates);
     ff_channel_layouts_unref(&link->in_channel_layouts);
     ff_channel_layouts_unref(&link->out_channel_layouts);
+
+    if (link->frame_pool && link->frame_pool->nb_requested) {
+        FFFramePool *pool = link->frame_pool;
+        av_log(link->dst, AV_LOG_VERBOSE, "Input link from %s: %"PRIu64" "
+               "buffers used, %"PRIu64" allocated, %0.1f%% pool hit rate\n",
+               link->src ? link->src->filter->name : "(unknown)",
+               pool->nb_requested, pool->nb_allocated,
+               100.0 * (pool->nb_requested - pool->nb_allocated) / pool->nb_requested);
+    }
+    ff_frame_pool_uninit(&link->frame_pool);
+
     av_freep(&link);
 }
 
@@ -560,7 +586,7 @@ int avfilter_init_filter(AVFilterContext *filter, const char *args, void *opaque
 
 int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
-    int ret = 0;
+    int ret = 0, thread_type;
 
     ret = av_opt_set_dict(ctx, options);
     if (ret < 0) {
@@ -568,14 +594,16 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
         return ret;
     }
 
+    thread_type      = ctx->thread_type & ctx->graph->thread_type;
+    ctx->thread_type = 0;
     if (ctx->filter->flags & AVFILTER_FLAG_SLICE_THREADS &&
-        ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
+        thread_type & AVFILTER_THREAD_SLICE &&
         ctx->graph->internal->thread_execute) {
-        ctx->thread_type       = AVFILTER_THREAD_SLICE;
+        ctx->thread_type      |= AVFILTER_THREAD_SLICE;
         ctx->internal->execute = ctx->graph->internal->thread_execute;
-    } else {
-        ctx->thread_type = 0;
     }
+    if (thread_type & AVFILTER_THREAD_PIPELINE)
+        ctx->thread_type |= AVFILTER_THREAD_PIPELINE;
 
     if (ctx->filter->priv_class) {
         ret = av_opt_set_dict(ctx->priv, options);
@@ -725,7 +753,7 @@ static int default_filter_frame(AVFilterLink *link, AVFrame *frame)
     return ff_filter_frame(link->dst->outputs[0], frame);
 }
 
-int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
+static int filter_frame_direct(AVFilterLink *link, AVFrame *frame)
 {
     int (*filter_frame)(AVFilterLink *, AVFrame *);
     AVFilterPad *dst = link->dstpad;
@@ -790,6 +818,16 @@ fail:
     return ret;
 }
 
+int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
+{
+    /* the frame is passed to the destination filter by the thread
+     * requesting it */
+    if (link->pipeline)
+        return ff_pipeline_queue_frame(link->pipeline, frame);
+
+    return filter_frame_direct(link, frame);
+}
+
 const AVClass *avfilter_get_class(void)
 {
     return &avfilter_class;
@@ -557,6 +557,16 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Run different filters of the graph concurrently, on consecutive frames.
+ * The filters upstream of a pipeline stage are run by a thread of their own,
+ * so once the graph is configured they must only be accessed through the
+ * buffersrc and buffersink functions until it is freed. The sinks may return
+ * AVERROR(EAGAIN) while the input added so far is still being filtered, and
+ * only wait for those frames once the end of the input has been signalled.
+ */
+#define AVFILTER_THREAD_PIPELINE (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -683,6 +693,18 @@ struct AVFilterLink {
         AVLINK_STARTINIT,       ///< started, but incomplete
         AVLINK_INIT             ///< complete
     } init_state;
+
+    /**
+     * Pools of the buffers allocated by default for the frames sent over
+     * this link.
+     */
+    struct FFFramePool *frame_pool;
+
+    /**
+     * Pipeline stage ended by this link, NULL if the filters on both sides
+     * of the link are run by the same thread.
+     */
+    struct FFPipelineStage *pipeline;
 };
 
 /**
@@ -965,6 +987,9 @@ typedef struct AVFilterGraph {
      * bit AND with AVFilterContext.thread_type to get the final mask used for
      * determining allowed threading types. I.e. a threading type needs to be
      * set in both to be allowed.
+     *
+     * AVFILTER_THREAD_PIPELINE is not allowed by default, since it makes the
+     * filters upstream of a pipeline stage run ahead of the caller.
      */
     int thread_type;
 
@@ -31,6 +31,7 @@
 #include "libavutil/internal.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
 
 #include "avfilter.h"
 #include "formats.h"
@@ -42,7 +43,8 @@
 static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
-        { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "slice",    NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE    }, .flags = FLAGS, .unit = "thread_type" },
+        { "pipeline", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_PIPELINE }, .flags = FLAGS, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, FLAGS },
     { NULL },
@@ -66,6 +68,35 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_pipeline_init(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+void ff_graph_pipeline_uninit(AVFilterGraph *graph)
+{
+}
+
+int ff_pipeline_queue_frame(FFPipelineStage *s, AVFrame *frame)
+{
+    av_frame_free(&frame);
+    return AVERROR(ENOSYS);
+}
+
+int ff_pipeline_get_frame(FFPipelineStage *s, AVFrame **frame)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_pipeline_input_added(AVFilterContext *src, int eof)
+{
+}
+
+int ff_pipeline_poll_frame(FFPipelineStage *s)
+{
+    return AVERROR(ENOSYS);
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -104,6 +135,8 @@ void avfilter_graph_free(AVFilterGraph **graph)
     if (!*graph)
         return;
 
+    ff_graph_pipeline_uninit(*graph);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
@@ -725,6 +758,186 @@ static void swap_sample_fmts(AVFilterGraph *graph)
 
 }
 
+/* cost of a conversion which can not be done */
+#define PIX_FMT_COST_MAX (1 << 24)
+
+static int chroma_resample_cost(int src_log2, int dst_log2)
+{
+    /* reducing the chroma resolution loses information, increasing it
+     * only costs the interpolation */
+    return dst_log2 > src_log2 ? 512 * (dst_log2 - src_log2) :
+                                  32 * (src_log2 - dst_log2);
+}
+
+/**
+ * Estimate the cost of converting a video frame between two pixel formats.
+ *
+ * Losing alpha, color, chroma resolution or bit depth weighs much more than
+ * the amount of memory the conversion has to go through.
+ */
+static int pix_fmt_conversion_cost(enum AVPixelFormat src,
+                                   enum AVPixelFormat dst)
+{
+    const AVPixFmtDescriptor *s = av_pix_fmt_desc_get(src);
+    const AVPixFmtDescriptor *d = av_pix_fmt_desc_get(dst);
+    int s_depth = 0, d_depth = 0, cost, i;
+
+    if (src == dst)
+        return 0;
+    if (!s || !d || (s->flags | d->flags) & AV_PIX_FMT_FLAG_HWACCEL)
+        return PIX_FMT_COST_MAX;
+
+    for (i = 0; i < s->nb_components; i++)
+        s_depth = FFMAX(s_depth, s->comp[i].depth_minus1 + 1);
+    for (i = 0; i < d->nb_components; i++)
+        d_depth = FFMAX(d_depth, d->comp[i].depth_minus1 + 1);
+
+    /* memory bandwidth */
+    cost = 16 + (av_get_bits_per_pixel(s) + av_get_bits_per_pixel(d)) / 4;
+
+    if ((s->flags & AV_PIX_FMT_FLAG_ALPHA) && !(d->flags & AV_PIX_FMT_FLAG_ALPHA))
+        cost += 4096;
+    if (s->nb_components >= 3 && d->nb_components < 3)
+        cost += 8192;
+    if ((d->flags & AV_PIX_FMT_FLAG_PAL) && !(s->flags & AV_PIX_FMT_FLAG_PAL))
+        cost += 2048;
+
+    if (d_depth < s_depth)
+        cost += 256 * (s_depth - d_depth);
+    else
+        cost +=   4 * (d_depth - s_depth);
+
+    if ((s->flags ^ d->flags) & AV_PIX_FMT_FLAG_RGB)
+        cost += 128;
+
+    if (s->nb_components >= 3 && d->nb_components >= 3)
+        cost += chroma_resample_cost(s->log2_chroma_w, d->log2_chroma_w) +
+                chroma_resample_cost(s->log2_chroma_h, d->log2_chroma_h);
+
+    return cost;
+}
+
+/**
+ * Compute the cost of the conversions done by the single input filters
+ * between the links using the format list fmts, if it were reduced to fmt,
+ * and their adjacent links, with the formats currently preferred for them.
+ */
+static int64_t pix_fmts_cost(AVFilterGraph *graph, AVFilterFormats *fmts,
+                             int fmt)
+{
+    int64_t cost = 0;
+    int i, j;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        AVFilterFormats *in_fmts;
+
+        if (filter->nb_inputs != 1 ||
+            filter->inputs[0]->type != AVMEDIA_TYPE_VIDEO ||
+            !(in_fmts = filter->inputs[0]->in_formats) ||
+            !in_fmts->nb_formats)
+            continue;
+
+        for (j = 0; j < filter->nb_outputs; j++) {
+            AVFilterFormats *out_fmts = filter->outputs[j]->in_formats;
+
+            if (filter->outputs[j]->type != AVMEDIA_TYPE_VIDEO ||
+                !out_fmts || !out_fmts->nb_formats || out_fmts == in_fmts)
+                continue;
+
+            if (in_fmts == fmts)
+                cost += pix_fmt_conversion_cost(fmt, out_fmts->formats[0]);
+            else if (out_fmts == fmts)
+                cost += pix_fmt_conversion_cost(in_fmts->formats[0], fmt);
+        }
+    }
+
+    return cost;
+}
+
+/**
+ * Move the pixel format leading to the cheapest conversions to the front of
+ * the format lists of the video links.
+ *
+ * Each list is in turn set to its cheapest format given the current choice
+ * for the others, until no choice changes anymore. Every change lowers the
+ * total cost of the conversions, so this settles quickly.
+ */
+static void swap_pix_fmts(AVFilterGraph *graph)
+{
+    int i, j, k, pass, changed;
+
+    for (pass = 0; pass < 16; pass++) {
+        changed = 0;
+
+        for (i = 0; i < graph->nb_filters; i++) {
+            AVFilterContext *filter = graph->filters[i];
+
+            for (j = 0; j < filter->nb_outputs; j++) {
+                AVFilterFormats *fmts = filter->outputs[j]->in_formats;
+                int64_t best_cost;
+                int best_idx = 0;
+
+                if (filter->outputs[j]->type != AVMEDIA_TYPE_VIDEO ||
+                    !fmts || fmts->nb_formats < 2)
+                    continue;
+
+                best_cost = pix_fmts_cost(graph, fmts, fmts->formats[0]);
+                for (k = 1; k < fmts->nb_formats && best_cost; k++) {
+                    int64_t cost = pix_fmts_cost(graph, fmts, fmts->formats[k]);
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_idx  = k;
+                    }
+                }
+
+                if (best_idx) {
+                    FFSWAP(int, fmts->formats[0], fmts->formats[best_idx]);
+                    changed = 1;
+                }
+            }
+        }
+
+        if (!changed)
+            break;
+    }
+}
+
+/**
+ * Log the formats picked for the video links, with the estimated cost of the
+ * conversion done by the filter producing each of them.
+ */
+static void dump_pix_fmts_cost(AVFilterGraph *graph)
+{
+    int64_t total = 0;
+    int i, j;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+
+        for (j = 0; j < filter->nb_outputs; j++) {
+            AVFilterLink *link = filter->outputs[j];
+            int cost = 0;
+
+            if (link->type != AVMEDIA_TYPE_VIDEO)
+                continue;
+            if (filter->nb_inputs == 1 &&
+                filter->inputs[0]->type == AVMEDIA_TYPE_VIDEO)
+                cost = pix_fmt_conversion_cost(filter->inputs[0]->format,
+                                               link->format);
+            total += cost;
+
+            av_log(graph, AV_LOG_VERBOSE,
+                   "Link '%s' -> '%s': %s, conversion cost %d\n",
+                   link->src->name, link->dst->name,
+                   av_get_pix_fmt_name(link->format), cost);
+        }
+    }
+
+    av_log(graph, AV_LOG_VERBOSE,
+           "Estimated pixel format conversion cost: %"PRId64"\n", total);
+}
+
 static int pick_formats(AVFilterGraph *graph)
 {
     int i, j, ret;
@@ -764,9 +977,15 @@ static int graph_config_formats(AVFilterGraph *graph, AVClass *log_ctx)
     swap_samplerates(graph);
     swap_channel_layouts(graph);
 
+    /* for video filters, pick the formats leading to the cheapest
+     * conversions */
+    swap_pix_fmts(graph);
+
     if ((ret = pick_formats(graph)) < 0)
         return ret;
 
+    dump_pix_fmts_cost(graph);
+
     return 0;
 }
 
@@ -820,6 +1039,8 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_links(graphctx, log_ctx)))
         return ret;
+    if ((ret = ff_graph_pipeline_init(graphctx)) < 0)
+        return ret;
 
     return 0;
 }
@@ -25,12 +25,16 @@
 
 #include <float.h>
 
+#include "config.h"
+
+#include "libavutil/audio_fifo.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
+#include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/samplefmt.h"
 #include "audio.h"
@@ -38,8 +42,15 @@
 #include "buffersrc.h"
 #include "formats.h"
 #include "internal.h"
+#include "thread.h"
 #include "video.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#elif HAVE_W32THREADS
+#include "compat/w32pthreads.h"
+#endif
+
 typedef struct BufferSourceContext {
     const AVClass    *class;
     AVFifoBuffer     *fifo;
@@ -58,7 +69,20 @@ typedef struct BufferSourceContext {
     uint64_t channel_layout;
     char    *channel_layout_str;
 
+    /* regrouping of the samples into frames of frame_size samples */
+    int frame_size;
+    AVAudioFifo *audio_fifo;
+    int64_t next_pts;           ///< timestamp of the first sample in audio_fifo
+    int queued_samples;         ///< samples in the frames of fifo
+
     int eof;
+
+#if HAVE_THREADS
+    /* the frames are read by a pipeline stage thread if the graph is
+     * pipelined */
+    pthread_mutex_t lock;
+    int lock_init;
+#endif
 } BufferSourceContext;
 
 #define CHECK_VIDEO_PARAM_CHANGE(s, c, width, height, format)\
@@ -74,6 +98,31 @@ typedef struct BufferSourceContext {
         return AVERROR(EINVAL);\
     }
 
+static void fifo_lock(BufferSourceContext *s)
+{
+#if HAVE_THREADS
+    pthread_mutex_lock(&s->lock);
+#endif
+}
+
+static void fifo_unlock(BufferSourceContext *s)
+{
+#if HAVE_THREADS
+    pthread_mutex_unlock(&s->lock);
+#endif
+}
+
+static int fifo_init(BufferSourceContext *s)
+{
+    if (!(s->fifo = av_fifo_alloc(sizeof(AVFrame*))))
+        return AVERROR(ENOMEM);
+#if HAVE_THREADS
+    pthread_mutex_init(&s->lock, NULL);
+    s->lock_init = 1;
+#endif
+    return 0;
+}
+
 int attribute_align_arg av_buffersrc_write_frame(AVFilterContext *ctx, const AVFrame *frame)
 {
     AVFrame *copy;
@@ -97,7 +146,10 @@ int attribute_align_arg av_buffersrc_add_frame(AVFilterContext *ctx,
     int refcounted, ret;
 
     if (!frame) {
+        fifo_lock(s);
         s->eof = 1;
+        fifo_unlock(s);
+        ff_pipeline_input_added(ctx, 1);
         return 0;
     } else if (s->eof)
         return AVERROR(EINVAL);
@@ -117,11 +169,6 @@ int attribute_align_arg av_buffersrc_add_frame(AVFilterContext *ctx,
         return AVERROR(EINVAL);
     }
 
-    if (!av_fifo_space(s->fifo) &&
-        (ret = av_fifo_realloc2(s->fifo, av_fifo_size(s->fifo) +
-                                         sizeof(copy))) < 0)
-        return ret;
-
     if (!(copy = av_frame_alloc()))
         return AVERROR(ENOMEM);
 
@@ -135,13 +182,23 @@ int attribute_align_arg av_buffersrc_add_frame(AVFilterContext *ctx,
         }
     }
 
-    if ((ret = av_fifo_generic_write(s->fifo, &copy, sizeof(copy), NULL)) < 0) {
+    fifo_lock(s);
+    ret = av_fifo_space(s->fifo) ? 0 :
+          av_fifo_realloc2(s->fifo, av_fifo_size(s->fifo) + sizeof(copy));
+    if (ret >= 0)
+        ret = av_fifo_generic_write(s->fifo, &copy, sizeof(copy), NULL);
+    if (ret >= 0 && ctx->outputs[0]->type == AVMEDIA_TYPE_AUDIO)
+        s->queued_samples += copy->nb_samples;
+    fifo_unlock(s);
+    if (ret < 0) {
         if (refcounted)
             av_frame_move_ref(frame, copy);
         av_frame_free(&copy);
         return ret;
     }
 
+    ff_pipeline_input_added(ctx, 0);
+
     return 0;
 }
 
@@ -167,7 +224,10 @@ int av_buffersrc_buffer(AVFilterContext *ctx, AVFilterBufferRef *buf)
     int ret = 0, planes, i;
 
     if (!buf) {
+        fifo_lock(s);
         s->eof = 1;
+        fifo_unlock(s);
+        ff_pipeline_input_added(ctx, 1);
         return 0;
     } else if (s->eof)
         return AVERROR(EINVAL);
@@ -270,7 +330,7 @@ static av_cold int init_video(AVFilterContext *ctx)
         }
     }
 
-    if (!(c->fifo = av_fifo_alloc(sizeof(AVFrame*))))
+    if (fifo_init(c) < 0)
         return AVERROR(ENOMEM);
 
     av_log(ctx, AV_LOG_VERBOSE, "w:%d h:%d pixfmt:%s\n", c->w, c->h, av_get_pix_fmt_name(c->pix_fmt));
@@ -310,6 +370,8 @@ static const AVOption audio_options[] = {
     { "sample_rate",    NULL, OFFSET(sample_rate),         AV_OPT_TYPE_INT,      { .i64 = 0 }, 0, INT_MAX, A },
     { "sample_fmt",     NULL, OFFSET(sample_fmt_str),      AV_OPT_TYPE_STRING,             .flags = A },
     { "channel_layout", NULL, OFFSET(channel_layout_str),  AV_OPT_TYPE_STRING,             .flags = A },
+    { "frame_size",     "Number of samples per output frame, 0 to pass the frames as submitted",
+                              OFFSET(frame_size),          AV_OPT_TYPE_INT,      { .i64 = 0 }, 0, INT_MAX, A },
     { NULL },
 };
 
@@ -339,9 +401,18 @@ static av_cold int init_audio(AVFilterContext *ctx)
         return AVERROR(EINVAL);
     }
 
-    if (!(s->fifo = av_fifo_alloc(sizeof(AVFrame*))))
+    if (fifo_init(s) < 0)
         return AVERROR(ENOMEM);
 
+    if (s->frame_size) {
+        s->audio_fifo = av_audio_fifo_alloc(s->sample_fmt,
+                                            av_get_channel_layout_nb_channels(s->channel_layout),
+                                            s->frame_size);
+        if (!s->audio_fifo)
+            return AVERROR(ENOMEM);
+        s->next_pts = AV_NOPTS_VALUE;
+    }
+
     if (!s->time_base.num)
         s->time_base = (AVRational){1, s->sample_rate};
 
@@ -362,6 +433,14 @@ static av_cold void uninit(AVFilterContext *ctx)
     }
     av_fifo_free(s->fifo);
     s->fifo = NULL;
+    if (s->audio_fifo)
+        av_audio_fifo_free(s->audio_fifo);
+    s->audio_fifo = NULL;
+#if HAVE_THREADS
+    if (s->lock_init)
+        pthread_mutex_destroy(&s->lock);
+    s->lock_init = 0;
+#endif
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -415,18 +494,73 @@ static int config_props(AVFilterLink *link)
     return 0;
 }
 
+/**
+ * Output a frame of frame_size samples, or of the remaining samples on EOF,
+ * from the submitted frames.
+ */
+static int request_samples(AVFilterLink *link)
+{
+    BufferSourceContext *c = link->src->priv;
+    AVFrame *frame;
+    int nb_samples, eof, ret;
+
+    fifo_lock(c);
+    while (av_audio_fifo_size(c->audio_fifo) < c->frame_size &&
+           av_fifo_size(c->fifo)) {
+        av_fifo_generic_read(c->fifo, &frame, sizeof(frame), NULL);
+        c->queued_samples -= frame->nb_samples;
+
+        if (!av_audio_fifo_size(c->audio_fifo))
+            c->next_pts = frame->pts;
+        ret = av_audio_fifo_write(c->audio_fifo, (void **)frame->extended_data,
+                                  frame->nb_samples);
+        av_frame_free(&frame);
+        if (ret < 0) {
+            fifo_unlock(c);
+            return ret;
+        }
+    }
+    eof = c->eof;
+    fifo_unlock(c);
+
+    nb_samples = av_audio_fifo_size(c->audio_fifo);
+    if (nb_samples < c->frame_size && !eof)
+        return AVERROR(EAGAIN);
+    if (!nb_samples)
+        return AVERROR_EOF;
+    nb_samples = FFMIN(nb_samples, c->frame_size);
+
+    frame = ff_get_audio_buffer(link, nb_samples);
+    if (!frame)
+        return AVERROR(ENOMEM);
+    av_audio_fifo_read(c->audio_fifo, (void **)frame->extended_data, nb_samples);
+
+    frame->pts = c->next_pts;
+    if (c->next_pts != AV_NOPTS_VALUE)
+        c->next_pts += av_rescale_q(nb_samples,
+                                    (AVRational){ 1, link->sample_rate },
+                                    link->time_base);
+
+    return ff_filter_frame(link, frame);
+}
+
 static int request_frame(AVFilterLink *link)
 {
     BufferSourceContext *c = link->src->priv;
     AVFrame *frame;
     int ret = 0;
 
+    if (c->audio_fifo)
+        return request_samples(link);
+
+    fifo_lock(c);
     if (!av_fifo_size(c->fifo)) {
-        if (c->eof)
-            return AVERROR_EOF;
-        return AVERROR(EAGAIN);
+        ret = c->eof ? AVERROR_EOF : AVERROR(EAGAIN);
+        fifo_unlock(c);
+        return ret;
     }
     av_fifo_generic_read(c->fifo, &frame, sizeof(frame), NULL);
+    fifo_unlock(c);
 
     ff_filter_frame(link, frame);
 
@@ -436,8 +570,23 @@ static int request_frame(AVFilterLink *link)
 static int poll_frame(AVFilterLink *link)
 {
     BufferSourceContext *c = link->src->priv;
-    int size = av_fifo_size(c->fifo);
-    if (!size && c->eof)
+    int size, eof, nb_samples = 0;
+
+    fifo_lock(c);
+    size = av_fifo_size(c->fifo);
+    eof  = c->eof;
+    if (c->audio_fifo)
+        nb_samples = c->queued_samples + av_audio_fifo_size(c->audio_fifo);
+    fifo_unlock(c);
+
+    if (c->audio_fifo) {
+        if (!nb_samples && eof)
+            return AVERROR_EOF;
+        return eof ? (nb_samples + c->frame_size - 1) / c->frame_size :
+                     nb_samples / c->frame_size;
+    }
+
+    if (!size && eof)
         return AVERROR_EOF;
     return size/sizeof(AVFrame*);
 }
@@ -0,0 +1,226 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/samplefmt.h"
+
+#include "framepool.h"
+
+static AVBufferRef *pool_alloc(void *opaque, int size)
+{
+    FFFramePool *pool = opaque;
+
+    pool->nb_allocated++;
+    return av_buffer_alloc(size);
+}
+
+static void uninit_buffer_pools(FFFramePool *pool)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(pool->pools); i++)
+        av_buffer_pool_uninit(&pool->pools[i]);
+}
+
+static FFFramePool *get_pool(FFFramePool **ppool)
+{
+    if (!*ppool)
+        *ppool = av_mallocz(sizeof(**ppool));
+    return *ppool;
+}
+
+/* same buffer layout as av_frame_get_buffer() */
+static int init_video_pool(FFFramePool *pool, int format, int width, int height,
+                           int align)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    int i, ret;
+
+    uninit_buffer_pools(pool);
+
+    if (!desc)
+        return AVERROR(EINVAL);
+    if ((ret = av_image_check_size(width, height, 0, NULL)) < 0)
+        return ret;
+
+    memset(pool->linesize, 0, sizeof(pool->linesize));
+    ret = av_image_fill_linesizes(pool->linesize, format, width);
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < 4 && pool->linesize[i]; i++) {
+        int h = height;
+        if (i == 1 || i == 2)
+            h = -((-h) >> desc->log2_chroma_h);
+
+        pool->linesize[i] = FFALIGN(pool->linesize[i], align);
+        pool->pools[i]    = av_buffer_pool_init2(pool->linesize[i] * h, pool,
+                                                 pool_alloc, NULL);
+        if (!pool->pools[i])
+            return AVERROR(ENOMEM);
+    }
+    if (desc->flags & AV_PIX_FMT_FLAG_PAL || desc->flags & AV_PIX_FMT_FLAG_PSEUDOPAL) {
+        av_buffer_pool_uninit(&pool->pools[1]);
+        pool->pools[1] = av_buffer_pool_init2(1024, pool, pool_alloc, NULL);
+        if (!pool->pools[1])
+            return AVERROR(ENOMEM);
+    }
+
+    pool->format = format;
+    pool->width  = width;
+    pool->height = height;
+    pool->align  = align;
+
+    return 0;
+}
+
+AVFrame *ff_frame_pool_get_video(FFFramePool **ppool, int format,
+                                 int width, int height, int align)
+{
+    FFFramePool *pool = get_pool(ppool);
+    AVFrame *frame;
+    int i;
+
+    if (!pool)
+        return NULL;
+
+    if (!pool->pools[0] || pool->format != format || pool->width != width ||
+        pool->height != height || pool->align != align) {
+        if (init_video_pool(pool, format, width, height, align) < 0) {
+            uninit_buffer_pools(pool);
+            return NULL;
+        }
+    }
+
+    frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+
+    frame->width  = width;
+    frame->height = height;
+    frame->format = format;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(pool->pools) && pool->pools[i]; i++) {
+        frame->buf[i] = av_buffer_pool_get(pool->pools[i]);
+        if (!frame->buf[i])
+            goto fail;
+        pool->nb_requested++;
+
+        frame->data[i]     = frame->buf[i]->data;
+        frame->linesize[i] = pool->linesize[i];
+    }
+    frame->extended_data = frame->data;
+
+    return frame;
+fail:
+    av_frame_free(&frame);
+    return NULL;
+}
+
+AVFrame *ff_frame_pool_get_audio(FFFramePool **ppool, int format,
+                                 uint64_t channel_layout, int nb_samples)
+{
+    FFFramePool *pool = get_pool(ppool);
+    int channels = av_get_channel_layout_nb_channels(channel_layout);
+    int planes   = av_sample_fmt_is_planar(format) ? channels : 1;
+    AVFrame *frame;
+    int i, ret;
+
+    if (!pool)
+        return NULL;
+
+    if (!pool->pools[0] || pool->format != format ||
+        pool->channels != channels || pool->nb_samples < nb_samples) {
+        int linesize;
+
+        uninit_buffer_pools(pool);
+
+        ret = av_samples_get_buffer_size(&linesize, channels, nb_samples,
+                                         format, 0);
+        if (ret < 0)
+            return NULL;
+
+        pool->pools[0] = av_buffer_pool_init2(linesize, pool, pool_alloc, NULL);
+        if (!pool->pools[0])
+            return NULL;
+
+        pool->format     = format;
+        pool->channels   = channels;
+        pool->nb_samples = nb_samples;
+    }
+
+    frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+
+    frame->nb_samples     = nb_samples;
+    frame->format         = format;
+    frame->channel_layout = channel_layout;
+
+    if (av_samples_get_buffer_size(&frame->linesize[0], channels, nb_samples,
+                                   format, 0) < 0)
+        goto fail;
+
+    if (planes > AV_NUM_DATA_POINTERS) {
+        frame->extended_data = av_mallocz(planes *
+                                          sizeof(*frame->extended_data));
+        frame->extended_buf  = av_mallocz((planes - AV_NUM_DATA_POINTERS) *
+                                          sizeof(*frame->extended_buf));
+        if (!frame->extended_data || !frame->extended_buf)
+            goto fail;
+        frame->nb_extended_buf = planes - AV_NUM_DATA_POINTERS;
+    } else
+        frame->extended_data = frame->data;
+
+    for (i = 0; i < planes; i++) {
+        AVBufferRef *buf = av_buffer_pool_get(pool->pools[0]);
+        if (!buf)
+            goto fail;
+        pool->nb_requested++;
+
+        if (i < AV_NUM_DATA_POINTERS) {
+            frame->buf[i]  = buf;
+            frame->data[i] = buf->data;
+        } else
+            frame->extended_buf[i - AV_NUM_DATA_POINTERS] = buf;
+        frame->extended_data[i] = buf->data;
+    }
+
+    return frame;
+fail:
+    av_frame_free(&frame);
+    return NULL;
+}
+
+void ff_frame_pool_uninit(FFFramePool **pool)
+{
+    if (!*pool)
+        return;
+
+    uninit_buffer_pools(*pool);
+    av_freep(pool);
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FRAMEPOOL_H
+#define AVFILTER_FRAMEPOOL_H
+
+#include <stdint.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/frame.h"
+
+/**
+ * Pools of frame buffers for one filter link, recreated whenever the
+ * requested frame parameters change.
+ */
+typedef struct FFFramePool {
+    /**
+     * Pools for each data plane. For audio all the planes have the same size,
+     * so only pools[0] is used.
+     */
+    AVBufferPool *pools[4];
+
+    /*
+     * Pool parameters
+     */
+    int format;
+    int width, height;
+    int align;
+    int linesize[4];
+    int channels;
+    int nb_samples;
+
+    /*
+     * Statistics, kept across the pool reinitializations
+     */
+    uint64_t nb_requested;   ///< number of buffers requested from the pools
+    uint64_t nb_allocated;   ///< number of buffers the pools had to allocate
+} FFFramePool;
+
+/**
+ * Get a video frame whose buffers come from the pool, (re)initializing the
+ * pool if needed.
+ */
+AVFrame *ff_frame_pool_get_video(FFFramePool **pool, int format,
+                                 int width, int height, int align);
+
+/**
+ * Get an audio frame whose buffers come from the pool, (re)initializing the
+ * pool if needed. The buffers are large enough for the largest number of
+ * samples requested so far, so a varying frame size does not cause
+ * reallocations.
+ */
+AVFrame *ff_frame_pool_get_audio(FFFramePool **pool, int format,
+                                 uint64_t channel_layout, int nb_samples);
+
+/**
+ * Free the pool. Frames still referencing its buffers remain valid.
+ */
+void ff_frame_pool_uninit(FFFramePool **pool);
+
+#endif /* AVFILTER_FRAMEPOOL_H */
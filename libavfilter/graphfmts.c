@@ -0,0 +1,78 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Configure a closed filter graph and print the format picked for each of
+ * its links, including the links of the auto-inserted conversion filters.
+ */
+
+#include <stdio.h>
+
+#include "libavutil/pixdesc.h"
+#include "libavutil/samplefmt.h"
+#include "libavfilter/avfilter.h"
+
+int main(int argc, char **argv)
+{
+    AVFilterGraph *graph;
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    int i, j, ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s graph_description\n", argv[0]);
+        return 1;
+    }
+
+    avfilter_register_all();
+
+    graph = avfilter_graph_alloc();
+    if (!graph)
+        return 1;
+
+    ret = avfilter_graph_parse2(graph, argv[1], &inputs, &outputs);
+    if (ret >= 0 && (inputs || outputs)) {
+        fprintf(stderr, "The graph must not have unconnected pads\n");
+        ret = -1;
+    }
+    if (ret >= 0)
+        ret = avfilter_graph_config(graph, NULL);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (ret < 0) {
+        fprintf(stderr, "Cannot configure the graph '%s'\n", argv[1]);
+        avfilter_graph_free(&graph);
+        return 1;
+    }
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+
+        for (j = 0; j < filter->nb_outputs; j++) {
+            AVFilterLink *link = filter->outputs[j];
+            const char *name = link->type == AVMEDIA_TYPE_VIDEO ?
+                               av_get_pix_fmt_name(link->format) :
+                               av_get_sample_fmt_name(link->format);
+
+            printf("%s -> %s: %s\n", link->src->name, link->dst->name,
+                   name ? name : "none");
+        }
+    }
+
+    avfilter_graph_free(&graph);
+    return 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Run a filter graph with a single unconnected output using the given
+ * threading settings and print a checksum of each plane of the frames it
+ * outputs, so that the threaded and unthreaded runs can be compared.
+ *
+ * With -s, the graph also has a single unconnected input, which is fed
+ * through a buffer source with the frames output by an unthreaded source
+ * graph. Each frame is added before taking all the frames available from
+ * the graph, as avconv does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/samplefmt.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+
+static int usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-t threads] [-p] [-n frames] "
+            "[-s source_graph_description] graph_description\n", argv0);
+    return 1;
+}
+
+static void print_video_frame(int n, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int i, y;
+
+    printf("%d: pts %"PRId64" %dx%d %s", n, frame->pts,
+           frame->width, frame->height, desc->name);
+    for (i = 0; i < 4 && frame->data[i]; i++) {
+        int linesize = av_image_get_linesize(frame->format, frame->width, i);
+        int h        = frame->height;
+        uint32_t crc = 0;
+
+        if (i == 1 || i == 2)
+            h = -(-frame->height >> desc->log2_chroma_h);
+        for (y = 0; y < h; y++)
+            crc = av_adler32_update(crc, frame->data[i] + y * frame->linesize[i],
+                                    linesize);
+        printf(" 0x%08x", crc);
+    }
+    printf("\n");
+}
+
+static void print_audio_frame(int n, const AVFrame *frame)
+{
+    int channels = av_get_channel_layout_nb_channels(frame->channel_layout);
+    int planar   = av_sample_fmt_is_planar(frame->format);
+    int planes   = planar ? channels : 1;
+    int size     = frame->nb_samples * (planar ? 1 : channels) *
+                   av_get_bytes_per_sample(frame->format);
+    char layout[64];
+    int i;
+
+    av_get_channel_layout_string(layout, sizeof(layout), channels,
+                                 frame->channel_layout);
+    printf("%d: pts %"PRId64" %d %s %s", n, frame->pts, frame->nb_samples,
+           av_get_sample_fmt_name(frame->format), layout);
+    for (i = 0; i < planes; i++) {
+        uint32_t crc = av_adler32_update(0, frame->extended_data[i], size);
+        printf(" 0x%08x", crc);
+    }
+    printf("\n");
+}
+
+static void print_frame(int n, const AVFrame *frame)
+{
+    if (frame->nb_samples)
+        print_audio_frame(n, frame);
+    else
+        print_video_frame(n, frame);
+}
+
+/**
+ * Parse a graph description with a single unconnected output, linked to a
+ * buffer sink, and at most one unconnected input, returned in *inputs.
+ */
+static int parse_graph(AVFilterGraph *graph, const char *desc,
+                       AVFilterInOut **inputs, AVFilterContext **sink)
+{
+    AVFilterInOut *outputs = NULL;
+    enum AVMediaType type;
+    int ret;
+
+    ret = avfilter_graph_parse2(graph, desc, inputs, &outputs);
+    if (ret >= 0 && ((*inputs && (*inputs)->next) || !outputs || outputs->next)) {
+        fprintf(stderr, "The graph '%s' must have one unconnected output "
+                "and at most one unconnected input\n", desc);
+        ret = -1;
+    }
+    if (ret >= 0) {
+        type = avfilter_pad_get_type(outputs->filter_ctx->output_pads,
+                                     outputs->pad_idx);
+        ret  = avfilter_graph_create_filter(sink, avfilter_get_by_name(
+                                                type == AVMEDIA_TYPE_AUDIO ?
+                                                "abuffersink" : "buffersink"),
+                                            "out", NULL, NULL, graph);
+    }
+    if (ret >= 0)
+        ret = avfilter_link(outputs->filter_ctx, outputs->pad_idx, *sink, 0);
+    avfilter_inout_free(&outputs);
+    return ret;
+}
+
+/**
+ * Create a buffer source for the frames output by the given sink and link
+ * it to the unconnected input.
+ */
+static int link_source(AVFilterGraph *graph, AVFilterInOut *input,
+                       AVFilterContext *src_sink, AVFilterContext **src)
+{
+    AVFilterLink *link = src_sink->inputs[0];
+    char args[256];
+    int ret;
+
+    if (link->type == AVMEDIA_TYPE_AUDIO)
+        snprintf(args, sizeof(args),
+                 "time_base=%d/%d:sample_rate=%d:sample_fmt=%s:"
+                 "channel_layout=0x%"PRIx64, link->time_base.num,
+                 link->time_base.den, link->sample_rate,
+                 av_get_sample_fmt_name(link->format), link->channel_layout);
+    else
+        snprintf(args, sizeof(args),
+                 "width=%d:height=%d:pix_fmt=%s:time_base=%d/%d:sar=%d/%d",
+                 link->w, link->h, av_get_pix_fmt_name(link->format),
+                 link->time_base.num, link->time_base.den,
+                 link->sample_aspect_ratio.num, link->sample_aspect_ratio.den);
+
+    ret = avfilter_graph_create_filter(src, avfilter_get_by_name(
+                                           link->type == AVMEDIA_TYPE_AUDIO ?
+                                           "abuffer" : "buffer"),
+                                       "in", args, NULL, graph);
+    if (ret >= 0)
+        ret = avfilter_link(*src, 0, input->filter_ctx, input->pad_idx);
+    return ret;
+}
+
+/* take all the frames available from the sink */
+static int drain(AVFilterContext *sink, AVFrame *frame, int *n)
+{
+    int ret;
+
+    while ((ret = av_buffersink_get_frame(sink, frame)) >= 0) {
+        print_frame((*n)++, frame);
+        av_frame_unref(frame);
+    }
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    AVFilterGraph *graph, *src_graph = NULL;
+    AVFilterContext *sink, *src = NULL, *src_sink = NULL;
+    AVFilterInOut *inputs = NULL, *src_inputs = NULL;
+    AVFrame *frame;
+    const char *desc = NULL, *src_desc = NULL;
+    int threads = 1, pipeline = 0, nb_frames = 5;
+    int i, n = 0, ret;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p"))
+            pipeline = 1;
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            nb_frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            src_desc = argv[++i];
+        else if (!desc)
+            desc = argv[i];
+        else
+            return usage(argv[0]);
+    }
+    if (!desc || threads < 0)
+        return usage(argv[0]);
+
+    avfilter_register_all();
+
+    graph = avfilter_graph_alloc();
+    frame = av_frame_alloc();
+    if (!graph || !frame)
+        return 1;
+
+    av_opt_set_int(graph, "threads", threads, 0);
+    if (pipeline)
+        av_opt_set(graph, "thread_type", "slice+pipeline", 0);
+
+    if (src_desc) {
+        src_graph = avfilter_graph_alloc();
+        if (!src_graph)
+            return 1;
+        av_opt_set_int(src_graph, "threads", 1, 0);
+
+        ret = parse_graph(src_graph, src_desc, &src_inputs, &src_sink);
+        if (ret >= 0 && src_inputs) {
+            fprintf(stderr, "The source graph must not have inputs\n");
+            ret = -1;
+        }
+        if (ret >= 0)
+            ret = avfilter_graph_config(src_graph, NULL);
+        avfilter_inout_free(&src_inputs);
+        if (ret < 0) {
+            fprintf(stderr, "Cannot configure the graph '%s'\n", src_desc);
+            goto end;
+        }
+    }
+
+    ret = parse_graph(graph, desc, &inputs, &sink);
+    if (ret >= 0 && !inputs != !src_desc) {
+        fprintf(stderr, "The graph must have an unconnected input if and only "
+                "if a source graph is given\n");
+        ret = -1;
+    }
+    if (ret >= 0 && inputs)
+        ret = link_source(graph, inputs, src_sink, &src);
+    if (ret >= 0)
+        ret = avfilter_graph_config(graph, NULL);
+    avfilter_inout_free(&inputs);
+    if (ret < 0) {
+        fprintf(stderr, "Cannot configure the graph '%s'\n", desc);
+        goto end;
+    }
+
+    if (!src) {
+        for (i = 0; i < nb_frames; i++) {
+            ret = av_buffersink_get_frame(sink, frame);
+            if (ret == AVERROR_EOF)
+                break;
+            if (ret < 0) {
+                fprintf(stderr, "Error getting frame %d\n", i);
+                goto end;
+            }
+            print_frame(i, frame);
+            av_frame_unref(frame);
+        }
+        ret = 0;
+        goto end;
+    }
+
+    /* the source frames are added one at a time, followed by EOF after
+     * which every remaining frame is output */
+    for (i = 0; i <= nb_frames; i++) {
+        if (i < nb_frames) {
+            ret = av_buffersink_get_frame(src_sink, frame);
+            if (ret == AVERROR_EOF)
+                i = nb_frames;
+            else if (ret < 0) {
+                fprintf(stderr, "Error getting source frame %d\n", i);
+                goto end;
+            }
+        }
+        ret = av_buffersrc_add_frame(src, i < nb_frames ? frame : NULL);
+        if (ret < 0) {
+            fprintf(stderr, "Error adding frame %d\n", i);
+            goto end;
+        }
+
+        ret = drain(sink, frame, &n);
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            fprintf(stderr, "Error getting frame %d\n", n);
+            goto end;
+        }
+    }
+    if (ret != AVERROR_EOF) {
+        fprintf(stderr, "The graph did not end with its input\n");
+        goto end;
+    }
+    ret = 0;
+
+end:
+    av_frame_free(&frame);
+    avfilter_graph_free(&graph);
+    avfilter_graph_free(&src_graph);
+    return !!ret;
+}
@@ -130,6 +130,7 @@ struct AVFilterPad {
 
 struct AVFilterGraphInternal {
     void *thread;
+    void *pipeline;
     avfilter_execute_func *thread_execute;
 };
 
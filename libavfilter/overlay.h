@@ -0,0 +1,37 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_OVERLAY_H
+#define AVFILTER_OVERLAY_H
+
+#include <stdint.h>
+
+typedef struct OverlayDSPContext {
+    /**
+     * Blend w samples of src with the given alpha onto dst, computing
+     * (dst * (255 - alpha) + src * alpha + 128) >> 8.
+     */
+    void (*blend_row)(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int w);
+} OverlayDSPContext;
+
+void ff_overlay_init_x86(OverlayDSPContext *dsp);
+
+void ff_overlay_blend_row_c(uint8_t *dst, const uint8_t *src,
+                            const uint8_t *alpha, int w);
+
+#endif /* AVFILTER_OVERLAY_H */
@@ -0,0 +1,431 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Libavfilter pipelined graph execution
+ *
+ * The graph is split into stages at the output links of the filters
+ * allowing pipelined threading. The filters upstream of such a link are
+ * run by a worker thread of their own, which requests frames ahead of the
+ * downstream filters and keeps them in a bounded queue. The downstream
+ * filters still receive the frames synchronously from ff_request_frame(),
+ * so the filters themselves do not need to be aware of the pipeline.
+ *
+ * A worker whose buffer sources have no input left waits until the caller
+ * adds some. When the downstream filters are run by the caller, the caller
+ * is then not made to wait for the frames filtered from that input: it gets
+ * AVERROR(EAGAIN) as when more input is needed, and can add more meanwhile,
+ * until it signals the end of the input.
+ *
+ * A link is only used as a stage boundary if it is the only way out of
+ * the filters upstream of it, so that frames never go from one stage to
+ * another through any other link. The get_buffer callbacks are not
+ * forwarded across a boundary either: they would run the downstream filters
+ * on the upstream thread, so the frames sent over a boundary link are
+ * allocated from the pool of that link. Once the graph is configured, every
+ * filter is then run by the thread of its stage, and the caller must only
+ * access the filters run by a worker through the buffersrc and buffersink
+ * functions.
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "libavutil/fifo.h"
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+
+#include "avfilter.h"
+#include "internal.h"
+#include "thread.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#elif HAVE_W32THREADS
+#include "compat/w32pthreads.h"
+#endif
+
+/**
+ * Number of frames a worker requests ahead of the downstream filters.
+ */
+#define PIPELINE_QUEUE_SIZE 4
+
+struct FFPipelineStage {
+    AVFilterLink *link;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    AVFifoBuffer *queue;    ///< frames sent over the link, not yet consumed
+    int status;             ///< error returned by the last upstream request
+    int active;             ///< a frame has been requested downstream
+    int done;
+
+    uint8_t *upstream;      ///< flags for the graph filters run by this stage
+    int caller_side;        ///< the link ends in a filter run by the caller
+    int fed;                ///< a buffer source of this stage got input
+    int input_eof;          ///< a buffer source of this stage got EOF
+    int woken;              ///< new input was added during the current request
+};
+
+typedef struct PipelineContext {
+    FFPipelineStage **stages;
+    int nb_stages;
+} PipelineContext;
+
+static int request_upstream(AVFilterLink *link)
+{
+    if (link->srcpad->request_frame)
+        return link->srcpad->request_frame(link);
+    else if (link->src->inputs[0])
+        return ff_request_frame(link->src->inputs[0]);
+    else return -1;
+}
+
+static int queue_full(FFPipelineStage *s)
+{
+    return av_fifo_size(s->queue) >= PIPELINE_QUEUE_SIZE * sizeof(AVFrame*);
+}
+
+static void* attribute_align_arg worker(void *arg)
+{
+    FFPipelineStage *s = arg;
+    int ret;
+
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        while (!s->done && (!s->active || s->status || queue_full(s)))
+            pthread_cond_wait(&s->cond, &s->lock);
+        if (s->done)
+            break;
+        s->woken = 0;
+        pthread_mutex_unlock(&s->lock);
+
+        ret = request_upstream(s->link);
+
+        pthread_mutex_lock(&s->lock);
+        /* the input added meanwhile may not have been seen by the request */
+        if (ret < 0 && !(ret == AVERROR(EAGAIN) && s->woken))
+            s->status = ret;
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return NULL;
+}
+
+int ff_pipeline_queue_frame(FFPipelineStage *s, AVFrame *frame)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&s->lock);
+    if (!av_fifo_space(s->queue))
+        ret = av_fifo_realloc2(s->queue, av_fifo_size(s->queue) + sizeof(frame));
+    if (ret >= 0)
+        av_fifo_generic_write(s->queue, &frame, sizeof(frame), NULL);
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+
+    if (ret < 0)
+        av_frame_free(&frame);
+    return ret;
+}
+
+int ff_pipeline_get_frame(FFPipelineStage *s, AVFrame **frame)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&s->lock);
+
+    /* the upstream filters may have been given more input since they
+     * last returned EAGAIN, so let them try again */
+    if (!av_fifo_size(s->queue) && s->status == AVERROR(EAGAIN))
+        s->status = 0;
+    s->active = 1;
+    pthread_cond_broadcast(&s->cond);
+
+    while (!s->done && !av_fifo_size(s->queue) && !s->status) {
+        /* while the upstream filters are working on the input added so
+         * far, let the caller add more rather than waiting for them, until
+         * the end of the input, after which every frame is waited for */
+        if (s->caller_side && s->fed && !s->input_eof)
+            break;
+        pthread_cond_wait(&s->cond, &s->lock);
+    }
+
+    if (av_fifo_size(s->queue)) {
+        av_fifo_generic_read(s->queue, frame, sizeof(*frame), NULL);
+        pthread_cond_broadcast(&s->cond);
+    } else if (s->done)
+        ret = AVERROR_EXIT;
+    else
+        ret = s->status ? s->status : AVERROR(EAGAIN);
+
+    pthread_mutex_unlock(&s->lock);
+
+    return ret;
+}
+
+static int filter_index(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    int i;
+
+    for (i = 0; i < graph->nb_filters; i++)
+        if (graph->filters[i] == filter)
+            return i;
+    return -1;
+}
+
+void ff_pipeline_input_added(AVFilterContext *src, int eof)
+{
+    PipelineContext *c = src->graph->internal->pipeline;
+    int i, idx;
+
+    if (!c)
+        return;
+
+    idx = filter_index(src->graph, src);
+    for (i = 0; i < c->nb_stages; i++) {
+        FFPipelineStage *s = c->stages[i];
+
+        if (idx < 0 || !s->upstream[idx])
+            continue;
+
+        pthread_mutex_lock(&s->lock);
+        s->fed       = 1;
+        s->woken     = 1;
+        s->input_eof |= eof;
+        if (s->status == AVERROR(EAGAIN))
+            s->status = 0;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+int ff_pipeline_poll_frame(FFPipelineStage *s)
+{
+    int ret;
+
+    pthread_mutex_lock(&s->lock);
+    ret = av_fifo_size(s->queue) / sizeof(AVFrame*);
+    if (!ret && s->status < 0 && s->status != AVERROR(EAGAIN))
+        ret = s->status;
+    pthread_mutex_unlock(&s->lock);
+
+    return ret;
+}
+
+/**
+ * Check that link is the only output of the filters upstream of it.
+ *
+ * @param upstream array of nb_filters flags, set for the filters upstream
+ * @param stack    array of nb_filters filters used for the graph traversal
+ */
+static int is_stage_boundary(AVFilterGraph *graph, AVFilterLink *link,
+                             uint8_t *upstream, AVFilterContext **stack)
+{
+    int i, j, nb_stack = 0;
+
+    memset(upstream, 0, graph->nb_filters);
+    upstream[filter_index(graph, link->src)] = 1;
+    stack[nb_stack++] = link->src;
+
+    while (nb_stack) {
+        AVFilterContext *f = stack[--nb_stack];
+
+        for (i = 0; i < f->nb_inputs; i++) {
+            int idx = filter_index(graph, f->inputs[i]->src);
+            if (idx < 0)
+                return 0;
+            if (!upstream[idx]) {
+                upstream[idx]       = 1;
+                stack[nb_stack++] = f->inputs[i]->src;
+            }
+        }
+    }
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (!upstream[i])
+            continue;
+        for (j = 0; j < f->nb_outputs; j++) {
+            AVFilterLink *out = f->outputs[j];
+            if (out != link && !upstream[filter_index(graph, out->dst)])
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int add_stage(AVFilterGraph *graph, PipelineContext *c,
+                     AVFilterLink *link, const uint8_t *upstream)
+{
+    FFPipelineStage *s, **stages;
+    int ret;
+
+    stages = av_realloc(c->stages, (c->nb_stages + 1) * sizeof(*c->stages));
+    if (!stages)
+        return AVERROR(ENOMEM);
+    c->stages = stages;
+
+    s = av_mallocz(sizeof(*s));
+    if (!s)
+        return AVERROR(ENOMEM);
+    s->link     = link;
+    s->queue    = av_fifo_alloc(PIPELINE_QUEUE_SIZE * sizeof(AVFrame*));
+    s->upstream = av_malloc(graph->nb_filters);
+    if (!s->queue || !s->upstream) {
+        av_fifo_free(s->queue);
+        av_freep(&s->upstream);
+        av_freep(&s);
+        return AVERROR(ENOMEM);
+    }
+    memcpy(s->upstream, upstream, graph->nb_filters);
+
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+
+    ret = pthread_create(&s->thread, NULL, worker, s);
+    if (ret) {
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->cond);
+        av_fifo_free(s->queue);
+        av_freep(&s->upstream);
+        av_freep(&s);
+        return AVERROR(ret);
+    }
+
+    c->stages[c->nb_stages++] = s;
+    link->pipeline = s;
+
+    av_log(graph, AV_LOG_DEBUG, "Pipeline stage %d ends after '%s'.\n",
+           c->nb_stages, link->src->name);
+
+    return 0;
+}
+
+int ff_graph_pipeline_init(AVFilterGraph *graph)
+{
+    PipelineContext *c;
+    uint8_t *upstream;
+    AVFilterContext **stack;
+    int i, j, ret = 0;
+
+    ff_graph_pipeline_uninit(graph);
+
+    if (!(graph->thread_type & AVFILTER_THREAD_PIPELINE))
+        return 0;
+
+    c        = av_mallocz(sizeof(*c));
+    upstream = av_malloc(graph->nb_filters);
+    stack    = av_malloc(graph->nb_filters * sizeof(*stack));
+    if (!c || !upstream || !stack) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    graph->internal->pipeline = c;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        /* there is no point in a stage only made of a source */
+        if (!(f->thread_type & AVFILTER_THREAD_PIPELINE) || !f->nb_inputs)
+            continue;
+
+        for (j = 0; j < f->nb_outputs; j++) {
+            if (!is_stage_boundary(graph, f->outputs[j], upstream, stack))
+                continue;
+            if ((ret = add_stage(graph, c, f->outputs[j], upstream)) < 0)
+                goto end;
+        }
+    }
+
+    /* the stages ending in a filter run by another stage are waited for by
+     * that stage's thread, the others by the caller */
+    for (i = 0; i < c->nb_stages; i++) {
+        FFPipelineStage *s = c->stages[i];
+        int dst = filter_index(graph, s->link->dst), caller_side = 1;
+
+        for (j = 0; j < c->nb_stages; j++)
+            if (j != i && c->stages[j]->upstream[dst])
+                caller_side = 0;
+
+        pthread_mutex_lock(&s->lock);
+        s->caller_side = caller_side;
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    av_log(graph, AV_LOG_VERBOSE, "Running the graph in %d pipeline stages.\n",
+           c->nb_stages + 1);
+
+end:
+    av_freep(&upstream);
+    av_freep(&stack);
+    if (ret < 0) {
+        if (c && !graph->internal->pipeline)
+            av_freep(&c);
+        ff_graph_pipeline_uninit(graph);
+    }
+    return ret;
+}
+
+void ff_graph_pipeline_uninit(AVFilterGraph *graph)
+{
+    PipelineContext *c = graph->internal->pipeline;
+    int i;
+
+    if (!c)
+        return;
+
+    /* a worker may be waiting on the queue of another stage, so all of
+     * them must be told to stop before joining any */
+    for (i = 0; i < c->nb_stages; i++) {
+        FFPipelineStage *s = c->stages[i];
+        pthread_mutex_lock(&s->lock);
+        s->done = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    for (i = 0; i < c->nb_stages; i++) {
+        FFPipelineStage *s = c->stages[i];
+
+        pthread_join(s->thread, NULL);
+
+        while (av_fifo_size(s->queue)) {
+            AVFrame *frame;
+            av_fifo_generic_read(s->queue, &frame, sizeof(frame), NULL);
+            av_frame_free(&frame);
+        }
+        av_fifo_free(s->queue);
+        av_freep(&s->upstream);
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->cond);
+
+        s->link->pipeline = NULL;
+        av_freep(&c->stages[i]);
+    }
+
+    av_freep(&c->stages);
+    av_freep(&graph->internal->pipeline);
+}
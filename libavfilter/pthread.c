@@ -55,6 +55,8 @@ typedef struct ThreadContext {
     pthread_cond_t last_job_cond;
     pthread_cond_t current_job_cond;
     pthread_mutex_t current_job_lock;
+    /* pipeline stages may call execute concurrently */
+    pthread_mutex_t execute_lock;
     int current_job;
     unsigned int current_execute;
     int done;
@@ -107,6 +109,7 @@ static void slice_thread_uninit(ThreadContext *c)
          pthread_join(c->workers[i], NULL);
 
     pthread_mutex_destroy(&c->current_job_lock);
+    pthread_mutex_destroy(&c->execute_lock);
     pthread_cond_destroy(&c->current_job_cond);
     pthread_cond_destroy(&c->last_job_cond);
     av_freep(&c->workers);
@@ -128,6 +131,7 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     if (nb_jobs <= 0)
         return 0;
 
+    pthread_mutex_lock(&c->execute_lock);
     pthread_mutex_lock(&c->current_job_lock);
 
     c->current_job = c->nb_threads;
@@ -147,6 +151,7 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     pthread_cond_broadcast(&c->current_job_cond);
 
     slice_thread_park_workers(c);
+    pthread_mutex_unlock(&c->execute_lock);
 
     return 0;
 }
@@ -181,6 +186,7 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     pthread_cond_init(&c->last_job_cond,    NULL);
 
     pthread_mutex_init(&c->current_job_lock, NULL);
+    pthread_mutex_init(&c->execute_lock, NULL);
     pthread_mutex_lock(&c->current_job_lock);
     for (i = 0; i < nb_threads; i++) {
         ret = pthread_create(&c->workers[i], NULL, worker, c);
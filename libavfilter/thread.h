@@ -26,4 +26,44 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+typedef struct FFPipelineStage FFPipelineStage;
+
+/**
+ * Split a configured graph into pipeline stages, if pipelined threading is
+ * allowed in it.
+ */
+int ff_graph_pipeline_init(AVFilterGraph *graph);
+
+/**
+ * Stop the pipeline stage threads and free the queued frames.
+ */
+void ff_graph_pipeline_uninit(AVFilterGraph *graph);
+
+/**
+ * Queue a frame sent over a link ending a pipeline stage.
+ */
+int ff_pipeline_queue_frame(FFPipelineStage *s, AVFrame *frame);
+
+/**
+ * Get the next frame sent over a link ending a pipeline stage, waiting
+ * for the upstream filters if none is queued yet. If the stage is fed by
+ * the caller through a buffer source and ends in a filter run by the
+ * caller, AVERROR(EAGAIN) is returned instead of waiting until the end of
+ * the input.
+ *
+ * @return 0 on success, the error returned by the upstream filters otherwise
+ */
+int ff_pipeline_get_frame(FFPipelineStage *s, AVFrame **frame);
+
+/**
+ * Wake the pipeline stages running a buffer source the caller added input
+ * or EOF to, so that they filter it without waiting for the next request.
+ */
+void ff_pipeline_input_added(AVFilterContext *src, int eof);
+
+/**
+ * @return the number of frames queued on a link ending a pipeline stage
+ */
+int ff_pipeline_poll_frame(FFPipelineStage *s);
+
 #endif /* AVFILTER_THREAD_H */
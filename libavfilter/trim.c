@@ -33,6 +33,7 @@
 #include "audio.h"
 #include "avfilter.h"
 #include "internal.h"
+#include "video.h"
 
 typedef struct TrimContext {
     const AVClass *class;
@@ -213,10 +214,11 @@ static const AVClass trim_class = {
 
 static const AVFilterPad trim_inputs[] = {
     {
-        .name         = "default",
-        .type         = AVMEDIA_TYPE_VIDEO,
-        .filter_frame = trim_filter_frame,
-        .config_props = config_input,
+        .name             = "default",
+        .type             = AVMEDIA_TYPE_VIDEO,
+        .filter_frame     = trim_filter_frame,
+        .get_video_buffer = ff_null_get_video_buffer,
+        .config_props     = config_input,
     },
     { NULL }
 };
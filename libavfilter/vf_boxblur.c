@@ -73,6 +73,7 @@ typedef struct BoxBlurContext {
     int radius[4];
     int power[4];
     uint8_t *temp[2]; ///< temporary buffer used in blur_power()
+    int temp_size;    ///< size of the temporary buffer of each slice thread
 } BoxBlurContext;
 
 #define Y 0
@@ -139,11 +140,13 @@ static int config_input(AVFilterLink *inlink)
     char *expr;
     int ret;
 
+    s->temp_size = FFMAX(w, h);
+
     av_freep(&s->temp[0]);
     av_freep(&s->temp[1]);
-    if (!(s->temp[0] = av_malloc(FFMAX(w, h))))
+    if (!(s->temp[0] = av_malloc_array(FFMAX(1, ctx->graph->nb_threads), s->temp_size)))
        return AVERROR(ENOMEM);
-    if (!(s->temp[1] = av_malloc(FFMAX(w, h)))) {
+    if (!(s->temp[1] = av_malloc_array(FFMAX(1, ctx->graph->nb_threads), s->temp_size))) {
         av_freep(&s->temp[0]);
         return AVERROR(ENOMEM);
     }
@@ -273,41 +276,87 @@ static inline void blur_power(uint8_t *dst, int dst_step, const uint8_t *src, in
 }
 
 static void hblur(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize,
-                  int w, int h, int radius, int power, uint8_t *temp[2])
+                  int w, int y0, int y1, int radius, int power, uint8_t *temp[2])
 {
     int y;
 
     if (radius == 0 && dst == src)
         return;
 
-    for (y = 0; y < h; y++)
+    for (y = y0; y < y1; y++)
         blur_power(dst + y*dst_linesize, 1, src + y*src_linesize, 1,
                    w, radius, power, temp);
 }
 
 static void vblur(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize,
-                  int w, int h, int radius, int power, uint8_t *temp[2])
+                  int x0, int x1, int h, int radius, int power, uint8_t *temp[2])
 {
     int x;
 
     if (radius == 0 && dst == src)
         return;
 
-    for (x = 0; x < w; x++)
+    for (x = x0; x < x1; x++)
         blur_power(dst + x, dst_linesize, src + x, src_linesize,
                    h, radius, power, temp);
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int w[4], h[4];
+} ThreadData;
+
+/* the horizontal pass is split in horizontal slices and the vertical pass
+ * in column stripes, so every line or column is blurred by a single job */
+static int hblur_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    BoxBlurContext *s = ctx->priv;
+    ThreadData *td = arg;
+    uint8_t *temp[2] = { s->temp[0] + jobnr * s->temp_size,
+                         s->temp[1] + jobnr * s->temp_size };
+    int plane;
+
+    for (plane = 0; td->in->data[plane] && plane < 4; plane++)
+        hblur(td->out->data[plane], td->out->linesize[plane],
+              td->in ->data[plane], td->in ->linesize[plane],
+              td->w[plane],
+              (td->h[plane] *  jobnr     ) / nb_jobs,
+              (td->h[plane] * (jobnr + 1)) / nb_jobs,
+              s->radius[plane], s->power[plane], temp);
+
+    return 0;
+}
+
+static int vblur_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    BoxBlurContext *s = ctx->priv;
+    ThreadData *td = arg;
+    uint8_t *temp[2] = { s->temp[0] + jobnr * s->temp_size,
+                         s->temp[1] + jobnr * s->temp_size };
+    int plane;
+
+    for (plane = 0; td->in->data[plane] && plane < 4; plane++)
+        vblur(td->out->data[plane], td->out->linesize[plane],
+              td->out->data[plane], td->out->linesize[plane],
+              (td->w[plane] *  jobnr     ) / nb_jobs,
+              (td->w[plane] * (jobnr + 1)) / nb_jobs,
+              td->h[plane], s->radius[plane], s->power[plane], temp);
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
     BoxBlurContext *s = ctx->priv;
     AVFilterLink *outlink = inlink->dst->outputs[0];
     AVFrame *out;
-    int plane;
     int cw = inlink->w >> s->hsub, ch = in->height >> s->vsub;
-    int w[4] = { inlink->w, cw, cw, inlink->w };
-    int h[4] = { in->height, ch, ch, in->height };
+    ThreadData td = {
+        .in = in,
+        .w  = { inlink->w, cw, cw, inlink->w },
+        .h  = { in->height, ch, ch, in->height },
+    };
 
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out) {
@@ -315,18 +364,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         return AVERROR(ENOMEM);
     }
     av_frame_copy_props(out, in);
+    td.out = out;
 
-    for (plane = 0; in->data[plane] && plane < 4; plane++)
-        hblur(out->data[plane], out->linesize[plane],
-              in ->data[plane], in ->linesize[plane],
-              w[plane], h[plane], s->radius[plane], s->power[plane],
-              s->temp);
-
-    for (plane = 0; in->data[plane] && plane < 4; plane++)
-        vblur(out->data[plane], out->linesize[plane],
-              out->data[plane], out->linesize[plane],
-              w[plane], h[plane], s->radius[plane], s->power[plane],
-              s->temp);
+    ctx->internal->execute(ctx, hblur_slice, &td, NULL,
+                           FFMIN(ch, ctx->graph->nb_threads));
+    ctx->internal->execute(ctx, vblur_slice, &td, NULL,
+                           FFMIN(cw, ctx->graph->nb_threads));
 
     av_frame_free(&in);
 
@@ -384,4 +427,5 @@ AVFilter ff_vf_boxblur = {
 
     .inputs    = avfilter_vf_boxblur_inputs,
     .outputs   = avfilter_vf_boxblur_outputs,
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
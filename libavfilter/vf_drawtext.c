@@ -105,6 +105,23 @@ enum var_name {
     VAR_VARS_NB
 };
 
+/**
+ * Layout of one line of the text. The lines are laid out separately, so
+ * that only the ones which changed have to be laid out again.
+ */
+typedef struct TextLine {
+    char *text;                     ///< text of the line, including its newline
+    int len;                        ///< length of text in bytes, -1 if not laid out
+    struct Glyph **glyphs;          ///< glyphs to draw
+    FT_Vector *positions;           ///< position of each glyph, with the row in the line as y
+    int nb_glyphs;
+    int size;                       ///< number of elements allocated in glyphs and positions
+    int nb_rows;                    ///< number of rows once wrapped at the frame width
+    int w;                          ///< width of the widest row
+    int y_min, y_max;               ///< vertical extent of the glyphs
+    int row;                        ///< first row of the line in the text
+} TextLine;
+
 typedef struct DrawTextContext {
     const AVClass *class;
 #if CONFIG_LIBFONTCONFIG
@@ -115,8 +132,12 @@ typedef struct DrawTextContext {
     uint8_t *expanded_text;         ///< used to contain the strftime()-expanded text
     size_t   expanded_text_size;    ///< size in bytes of the expanded_text buffer
     int ft_load_flags;              ///< flags used for loading fonts, see FT_LOAD_*
-    FT_Vector *positions;           ///< positions for each element in the text
-    size_t nb_positions;            ///< number of elements of positions array
+    TextLine *lines;                ///< layout of each line of the text
+    int nb_lines;                   ///< number of lines in the text
+    int lines_size;                 ///< number of elements allocated in lines
+    char *layout_text;              ///< text the current layout was computed for
+    int text_height;                ///< height of a row of text
+    int baseline;                   ///< offset of the baseline from the top of a row
     char *textfile;                 ///< file with text to be drawn
     int x, y;                       ///< position to start drawing text
     int w, h;                       ///< dimension of the text block
@@ -226,7 +247,9 @@ struct ft_error
 typedef struct Glyph {
     FT_Glyph *glyph;
     uint32_t code;
-    FT_Bitmap bitmap; ///< array holding bitmaps of font
+    uint8_t *bitmap;        ///< 8-bit coverage of the rendered glyph
+    int bitmap_w, bitmap_h;
+    int pixel_mode;         ///< pixel mode of the bitmap rendered by freetype
     FT_BBox bbox;
     int advance;
     int bitmap_left;
@@ -240,6 +263,42 @@ static int glyph_cmp(void *key, const void *b)
     return diff > 0 ? 1 : diff < 0 ? -1 : 0;
 }
 
+/**
+ * Copy the bitmap of the glyph slot, which is only valid until the next
+ * glyph is loaded, as 8-bit coverage values.
+ */
+static int copy_bitmap(Glyph *glyph, const FT_Bitmap *bitmap)
+{
+    int r, c;
+
+    glyph->pixel_mode = bitmap->pixel_mode;
+    if (bitmap->pixel_mode != FT_PIXEL_MODE_MONO &&
+        bitmap->pixel_mode != FT_PIXEL_MODE_GRAY)
+        return 0;
+
+    glyph->bitmap_w = bitmap->width;
+    glyph->bitmap_h = bitmap->rows;
+    if (!glyph->bitmap_w || !glyph->bitmap_h)
+        return 0;
+
+    glyph->bitmap = av_malloc(glyph->bitmap_w * glyph->bitmap_h);
+    if (!glyph->bitmap)
+        return AVERROR(ENOMEM);
+
+    for (r = 0; r < glyph->bitmap_h; r++) {
+        const uint8_t *src = bitmap->buffer + r * bitmap->pitch;
+        uint8_t       *dst = glyph->bitmap  + r * glyph->bitmap_w;
+
+        if (bitmap->pixel_mode == FT_PIXEL_MODE_MONO) {
+            for (c = 0; c < glyph->bitmap_w; c++)
+                dst[c] = src[c >> 3] & (0x80 >> (c & 7)) ? 255 : 0;
+        } else
+            memcpy(dst, src, glyph->bitmap_w);
+    }
+
+    return 0;
+}
+
 /**
  * Load glyphs corresponding to the UTF-32 codepoint code.
  */
@@ -267,7 +326,8 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code)
         goto error;
     }
 
-    glyph->bitmap      = s->face->glyph->bitmap;
+    if ((ret = copy_bitmap(glyph, &s->face->glyph->bitmap)) < 0)
+        goto error;
     glyph->bitmap_left = s->face->glyph->bitmap_left;
     glyph->bitmap_top  = s->face->glyph->bitmap_top;
     glyph->advance     = s->face->glyph->advance.x >> 6;
@@ -287,8 +347,10 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code)
     return 0;
 
 error:
-    if (glyph)
+    if (glyph) {
+        av_freep(&glyph->bitmap);
         av_freep(&glyph->glyph);
+    }
     av_freep(&glyph);
     av_freep(&node);
     return ret;
@@ -484,10 +546,146 @@ static int query_formats(AVFilterContext *ctx)
 
 static int glyph_enu_free(void *opaque, void *elem)
 {
+    Glyph *glyph = elem;
+
+    FT_Done_Glyph(*glyph->glyph);
+    av_freep(&glyph->glyph);
+    av_freep(&glyph->bitmap);
     av_free(elem);
     return 0;
 }
 
+static inline int is_newline(uint32_t c)
+{
+    return c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+/**
+ * Decode the next UTF-8 character before end, return 0 if it is invalid.
+ */
+static uint32_t next_char(const uint8_t **p, const uint8_t *end)
+{
+    uint32_t code;
+
+    GET_UTF8(code, *p < end ? *(*p)++ : 0, return 0;);
+    return code;
+}
+
+static void free_line(TextLine *line)
+{
+    av_freep(&line->text);
+    av_freep(&line->glyphs);
+    av_freep(&line->positions);
+    line->len  = -1;
+    line->size = line->nb_glyphs = 0;
+}
+
+/**
+ * Lay out the line of len bytes at text, unless it is the same as the line
+ * laid out the last time.
+ */
+static int layout_line(AVFilterContext *ctx, TextLine *line,
+                       const char *text, int len)
+{
+    DrawTextContext *s = ctx->priv;
+    const uint8_t *p, *end = (const uint8_t *)text + len;
+    uint32_t code;
+    FT_Vector delta;
+    Glyph *glyph = NULL, *prev_glyph = NULL;
+    Glyph dummy = { 0 };
+    char *t;
+    int width = ctx->inputs[0]->w;
+    int x = 0, n = 0, ret;
+
+    if (line->len == len && !memcmp(line->text, text, len))
+        return 0;
+    line->len = -1;
+
+    if (len > line->size) {
+        Glyph **g = av_realloc(line->glyphs, len * sizeof(*line->glyphs));
+        FT_Vector *v;
+        if (g)
+            line->glyphs = g;
+        v = av_realloc(line->positions, len * sizeof(*line->positions));
+        if (v)
+            line->positions = v;
+        if (!g || !v) {
+            free_line(line);
+            return AVERROR(ENOMEM);
+        }
+        line->size = len;
+    }
+    if (!(t = av_realloc(line->text, len + 1))) {
+        free_line(line);
+        return AVERROR(ENOMEM);
+    }
+    line->text = t;
+
+    /* load and cache glyphs */
+    line->y_min = 32000;
+    line->y_max = -32000;
+    for (p = (const uint8_t *)text; p < end;) {
+        if (!(code = next_char(&p, end)))
+            continue;
+
+        dummy.code = code;
+        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+        if (!glyph) {
+            ret = load_glyph(ctx, &glyph, code);
+            if (ret)
+                return ret;
+        }
+
+        line->y_min = FFMIN(glyph->bbox.yMin, line->y_min);
+        line->y_max = FFMAX(glyph->bbox.yMax, line->y_max);
+    }
+
+    /* compute and save the position of each glyph, the newline ending the
+     * line is not drawn */
+    glyph = NULL;
+    line->w = line->nb_rows = 0;
+    for (p = (const uint8_t *)text; p < end;) {
+        if (!(code = next_char(&p, end)) || is_newline(code))
+            continue;
+
+        /* get glyph */
+        prev_glyph = glyph;
+        dummy.code = code;
+        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+
+        /* kerning */
+        if (s->use_kerning && prev_glyph && glyph->code) {
+            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
+                           ft_kerning_default, &delta);
+            x += delta.x >> 6;
+        }
+
+        if (x + glyph->bbox.xMax >= width) {
+            line->w = FFMAX(line->w, x);
+            line->nb_rows++;
+            x = 0;
+        }
+
+        if (code == '\t') {
+            x = (x / s->tabsize + 1) * s->tabsize;
+            continue;
+        }
+        line->glyphs[n]      = glyph;
+        line->positions[n].x = x + glyph->bitmap_left;
+        line->positions[n].y = line->nb_rows;
+        x += glyph->advance;
+        n++;
+    }
+    line->w = FFMAX(line->w, x);
+    line->nb_rows++;
+    line->nb_glyphs = n;
+
+    memcpy(line->text, text, len);
+    line->len = len;
+
+    return 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     DrawTextContext *s = ctx->priv;
@@ -498,7 +696,10 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_expr_free(s->d_pexpr);
     s->x_pexpr = s->y_pexpr = s->d_pexpr = NULL;
     av_freep(&s->expanded_text);
-    av_freep(&s->positions);
+    for (i = 0; i < s->lines_size; i++)
+        free_line(&s->lines[i]);
+    av_freep(&s->lines);
+    av_freep(&s->layout_text);
     av_tree_enumerate(s->glyphs, NULL, NULL, glyph_enu_free);
     av_tree_destroy(s->glyphs);
     s->glyphs = 0;
@@ -512,27 +713,16 @@ static av_cold void uninit(AVFilterContext *ctx)
 
 }
 
-static inline int is_newline(uint32_t c)
-{
-    return c == '\n' || c == '\r' || c == '\f' || c == '\v';
-}
-
 static int dtext_prepare_text(AVFilterContext *ctx)
 {
     DrawTextContext *s = ctx->priv;
-    uint32_t code = 0, prev_code = 0;
-    int x = 0, y = 0, i = 0, ret;
-    int text_height, baseline;
     char *text = s->text;
-    uint8_t *p;
-    int str_w = 0, len;
+    const char *p;
+    int i, n, ret;
+    int str_w = 0, nb_rows = 0;
     int y_min = 32000, y_max = -32000;
-    FT_Vector delta;
-    Glyph *glyph = NULL, *prev_glyph = NULL;
-    Glyph dummy = { 0 };
     int width  = ctx->inputs[0]->w;
     int height = ctx->inputs[0]->h;
-
 #if HAVE_LOCALTIME_R
     time_t now = time(0);
     struct tm ltime;
@@ -557,88 +747,60 @@ static int dtext_prepare_text(AVFilterContext *ctx)
     s->expanded_text_size = buf_size;
 #endif
 
-    if ((len = strlen(text)) > s->nb_positions) {
-        FT_Vector *p = av_realloc(s->positions,
-                                  len * sizeof(*s->positions));
-        if (!p) {
-            av_freep(s->positions);
-            s->nb_positions = 0;
-            return AVERROR(ENOMEM);
-        } else {
-            s->positions = p;
-            s->nb_positions = len;
-        }
-    }
-
-    /* load and cache glyphs */
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p++, continue;);
-
-        /* get glyph */
-        dummy.code = code;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-        if (!glyph) {
-            ret = load_glyph(ctx, &glyph, code);
-            if (ret)
-                return ret;
+    /* the layout only depends on the text, which often stays the same
+     * for many frames */
+    if (s->layout_text && !strcmp(text, s->layout_text))
+        return 0;
+    av_freep(&s->layout_text);
+
+    /* split the text at each newline, \r\n ending a single line, and lay
+     * out the lines which changed */
+    for (n = 0, p = text;; n++) {
+        const char *end = p + strcspn(p, "\n\r\f\v");
+        int last = !*end;
+
+        if (!last)
+            end += end[0] == '\r' && end[1] == '\n' ? 2 : 1;
+
+        if (n >= s->lines_size) {
+            TextLine *lines = av_realloc(s->lines, (n + 1) * sizeof(*s->lines));
+            if (!lines)
+                return AVERROR(ENOMEM);
+            s->lines = lines;
+            memset(&s->lines[n], 0, sizeof(*s->lines));
+            s->lines[n].len = -1;
+            s->lines_size   = n + 1;
         }
+        if ((ret = layout_line(ctx, &s->lines[n], p, end - p)) < 0)
+            return ret;
 
-        y_min = FFMIN(glyph->bbox.yMin, y_min);
-        y_max = FFMAX(glyph->bbox.yMax, y_max);
+        if (last)
+            break;
+        p = end;
     }
-    text_height = y_max - y_min;
-    baseline    = y_max;
-
-    /* compute and save position for each glyph */
-    glyph = NULL;
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p++, continue;);
+    s->nb_lines = n + 1;
 
-        /* skip the \n in the sequence \r\n */
-        if (prev_code == '\r' && code == '\n')
-            continue;
-
-        prev_code = code;
-        if (is_newline(code)) {
-            str_w = FFMAX(str_w, x - s->x);
-            y += text_height;
-            x = 0;
-            continue;
-        }
-
-        /* get glyph */
-        prev_glyph = glyph;
-        dummy.code = code;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-
-        /* kerning */
-        if (s->use_kerning && prev_glyph && glyph->code) {
-            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
-                           ft_kerning_default, &delta);
-            x += delta.x >> 6;
-        }
-
-        if (x + glyph->bbox.xMax >= width) {
-            str_w = FFMAX(str_w, x);
-            y += text_height;
-            x = 0;
-        }
+    for (i = 0; i < s->nb_lines; i++) {
+        TextLine *line = &s->lines[i];
 
-        /* save position */
-        s->positions[i].x = x + glyph->bitmap_left;
-        s->positions[i].y = y - glyph->bitmap_top + baseline;
-        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
-        else              x += glyph->advance;
+        y_min     = FFMIN(y_min, line->y_min);
+        y_max     = FFMAX(y_max, line->y_max);
+        str_w     = FFMAX(str_w, line->w);
+        line->row = nb_rows;
+        nb_rows  += line->nb_rows;
     }
+    /* an empty text has no glyphs */
+    s->text_height = FFMAX(y_max - y_min, 0);
+    s->baseline    = y_max;
 
-    str_w = FFMIN(width - 1, FFMAX(str_w, x));
-    y     = FFMIN(y + text_height, height - 1);
-
-    s->w = str_w;
+    s->w = FFMIN(width - 1, str_w);
     s->var_values[VAR_TEXT_W] = s->var_values[VAR_TW] = s->w;
-    s->h = y;
+    s->h = FFMIN(nb_rows * s->text_height, height - 1);
     s->var_values[VAR_TEXT_H] = s->var_values[VAR_TH] = s->h;
 
+    if (!(s->layout_text = av_strdup(text)))
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -648,7 +810,7 @@ static int config_input(AVFilterLink *inlink)
     AVFilterContext *ctx  = inlink->dst;
     DrawTextContext *s = ctx->priv;
     const AVPixFmtDescriptor *pix_desc = av_pix_fmt_desc_get(inlink->format);
-    int ret;
+    int i, ret;
 
     s->hsub = pix_desc->log2_chroma_w;
     s->vsub = pix_desc->log2_chroma_h;
@@ -702,14 +864,14 @@ static int config_input(AVFilterLink *inlink)
 
     s->draw = 1;
 
+    /* the layout depends on the frame width */
+    av_freep(&s->layout_text);
+    for (i = 0; i < s->lines_size; i++)
+        s->lines[i].len = -1;
+
     return dtext_prepare_text(ctx);
 }
 
-#define GET_BITMAP_VAL(r, c)                                            \
-    bitmap->pixel_mode == FT_PIXEL_MODE_MONO ?                          \
-        (bitmap->buffer[(r) * bitmap->pitch + ((c)>>3)] & (0x80 >> ((c)&7))) * 255 : \
-         bitmap->buffer[(r) * bitmap->pitch +  (c)]
-
 #define SET_PIXEL_YUV(frame, yuva_color, val, x, y, hsub, vsub) {           \
     luma_pos    = ((x)          ) + ((y)          ) * frame->linesize[0]; \
     alpha = yuva_color[3] * (val) * 129;                               \
@@ -722,22 +884,34 @@ static int config_input(AVFilterLink *inlink)
     }\
 }
 
-static inline int draw_glyph_yuv(AVFrame *frame, FT_Bitmap *bitmap, unsigned int x,
+#define BLEND_PIXEL(dst, color, alpha) \
+    dst = ((alpha) * (color) + (255*255*129 - (alpha)) * (dst)) >> 23
+
+static inline int draw_glyph_yuv(AVFrame *frame, const Glyph *glyph, unsigned int x,
                                  unsigned int y, unsigned int width, unsigned int height,
                                  const uint8_t yuva_color[4], int hsub, int vsub)
 {
     int r, c, alpha;
-    unsigned int luma_pos, chroma_pos1, chroma_pos2;
-    uint8_t src_val;
+    int color_alpha = yuva_color[3] * 129;
 
-    for (r = 0; r < bitmap->rows && r+y < height; r++) {
-        for (c = 0; c < bitmap->width && c+x < width; c++) {
+    for (r = 0; r < glyph->bitmap_h && r+y < height; r++) {
+        const uint8_t *src = glyph->bitmap + r * glyph->bitmap_w;
+        uint8_t *luma    = frame->data[0] + (y+r) * frame->linesize[0];
+        uint8_t *chroma1 = frame->data[1] + ((y+r) >> vsub) * frame->linesize[1];
+        uint8_t *chroma2 = frame->data[2] + ((y+r) >> vsub) * frame->linesize[2];
+        int chroma_mask  = (y+r) & ((1 << vsub) - 1) ? -1 : (1 << hsub) - 1;
+
+        for (c = 0; c < glyph->bitmap_w && c+x < width; c++) {
             /* get intensity value in the glyph bitmap (source) */
-            src_val = GET_BITMAP_VAL(r, c);
-            if (!src_val)
+            if (!src[c])
                 continue;
 
-            SET_PIXEL_YUV(frame, yuva_color, src_val, c+x, y+r, hsub, vsub);
+            alpha = color_alpha * src[c];
+            BLEND_PIXEL(luma[c+x], yuva_color[0], alpha);
+            if (chroma_mask >= 0 && !((c+x) & chroma_mask)) {
+                BLEND_PIXEL(chroma1[(c+x) >> hsub], yuva_color[1], alpha);
+                BLEND_PIXEL(chroma2[(c+x) >> hsub], yuva_color[2], alpha);
+            }
         }
     }
 
@@ -752,24 +926,27 @@ static inline int draw_glyph_yuv(AVFrame *frame, FT_Bitmap *bitmap, unsigned int
     *(p+b_off) = (alpha * rgba_color[2] + (255*255*129 - alpha) * *(p+b_off)) >> 23; \
 }
 
-static inline int draw_glyph_rgb(AVFrame *frame, FT_Bitmap *bitmap,
+static inline int draw_glyph_rgb(AVFrame *frame, const Glyph *glyph,
                                  unsigned int x, unsigned int y,
                                  unsigned int width, unsigned int height, int pixel_step,
                                  const uint8_t rgba_color[4], const uint8_t rgba_map[4])
 {
     int r, c, alpha;
-    uint8_t *p;
-    uint8_t src_val;
+    int color_alpha = rgba_color[3] * 129;
+
+    for (r = 0; r < glyph->bitmap_h && r+y < height; r++) {
+        const uint8_t *src = glyph->bitmap + r * glyph->bitmap_w;
+        uint8_t *p = frame->data[0] + x * pixel_step + (y+r) * frame->linesize[0];
 
-    for (r = 0; r < bitmap->rows && r+y < height; r++) {
-        for (c = 0; c < bitmap->width && c+x < width; c++) {
+        for (c = 0; c < glyph->bitmap_w && c+x < width; c++, p += pixel_step) {
             /* get intensity value in the glyph bitmap (source) */
-            src_val = GET_BITMAP_VAL(r, c);
-            if (!src_val)
+            if (!src[c])
                 continue;
 
-            SET_PIXEL_RGB(frame, rgba_color, src_val, c+x, y+r, pixel_step,
-                          rgba_map[0], rgba_map[1], rgba_map[2], rgba_map[3]);
+            alpha = color_alpha * src[c];
+            BLEND_PIXEL(p[rgba_map[0]], rgba_color[0], alpha);
+            BLEND_PIXEL(p[rgba_map[1]], rgba_color[1], alpha);
+            BLEND_PIXEL(p[rgba_map[2]], rgba_color[2], alpha);
         }
     }
 
@@ -806,35 +983,28 @@ static inline void drawbox(AVFrame *frame, unsigned int x, unsigned int y,
 static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
                        int width, int height, const uint8_t rgbcolor[4], const uint8_t yuvcolor[4], int x, int y)
 {
-    char *text = HAVE_LOCALTIME_R ? s->expanded_text : s->text;
-    uint32_t code = 0;
-    int i;
-    uint8_t *p;
-    Glyph *glyph = NULL;
-
-    for (i = 0, p = text; *p; i++) {
-        Glyph dummy = { 0 };
-        GET_UTF8(code, *p++, continue;);
-
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
-            continue;
-
-        dummy.code = code;
-        glyph = av_tree_find(s->glyphs, &dummy, (void *)glyph_cmp, NULL);
-
-        if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
-            glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
-            return AVERROR(EINVAL);
-
-        if (s->is_packed_rgb) {
-            draw_glyph_rgb(frame, &glyph->bitmap,
-                           s->positions[i].x+x, s->positions[i].y+y, width, height,
-                           s->pixel_step[0], rgbcolor, s->rgba_map);
-        } else {
-            draw_glyph_yuv(frame, &glyph->bitmap,
-                           s->positions[i].x+x, s->positions[i].y+y, width, height,
-                           yuvcolor, s->hsub, s->vsub);
+    int i, j;
+
+    for (i = 0; i < s->nb_lines; i++) {
+        const TextLine *line = &s->lines[i];
+
+        for (j = 0; j < line->nb_glyphs; j++) {
+            const Glyph *glyph = line->glyphs[j];
+            int glyph_x = x + line->positions[j].x;
+            int glyph_y = y + (line->row + line->positions[j].y) * s->text_height +
+                          s->baseline - glyph->bitmap_top;
+
+            if (glyph->pixel_mode != FT_PIXEL_MODE_MONO &&
+                glyph->pixel_mode != FT_PIXEL_MODE_GRAY)
+                return AVERROR(EINVAL);
+
+            if (s->is_packed_rgb) {
+                draw_glyph_rgb(frame, glyph, glyph_x, glyph_y, width, height,
+                               s->pixel_step[0], rgbcolor, s->rgba_map);
+            } else {
+                draw_glyph_yuv(frame, glyph, glyph_x, glyph_y, width, height,
+                               yuvcolor, s->hsub, s->vsub);
+            }
         }
     }
 
@@ -167,6 +167,7 @@ static const AVFilterPad avfilter_vf_fieldorder_inputs[] = {
         .type             = AVMEDIA_TYPE_VIDEO,
         .config_props     = config_input,
         .filter_frame     = filter_frame,
+        .get_video_buffer = ff_null_get_video_buffer,
         .needs_writable   = 1,
     },
     { NULL }
@@ -79,20 +79,35 @@ void ff_gradfun_blur_line_c(uint16_t *dc, uint16_t *buf, uint16_t *buf1, uint8_t
     }
 }
 
-static void filter(GradFunContext *ctx, uint8_t *dst, uint8_t *src, int width, int height, int dst_linesize, int src_linesize, int r)
+static void filter(GradFunContext *ctx, uint16_t *buffer, uint8_t *dst, uint8_t *src, int width, int height, int dst_linesize, int src_linesize, int r, int slice_start, int slice_end)
 {
     int bstride = FFALIGN(width, 16) / 2;
     int y;
     uint32_t dc_factor = (1 << 21) / (r * r);
-    uint16_t *dc = ctx->buf + 16;
-    uint16_t *buf = ctx->buf + bstride + 32;
+    uint16_t *dc = buffer + 16;
+    uint16_t *buf = buffer + bstride + 32;
     int thresh = ctx->thresh;
 
     memset(dc, 0, (bstride + 16) * sizeof(*buf));
-    for (y = 0; y < r; y++)
-        ctx->blur_line(dc, buf + y * bstride, buf + (y - 1) * bstride, src + 2 * y * src_linesize, src_linesize, width / 2);
+    if (!slice_start) {
+        for (y = 0; y < r; y++)
+            ctx->blur_line(dc, buf + y * bstride, buf + (y - 1) * bstride, src + 2 * y * src_linesize, src_linesize, width / 2);
+    } else {
+        /* Fill the ring buffer with the r line pairs preceding the slice.
+         * The running sums start from a different line than in the first
+         * slice, but only their differences are used, so the blurred values
+         * are the same. */
+        int start = slice_start / 2 - r / 2;
+        for (y = start; y < start + r; y++) {
+            int mod = y % r;
+            uint16_t *buf1 = y == start ? buf - bstride : buf + (mod ? mod - 1 : r - 1) * bstride;
+            ctx->blur_line(dc, buf + mod * bstride, buf1, src + 2 * y * src_linesize, src_linesize, width / 2);
+        }
+        y = slice_start;
+    }
     for (;;) {
-        if (y < height - r) {
+        /* the blur reads the lines y + r and y + r + 1 */
+        if (y < height - r - 1) {
             int mod = ((y + r) / 2) % r;
             uint16_t *buf0 = buf + mod * bstride;
             uint16_t *buf1 = buf + (mod ? mod - 1 : r - 1) * bstride;
@@ -109,14 +124,14 @@ static void filter(GradFunContext *ctx, uint8_t *dst, uint8_t *src, int width, i
             for (x = -r / 2; x < 0; x++)
                 dc[x] = dc[0];
         }
-        if (y == r) {
+        if (y == r && !slice_start) {
             for (y = 0; y < r; y++)
                 ctx->filter_line(dst + y * dst_linesize, src + y * src_linesize, dc - r / 2, width, thresh, dither[y & 7]);
         }
         ctx->filter_line(dst + y * dst_linesize, src + y * src_linesize, dc - r / 2, width, thresh, dither[y & 7]);
-        if (++y >= height) break;
+        if (++y >= slice_end) break;
         ctx->filter_line(dst + y * dst_linesize, src + y * src_linesize, dc - r / 2, width, thresh, dither[y & 7]);
-        if (++y >= height) break;
+        if (++y >= slice_end) break;
     }
     emms_c();
 }
@@ -162,13 +177,17 @@ static int query_formats(AVFilterContext *ctx)
 
 static int config_input(AVFilterLink *inlink)
 {
-    GradFunContext *s = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    GradFunContext *s = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     int hsub = desc->log2_chroma_w;
     int vsub = desc->log2_chroma_h;
+    int nb_bufs = FFMAX(1, ctx->graph->nb_threads);
+
+    s->buf_size = FFALIGN(FFALIGN(inlink->w, 16) * (s->radius + 1) / 2 + 32, 16);
 
     av_freep(&s->buf);
-    s->buf = av_mallocz((FFALIGN(inlink->w, 16) * (s->radius + 1) / 2 + 32) * sizeof(uint16_t));
+    s->buf = av_mallocz(nb_bufs * s->buf_size * sizeof(uint16_t));
     if (!s->buf)
         return AVERROR(ENOMEM);
 
@@ -179,14 +198,43 @@ static int config_input(AVFilterLink *inlink)
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int plane, w, h, r;
+} ThreadData;
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    GradFunContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int p = td->plane;
+    int h = td->h;
+    int r = td->r;
+    /* the slices are split between the first and last r lines, which are
+     * filtered with the blur of the closest r line pairs */
+    int nb_pairs    = (h - 2 * r) / 2;
+    int slice_start = jobnr ? r + 2 * (nb_pairs * jobnr / nb_jobs) : 0;
+    int slice_end   = jobnr < nb_jobs - 1 ? r + 2 * (nb_pairs * (jobnr + 1) / nb_jobs) : h;
+
+    filter(s, s->buf + jobnr * s->buf_size,
+           td->out->data[p], td->in->data[p], td->w, h,
+           td->out->linesize[p], td->in->linesize[p], r,
+           slice_start, slice_end);
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
-    GradFunContext *s = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterContext *ctx = inlink->dst;
+    GradFunContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out;
     int p, direct;
 
-    if (av_frame_is_writable(in)) {
+    /* the slices read some lines of the previous one, so they cannot be
+     * filtered in place */
+    if (av_frame_is_writable(in) && ctx->graph->nb_threads <= 1) {
         direct = 1;
         out = in;
     } else {
@@ -212,9 +260,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
             r = s->chroma_r;
         }
 
-        if (FFMIN(w, h) > 2 * r)
-            filter(s, out->data[p], in->data[p], w, h, out->linesize[p], in->linesize[p], r);
-        else if (out->data[p] != in->data[p])
+        if (FFMIN(w, h) > 2 * r) {
+            ThreadData td = { .in = in, .out = out, .plane = p,
+                              .w = w, .h = h, .r = r };
+            int nb_jobs = av_clip(ctx->graph->nb_threads, 1, (h - 2 * r) / 2);
+            ctx->internal->execute(ctx, filter_slice, &td, NULL, nb_jobs);
+        } else if (out->data[p] != in->data[p])
             av_image_copy_plane(out->data[p], out->linesize[p], in->data[p], in->linesize[p], w, h);
     }
 
@@ -241,10 +292,11 @@ static const AVClass gradfun_class = {
 
 static const AVFilterPad avfilter_vf_gradfun_inputs[] = {
     {
-        .name         = "default",
-        .type         = AVMEDIA_TYPE_VIDEO,
-        .config_props = config_input,
-        .filter_frame = filter_frame,
+        .name             = "default",
+        .type             = AVMEDIA_TYPE_VIDEO,
+        .config_props     = config_input,
+        .filter_frame     = filter_frame,
+        .get_video_buffer = ff_null_get_video_buffer,
     },
     { NULL }
 };
@@ -268,4 +320,5 @@ AVFilter ff_vf_gradfun = {
 
     .inputs    = avfilter_vf_gradfun_inputs,
     .outputs   = avfilter_vf_gradfun_outputs,
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -104,7 +104,8 @@ static void denoise_spatial(HQDN3DContext *s,
         dst += dstride;
         frame_ant += w;
         if (s->denoise_row[depth]) {
-            s->denoise_row[depth](src, dst, line_ant, frame_ant, w, spatial, temporal);
+            s->denoise_row[depth](src, dst, line_ant, frame_ant, w, spatial, temporal,
+                                  LOAD(0));
             continue;
         }
         pixel_ant = LOAD(0);
@@ -121,25 +122,32 @@ static void denoise_spatial(HQDN3DContext *s,
 }
 
 av_always_inline
-static void denoise_depth(HQDN3DContext *s,
-                          uint8_t *src, uint8_t *dst,
-                          uint16_t *line_ant, uint16_t **frame_ant_ptr,
-                          int w, int h, int sstride, int dstride,
-                          int16_t *spatial, int16_t *temporal, int depth)
+static void load_frame_ant(uint8_t *src, uint16_t **frame_ant_ptr,
+                           int w, int h, int sstride, int depth)
 {
     // FIXME: For 16bit depth, frame_ant could be a pointer to the previous
     // filtered frame rather than a separate buffer.
     long x, y;
     uint16_t *frame_ant = *frame_ant_ptr;
     if (!frame_ant) {
-        uint8_t *frame_src = src;
         *frame_ant_ptr = frame_ant = av_malloc(w*h*sizeof(uint16_t));
         for (y = 0; y < h; y++, src += sstride, frame_ant += w)
             for (x = 0; x < w; x++)
                 frame_ant[x] = LOAD(x);
-        src = frame_src;
-        frame_ant = *frame_ant_ptr;
     }
+}
+
+av_always_inline
+static void denoise_depth(HQDN3DContext *s,
+                          uint8_t *src, uint8_t *dst,
+                          uint16_t *line_ant, uint16_t **frame_ant_ptr,
+                          int w, int h, int sstride, int dstride,
+                          int16_t *spatial, int16_t *temporal, int depth)
+{
+    uint16_t *frame_ant;
+
+    load_frame_ant(src, frame_ant_ptr, w, h, sstride, depth);
+    frame_ant = *frame_ant_ptr;
 
     if (spatial[0])
         denoise_spatial(s, src, dst, line_ant, frame_ant,
@@ -150,14 +158,174 @@ static void denoise_depth(HQDN3DContext *s,
     emms_c();
 }
 
-#define denoise(...) \
+#define CALL_DEPTH(func, ...) \
     switch (s->depth) {\
-        case  8: denoise_depth(__VA_ARGS__,  8); break;\
-        case  9: denoise_depth(__VA_ARGS__,  9); break;\
-        case 10: denoise_depth(__VA_ARGS__, 10); break;\
-        case 16: denoise_depth(__VA_ARGS__, 16); break;\
+        case  8: func(__VA_ARGS__,  8); break;\
+        case  9: func(__VA_ARGS__,  9); break;\
+        case 10: func(__VA_ARGS__, 10); break;\
+        case 16: func(__VA_ARGS__, 16); break;\
     }
 
+#define denoise(...) CALL_DEPTH(denoise_depth, __VA_ARGS__)
+
+/*
+ * Sliced version of the denoiser.
+ *
+ * The temporal filter only depends on the same pixel in the previous frame,
+ * so it is split in horizontal slices. The spatial filter is recursive in
+ * both directions: the vertical state is per column, so the planes are
+ * split in column stripes, and the horizontal state at the start of each
+ * stripe is computed beforehand for every line, in horizontal slices.
+ */
+typedef struct ThreadData {
+    uint8_t *src, *dst;
+    uint16_t *frame_ant;
+    int w, h, sstride, dstride;
+    int16_t *spatial, *temporal;
+} ThreadData;
+
+av_always_inline
+static void denoise_temporal_slice(ThreadData *td, int jobnr, int nb_jobs,
+                                   int depth)
+{
+    int slice_start = (td->h *  jobnr     ) / nb_jobs;
+    int slice_end   = (td->h * (jobnr + 1)) / nb_jobs;
+
+    denoise_temporal(td->src + slice_start * td->sstride,
+                     td->dst + slice_start * td->dstride,
+                     td->frame_ant + slice_start * td->w,
+                     td->w, slice_end - slice_start, td->sstride, td->dstride,
+                     td->temporal, depth);
+}
+
+av_always_inline
+static void denoise_spatial_edges(HQDN3DContext *s, ThreadData *td,
+                                  int jobnr, int nb_jobs, int depth)
+{
+    int16_t *spatial = td->spatial + (256 << LUT_BITS);
+    int nb_stripes   = s->nb_stripes;
+    int slice_start  = (td->h *  jobnr     ) / nb_jobs;
+    int slice_end    = (td->h * (jobnr + 1)) / nb_jobs;
+    long x, y;
+    int i;
+
+    for (y = slice_start; y < slice_end; y++) {
+        uint8_t *src = td->src + y * td->sstride;
+        uint32_t *edge = s->edge + y * nb_stripes;
+        uint32_t pixel_ant = LOAD(0);
+
+        /* on the first line, the state at the start of a stripe already
+         * includes the last pixel of the previous one, on the other lines
+         * it also includes the first pixel of the stripe */
+        for (x = !!y, i = 1; i < nb_stripes; i++) {
+            long end = (long)td->w * i / nb_stripes + !!y;
+            for (; x < end; x++)
+                pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
+            edge[i] = pixel_ant;
+        }
+    }
+}
+
+av_always_inline
+static void denoise_spatial_stripe(HQDN3DContext *s, ThreadData *td,
+                                   int jobnr, int nb_jobs, int depth)
+{
+    int16_t *spatial  = td->spatial  + (256 << LUT_BITS);
+    int16_t *temporal = td->temporal + (256 << LUT_BITS);
+    int stripe_start  = ((long)td->w *  jobnr     ) / nb_jobs;
+    int stripe_end    = ((long)td->w * (jobnr + 1)) / nb_jobs;
+    uint16_t *line_ant  = s->line;
+    uint16_t *frame_ant = td->frame_ant;
+    uint8_t *src = td->src;
+    uint8_t *dst = td->dst;
+    uint32_t pixel_ant;
+    uint32_t tmp;
+    long x, y;
+
+    pixel_ant = jobnr ? s->edge[jobnr] : LOAD(0);
+    for (x = stripe_start; x < stripe_end; x++) {
+        line_ant[x] = tmp = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
+        frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+        STORE(x, tmp);
+    }
+
+    for (y = 1; y < td->h; y++) {
+        src += td->sstride;
+        dst += td->dstride;
+        frame_ant += td->w;
+        /* the last pixel of the stripe does not update the horizontal
+         * state, as the next stripe already got it from the edges */
+        pixel_ant = jobnr ? s->edge[y * s->nb_stripes + jobnr] : LOAD(0);
+        if (s->denoise_row[depth]) {
+            int offset = stripe_start * (depth == 8 ? 1 : 2);
+            s->denoise_row[depth](src + offset, dst + offset,
+                                  line_ant + stripe_start,
+                                  frame_ant + stripe_start,
+                                  stripe_end - stripe_start,
+                                  spatial, temporal, pixel_ant);
+            continue;
+        }
+        for (x = stripe_start; x < stripe_end - 1; x++) {
+            line_ant[x] = tmp = lowpass(line_ant[x], pixel_ant, spatial, depth);
+            pixel_ant = lowpass(pixel_ant, LOAD(x+1), spatial, depth);
+            frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+            STORE(x, tmp);
+        }
+        line_ant[x] = tmp = lowpass(line_ant[x], pixel_ant, spatial, depth);
+        frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+        STORE(x, tmp);
+    }
+}
+
+static int temporal_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    CALL_DEPTH(denoise_temporal_slice, arg, jobnr, nb_jobs);
+    return 0;
+}
+
+static int spatial_edges_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    CALL_DEPTH(denoise_spatial_edges, s, arg, jobnr, nb_jobs);
+    return 0;
+}
+
+static int spatial_stripe(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    CALL_DEPTH(denoise_spatial_stripe, s, arg, jobnr, nb_jobs);
+    return 0;
+}
+
+static int denoise_threaded(AVFilterContext *ctx, uint8_t *src, uint8_t *dst,
+                            uint16_t **frame_ant_ptr, int w, int h,
+                            int sstride, int dstride,
+                            int16_t *spatial, int16_t *temporal)
+{
+    HQDN3DContext *s = ctx->priv;
+    int nb_threads = ctx->graph->nb_threads;
+    ThreadData td = { .src = src, .dst = dst, .w = w, .h = h,
+                      .sstride = sstride, .dstride = dstride,
+                      .spatial = spatial, .temporal = temporal };
+
+    CALL_DEPTH(load_frame_ant, src, frame_ant_ptr, w, h, sstride);
+    if (!*frame_ant_ptr)
+        return AVERROR(ENOMEM);
+    td.frame_ant = *frame_ant_ptr;
+
+    if (spatial[0]) {
+        s->nb_stripes = FFMIN(nb_threads, w);
+        ctx->internal->execute(ctx, spatial_edges_slice, &td, NULL,
+                               FFMIN(nb_threads, h));
+        ctx->internal->execute(ctx, spatial_stripe, &td, NULL, s->nb_stripes);
+    } else
+        ctx->internal->execute(ctx, temporal_slice, &td, NULL,
+                               FFMIN(nb_threads, h));
+
+    return 0;
+}
+
 static int16_t *precalc_coefs(double dist25, int depth)
 {
     int i;
@@ -212,6 +380,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->coefs[2]);
     av_freep(&s->coefs[3]);
     av_freep(&s->line);
+    av_freep(&s->edge);
     av_freep(&s->frame_prev[0]);
     av_freep(&s->frame_prev[1]);
     av_freep(&s->frame_prev[2]);
@@ -263,6 +432,13 @@ static int config_input(AVFilterLink *inlink)
     if (!s->line)
         return AVERROR(ENOMEM);
 
+    if (inlink->dst->graph->nb_threads > 1) {
+        s->edge = av_malloc_array(inlink->h, inlink->dst->graph->nb_threads *
+                                             sizeof(*s->edge));
+        if (!s->edge)
+            return AVERROR(ENOMEM);
+    }
+
     for (i = 0; i < 4; i++) {
         s->coefs[i] = precalc_coefs(s->strength[i], s->depth);
         if (!s->coefs[i])
@@ -277,10 +453,11 @@ static int config_input(AVFilterLink *inlink)
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
-    HQDN3DContext *s = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterContext *ctx = inlink->dst;
+    HQDN3DContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out;
-    int direct, c;
+    int direct, c, ret;
 
     if (av_frame_is_writable(in)) {
         direct = 1;
@@ -299,6 +476,21 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
 
     for (c = 0; c < 3; c++) {
+        if (s->edge) {
+            ret = denoise_threaded(ctx, in->data[c], out->data[c],
+                                   &s->frame_prev[c],
+                                   in->width  >> (!!c * s->hsub),
+                                   in->height >> (!!c * s->vsub),
+                                   in->linesize[c], out->linesize[c],
+                                   s->coefs[c?2:0], s->coefs[c?3:1]);
+            if (ret < 0) {
+                if (!direct)
+                    av_frame_free(&out);
+                av_frame_free(&in);
+                return ret;
+            }
+            continue;
+        }
         denoise(s, in->data[c], out->data[c],
                 s->line, &s->frame_prev[c],
                 in->width  >> (!!c * s->hsub),
@@ -332,10 +524,11 @@ static const AVClass hqdn3d_class = {
 
 static const AVFilterPad avfilter_vf_hqdn3d_inputs[] = {
     {
-        .name         = "default",
-        .type         = AVMEDIA_TYPE_VIDEO,
-        .config_props = config_input,
-        .filter_frame = filter_frame,
+        .name             = "default",
+        .type             = AVMEDIA_TYPE_VIDEO,
+        .config_props     = config_input,
+        .filter_frame     = filter_frame,
+        .get_video_buffer = ff_null_get_video_buffer,
     },
     { NULL }
 };
@@ -361,4 +554,5 @@ AVFilter ff_vf_hqdn3d = {
     .inputs    = avfilter_vf_hqdn3d_inputs,
 
     .outputs   = avfilter_vf_hqdn3d_outputs,
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
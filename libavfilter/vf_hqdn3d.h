@@ -28,11 +28,13 @@ typedef struct HQDN3DContext {
     const AVClass *class;
     int16_t *coefs[4];
     uint16_t *line;
+    uint32_t *edge;     ///< horizontal state at the start of each column stripe
+    int nb_stripes;
     uint16_t *frame_prev[3];
     double strength[4];
     int hsub, vsub;
     int depth;
-    void (*denoise_row[17])(uint8_t *src, uint8_t *dst, uint16_t *line_ant, uint16_t *frame_ant, ptrdiff_t w, int16_t *spatial, int16_t *temporal);
+    void (*denoise_row[17])(uint8_t *src, uint8_t *dst, uint16_t *line_ant, uint16_t *frame_ant, ptrdiff_t w, int16_t *spatial, int16_t *temporal, int pixel_ant);
 } HQDN3DContext;
 
 #define LUMA_SPATIAL   0
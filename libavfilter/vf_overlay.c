@@ -33,9 +33,11 @@
 #include "libavutil/avassert.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "internal.h"
+#include "overlay.h"
 #include "video.h"
 
 static const char *const var_names[] = {
@@ -86,8 +88,51 @@ typedef struct OverlayContext {
 
     AVFrame *main;
     AVFrame *over_prev, *over_next;
+
+    uint8_t *alpha_buf;         ///< alpha of the chroma samples, for each slice thread
+    int alpha_buf_size;
+
+    OverlayDSPContext dsp;
 } OverlayContext;
 
+#define BLEND_BLOCK 16
+
+static void blend_pixels(uint8_t *dst, const uint8_t *src,
+                         const uint8_t *alpha, int w)
+{
+    int i;
+
+    for (i = 0; i < w; i++)
+        dst[i] = (dst[i] * (255 - alpha[i]) + src[i] * alpha[i] + 128) >> 8;
+}
+
+/**
+ * Overlays are typically mostly transparent or opaque, so the blocks with
+ * a constant alpha of 0 or 255 are done without multiplications: the
+ * blending turns the sample v taken from dst or src into
+ * (255 * v + 128) >> 8, which is v - 1 above 128 and v otherwise.
+ */
+void ff_overlay_blend_row_c(uint8_t *dst, const uint8_t *src,
+                            const uint8_t *alpha, int w)
+{
+    int i, x;
+
+    for (x = 0; x + BLEND_BLOCK <= w; x += BLEND_BLOCK) {
+        uint64_t a0 = AV_RN64(alpha + x);
+        uint64_t a1 = AV_RN64(alpha + x + 8);
+
+        if (!(a0 | a1)) {
+            for (i = x; i < x + BLEND_BLOCK; i++)
+                dst[i] -= dst[i] > 128;
+        } else if ((a0 & a1) == UINT64_MAX) {
+            for (i = x; i < x + BLEND_BLOCK; i++)
+                dst[i] = src[i] - (src[i] > 128);
+        } else
+            blend_pixels(dst + x, src + x, alpha + x, BLEND_BLOCK);
+    }
+    blend_pixels(dst + x, src + x, alpha + x, w - x);
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
@@ -95,6 +140,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&s->main);
     av_frame_free(&s->over_prev);
     av_frame_free(&s->over_next);
+    av_freep(&s->alpha_buf);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -120,6 +166,10 @@ static int config_input_main(AVFilterLink *inlink)
     s->hsub = pix_desc->log2_chroma_w;
     s->vsub = pix_desc->log2_chroma_h;
 
+    s->dsp.blend_row = ff_overlay_blend_row_c;
+    if (ARCH_X86)
+        ff_overlay_init_x86(&s->dsp);
+
     return 0;
 }
 
@@ -176,6 +226,14 @@ static int config_input_overlay(AVFilterLink *inlink)
                (int)var_values[VAR_MAIN_W], (int)var_values[VAR_MAIN_H]);
         return AVERROR(EINVAL);
     }
+
+    s->alpha_buf_size = FFALIGN(inlink->w, BLEND_BLOCK);
+    av_freep(&s->alpha_buf);
+    s->alpha_buf = av_malloc_array(FFMAX(1, ctx->graph->nb_threads),
+                                   s->alpha_buf_size);
+    if (!s->alpha_buf)
+        return AVERROR(ENOMEM);
+
     return 0;
 
 fail:
@@ -195,29 +253,42 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
-static void blend_frame(AVFilterContext *ctx,
-                        AVFrame *dst, AVFrame *src,
-                        int x, int y)
+typedef struct ThreadData {
+    AVFrame *dst, *src;
+    int x, y;
+} ThreadData;
+
+static int blend_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *dst = td->dst, *src = td->src;
+    int x = td->x, y = td->y;
     int i, j, k;
     int width, height;
     int overlay_end_y = y + src->height;
     int end_y, start_y;
+    int nb_blocks, slice_start, slice_end;
 
     width = FFMIN(dst->width - x, src->width);
     end_y = FFMIN(dst->height, overlay_end_y);
     start_y = FFMAX(y, 0);
     height = end_y - start_y;
 
+    /* slices are made of whole chroma lines, so that the alpha averaging
+     * is the same as when blending the whole frame at once */
+    nb_blocks   = FFALIGN(height, 1 << s->vsub) >> s->vsub;
+    slice_start = (nb_blocks *  jobnr     ) / nb_jobs << s->vsub;
+    slice_end   = FFMIN((nb_blocks * (jobnr + 1)) / nb_jobs << s->vsub, height);
+
     if (dst->format == AV_PIX_FMT_BGR24 || dst->format == AV_PIX_FMT_RGB24) {
-        uint8_t *dp = dst->data[0] + x * 3 + start_y * dst->linesize[0];
-        uint8_t *sp = src->data[0];
+        uint8_t *dp = dst->data[0] + x * 3 + (start_y + slice_start) * dst->linesize[0];
+        uint8_t *sp = src->data[0] + slice_start * src->linesize[0];
         int b = dst->format == AV_PIX_FMT_BGR24 ? 2 : 0;
         int r = dst->format == AV_PIX_FMT_BGR24 ? 0 : 2;
         if (y < 0)
             sp += -y * src->linesize[0];
-        for (i = 0; i < height; i++) {
+        for (i = slice_start; i < slice_end; i++) {
             uint8_t *d = dp, *s = sp;
             for (j = 0; j < width; j++) {
                 d[r] = (d[r] * (0xff - s[3]) + s[0] * s[3] + 128) >> 8;
@@ -233,42 +304,65 @@ static void blend_frame(AVFilterContext *ctx,
         for (i = 0; i < 3; i++) {
             int hsub = i ? s->hsub : 0;
             int vsub = i ? s->vsub : 0;
-            uint8_t *dp = dst->data[i] + (x >> hsub) +
-                (start_y >> vsub) * dst->linesize[i];
-            uint8_t *sp = src->data[i];
-            uint8_t *ap = src->data[3];
             int wp = FFALIGN(width, 1<<hsub) >> hsub;
             int hp = FFALIGN(height, 1<<vsub) >> vsub;
+            int j0 = slice_start >> vsub;
+            int j1 = FFMIN(FFALIGN(slice_end, 1<<vsub) >> vsub, hp);
+            uint8_t *dp = dst->data[i] + (x >> hsub) +
+                ((start_y >> vsub) + j0) * dst->linesize[i];
+            uint8_t *sp = src->data[i] + j0 * src->linesize[i];
+            uint8_t *ap = src->data[3] + (j0 << vsub) * src->linesize[3];
             if (y < 0) {
                 sp += ((-y) >> vsub) * src->linesize[i];
                 ap += -y * src->linesize[3];
             }
-            for (j = 0; j < hp; j++) {
-                uint8_t *d = dp, *s = sp, *a = ap;
-                for (k = 0; k < wp; k++) {
-                    // average alpha for color components, improve quality
-                    int alpha_v, alpha_h, alpha;
-                    if (hsub && vsub && j+1 < hp && k+1 < wp) {
-                        alpha = (a[0] + a[src->linesize[3]] +
-                                 a[1] + a[src->linesize[3]+1]) >> 2;
-                    } else if (hsub || vsub) {
-                        alpha_h = hsub && k+1 < wp ?
-                            (a[0] + a[1]) >> 1 : a[0];
-                        alpha_v = vsub && j+1 < hp ?
-                            (a[0] + a[src->linesize[3]]) >> 1 : a[0];
-                        alpha = (alpha_v + alpha_h) >> 1;
-                    } else
-                        alpha = a[0];
-                    *d = (*d * (0xff - alpha) + *s++ * alpha + 128) >> 8;
-                    d++;
-                    a += 1 << hsub;
+            for (j = j0; j < j1; j++) {
+                const uint8_t *alpha = ap;
+
+                if (hsub || vsub) {
+                    uint8_t *alpha_buf = s->alpha_buf + jobnr * s->alpha_buf_size;
+                    uint8_t *a = ap;
+                    for (k = 0; k < wp; k++) {
+                        // average alpha for color components, improve quality
+                        int alpha_v, alpha_h;
+                        if (hsub && vsub && j+1 < hp && k+1 < wp) {
+                            alpha_buf[k] = (a[0] + a[src->linesize[3]] +
+                                            a[1] + a[src->linesize[3]+1]) >> 2;
+                        } else {
+                            alpha_h = hsub && k+1 < wp ?
+                                (a[0] + a[1]) >> 1 : a[0];
+                            alpha_v = vsub && j+1 < hp ?
+                                (a[0] + a[src->linesize[3]]) >> 1 : a[0];
+                            alpha_buf[k] = (alpha_v + alpha_h) >> 1;
+                        }
+                        a += 1 << hsub;
+                    }
+                    alpha = alpha_buf;
                 }
+                s->dsp.blend_row(dp, sp, alpha, wp);
+
                 dp += dst->linesize[i];
                 sp += src->linesize[i];
                 ap += (1 << vsub) * src->linesize[3];
             }
         }
     }
+
+    return 0;
+}
+
+static void blend_frame(AVFilterContext *ctx,
+                        AVFrame *dst, AVFrame *src,
+                        int x, int y)
+{
+    ThreadData td = { .dst = dst, .src = src, .x = x, .y = y };
+    int height = FFMIN(dst->height, y + src->height) - FFMAX(y, 0);
+
+    if (height <= 0)
+        return;
+
+    ctx->internal->execute(ctx, blend_slice, &td, NULL,
+                           FFMIN(height, ctx->graph->nb_threads));
 }
 
 static int filter_frame_main(AVFilterLink *inlink, AVFrame *frame)
@@ -428,4 +522,6 @@ AVFilter ff_vf_overlay = {
 
     .inputs    = avfilter_vf_overlay_inputs,
     .outputs   = avfilter_vf_overlay_outputs,
+
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
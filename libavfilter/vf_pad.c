@@ -273,6 +273,19 @@ static AVFrame *get_video_buffer(AVFilterLink *inlink, int w, int h)
     return frame;
 }
 
+/* get the bounds of a plane of the frame once padded */
+static void padded_plane(PadContext *s, AVFrame *frame, int plane,
+                         uint8_t **start, uint8_t **end)
+{
+    int hsub = (plane == 1 || plane == 2) ? s->hsub : 0;
+    int vsub = (plane == 1 || plane == 2) ? s->vsub : 0;
+
+    *start = frame->data[plane] - (s->x >> hsub) * s->line_step[plane] -
+                                  (s->y >> vsub) * frame->linesize[plane];
+    *end   = *start + ((s->h >> vsub) - 1) * frame->linesize[plane] +
+                      (s->w >> hsub) * s->line_step[plane];
+}
+
 /* check whether each plane in this buffer can be padded without copying */
 static int buffer_needs_copy(PadContext *s, AVFrame *frame, AVBufferRef *buf)
 {
@@ -289,37 +302,23 @@ static int buffer_needs_copy(PadContext *s, AVFrame *frame, AVBufferRef *buf)
      * going over buffer bounds or other planes */
     for (i = 0; i < FF_ARRAY_ELEMS(planes) && planes[i] >= 0; i++) {
         int hsub = (planes[i] == 1 || planes[i] == 2) ? s->hsub : 0;
-        int vsub = (planes[i] == 1 || planes[i] == 2) ? s->vsub : 0;
-
-        uint8_t *start = frame->data[planes[i]];
-        uint8_t *end   = start + (frame->height >> hsub) *
-                                 frame->linesize[planes[i]];
-
-        /* amount of free space needed before the start and after the end
-         * of the plane */
-        ptrdiff_t req_start = (s->x >> hsub) * s->line_step[planes[i]] +
-                              (s->y >> vsub) * frame->linesize[planes[i]];
-        ptrdiff_t req_end   = ((s->w - s->x - frame->width) >> hsub) *
-                              s->line_step[planes[i]] +
-                              (s->y >> vsub) * frame->linesize[planes[i]];
+        uint8_t *start, *end;
 
         if (frame->linesize[planes[i]] < (s->w >> hsub) * s->line_step[planes[i]])
             return 1;
-        if (start - buf->data < req_start ||
-            (buf->data + buf->size) - end < req_end)
+
+        padded_plane(s, frame, planes[i], &start, &end);
+        if (start < buf->data || end > buf->data + buf->size)
             return 1;
 
-#define SIGN(x) ((x) > 0 ? 1 : -1)
         for (j = 0; j < FF_ARRAY_ELEMS(planes) && planes[j] >= 0; j++) {
-            int hsub1 = (planes[j] == 1 || planes[j] == 2) ? s->hsub : 0;
-            uint8_t *start1 = frame->data[planes[j]];
-            uint8_t *end1   = start1 + (frame->height >> hsub1) *
-                                       frame->linesize[planes[j]];
+            uint8_t *start1, *end1;
+
             if (i == j)
                 continue;
 
-            if (SIGN(start - end1) != SIGN(start - end1 - req_start) ||
-                SIGN(end - start1) != SIGN(end - start1 + req_end))
+            padded_plane(s, frame, planes[j], &start1, &end1);
+            if (start < end1 && start1 < end)
                 return 1;
         }
     }
@@ -334,6 +333,12 @@ static int frame_needs_copy(PadContext *s, AVFrame *frame)
     if (!av_frame_is_writable(frame))
         return 1;
 
+    /* the bottom bar starts at the input height rounded down to the chroma
+     * subsampling, so it covers the last lines of the input, which only the
+     * copy writes back */
+    if (frame->height != s->in_h)
+        return 1;
+
     for (i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
         if (buffer_needs_copy(s, frame, frame->buf[i]))
             return 1;
@@ -31,6 +31,7 @@
 #include "internal.h"
 #include "video.h"
 #include "libavutil/avstring.h"
+#include "libavutil/common.h"
 #include "libavutil/eval.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
@@ -72,6 +73,14 @@ typedef struct ScaleContext {
     const AVClass *class;
     struct SwsContext *sws;     ///< software scaler context
 
+    /**
+     * Per-slice scaler contexts, used when the output is split in horizontal
+     * bands scaled concurrently by the slice threads.
+     */
+    struct SwsContext **slice_sws;
+    int *slice_ret;
+    int nb_slices;
+
     /**
      * New dimensions. Special values are:
      *   0 = original width/height
@@ -106,11 +115,23 @@ static av_cold int init(AVFilterContext *ctx)
     return 0;
 }
 
+static void free_slice_contexts(ScaleContext *scale)
+{
+    int i;
+
+    for (i = 0; i < scale->nb_slices; i++)
+        sws_freeContext(scale->slice_sws[i]);
+    av_freep(&scale->slice_sws);
+    av_freep(&scale->slice_ret);
+    scale->nb_slices = 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     ScaleContext *scale = ctx->priv;
     sws_freeContext(scale->sws);
     scale->sws = NULL;
+    free_slice_contexts(scale);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -145,6 +166,53 @@ static int query_formats(AVFilterContext *ctx)
     return 0;
 }
 
+/**
+ * Set up one scaler context per output band if slice threading is available.
+ * Every band is scaled from the whole input, so the vertical filter overlap
+ * between bands is handled by libswscale and the output is identical to the
+ * single threaded one.
+ */
+static int init_slice_contexts(AVFilterContext *ctx)
+{
+    ScaleContext *scale = ctx->priv;
+    AVFilterLink *inlink  = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    int nb_slices, i;
+
+    free_slice_contexts(scale);
+
+    if (!scale->sws || !(ctx->thread_type & AVFILTER_THREAD_SLICE) ||
+        ctx->graph->nb_threads <= 1 || scale->flags & SWS_SRC_V_CHR_DROP_MASK)
+        return 0;
+
+    nb_slices = FFMIN(ctx->graph->nb_threads, outlink->h / SWS_DST_SLICE_ALIGN);
+    if (nb_slices <= 1)
+        return 0;
+
+    scale->slice_sws = av_mallocz(nb_slices * sizeof(*scale->slice_sws));
+    scale->slice_ret = av_mallocz(nb_slices * sizeof(*scale->slice_ret));
+    if (!scale->slice_sws || !scale->slice_ret) {
+        free_slice_contexts(scale);
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < nb_slices; i++) {
+        scale->slice_sws[i] = sws_getContext(inlink ->w, inlink ->h, inlink ->format,
+                                             outlink->w, outlink->h, outlink->format,
+                                             scale->flags, NULL, NULL, NULL);
+        if (!scale->slice_sws[i]) {
+            scale->nb_slices = i;
+            free_slice_contexts(scale);
+            return AVERROR(EINVAL);
+        }
+    }
+    scale->nb_slices = nb_slices;
+
+    av_log(ctx, AV_LOG_DEBUG, "Scaling in %d slices.\n", nb_slices);
+
+    return 0;
+}
+
 static int config_props(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -237,6 +305,8 @@ static int config_props(AVFilterLink *outlink)
             return AVERROR(EINVAL);
     }
 
+    if ((ret = init_slice_contexts(ctx)) < 0)
+        return ret;
 
     if (inlink->sample_aspect_ratio.num)
         outlink->sample_aspect_ratio = av_mul_q((AVRational){outlink->h*inlink->w,
@@ -253,6 +323,27 @@ fail:
     return ret;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int scale_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ScaleContext *scale = ctx->priv;
+    ThreadData *td = arg;
+    int nb_rows = td->out->height / SWS_DST_SLICE_ALIGN;
+    int start   = (nb_rows *  jobnr      / nb_jobs) * SWS_DST_SLICE_ALIGN;
+    int end     = (nb_rows * (jobnr + 1) / nb_jobs) * SWS_DST_SLICE_ALIGN;
+
+    if (jobnr == nb_jobs - 1)
+        end = td->out->height;
+
+    return sws_scale_dst_slice(scale->slice_sws[jobnr],
+                               (const uint8_t * const *)td->in->data,
+                               td->in->linesize, td->out->data,
+                               td->out->linesize, start, end - start);
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     ScaleContext *scale = link->dst->priv;
@@ -281,8 +372,26 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
               (int64_t)in->sample_aspect_ratio.den * outlink->w * link->h,
               INT_MAX);
 
-    sws_scale(scale->sws, in->data, in->linesize, 0, in->height,
-              out->data, out->linesize);
+    if (scale->nb_slices > 1) {
+        ThreadData td = { .in = in, .out = out };
+        int i;
+
+        link->dst->internal->execute(link->dst, scale_slice, &td,
+                                     scale->slice_ret, scale->nb_slices);
+
+        for (i = 0; i < scale->nb_slices; i++)
+            if (scale->slice_ret[i] < 0)
+                break;
+        if (i < scale->nb_slices) {
+            /* some conversions cannot be split in slices */
+            av_log(link->dst, AV_LOG_VERBOSE,
+                   "Slice threading not supported for this conversion.\n");
+            free_slice_contexts(scale);
+        }
+    }
+    if (scale->nb_slices <= 1)
+        sws_scale(scale->sws, in->data, in->linesize, 0, in->height,
+                  out->data, out->linesize);
 
     av_frame_free(&in);
     return ff_filter_frame(outlink, out);
@@ -336,4 +445,6 @@ AVFilter ff_vf_scale = {
 
     .inputs    = avfilter_vf_scale_inputs,
     .outputs   = avfilter_vf_scale_outputs,
+
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
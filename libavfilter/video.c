@@ -24,6 +24,7 @@
 #include "libavutil/mem.h"
 
 #include "avfilter.h"
+#include "framepool.h"
 #include "internal.h"
 #include "video.h"
 
@@ -32,26 +33,9 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
     return ff_get_video_buffer(link->dst->outputs[0], w, h);
 }
 
-/* TODO: set the buffer's priv member to a context structure for the whole
- * filter chain.  This will allow for a buffer pool instead of the constant
- * alloc & free cycle currently implemented. */
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 {
-    AVFrame *frame = av_frame_alloc();
-    int ret;
-
-    if (!frame)
-        return NULL;
-
-    frame->width  = w;
-    frame->height = h;
-    frame->format = link->format;
-
-    ret = av_frame_get_buffer(frame, 32);
-    if (ret < 0)
-        av_frame_free(&frame);
-
-    return frame;
+    return ff_frame_pool_get_video(&link->frame_pool, link->format, w, h, 32);
 }
 
 #if FF_API_AVFILTERBUFFER
@@ -108,7 +92,9 @@ AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
     av_unused char buf[16];
     FF_DPRINTF_START(NULL, get_video_buffer); ff_dlog_link(NULL, link, 0);
 
-    if (link->dstpad->get_video_buffer)
+    /* the destination filter is run by the next pipeline stage, so its
+     * callback must not be called from the stage ending with this link */
+    if (link->dstpad->get_video_buffer && !link->pipeline)
         ret = link->dstpad->get_video_buffer(link, w, h);
 
     if (!ret)
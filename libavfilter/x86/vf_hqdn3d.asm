@@ -43,11 +43,13 @@ SECTION .text
 %endif
 %endmacro
 
+; pixelant is the horizontal state before the first pixel, which is the first
+; pixel itself at the start of a line
 %macro HQDN3D_ROW 1 ; bitdepth
 %if ARCH_X86_64
-cglobal hqdn3d_row_%1_x86, 7,10,0, src, dst, lineant, frameant, width, spatial, temporal, pixelant, t0, t1
+cglobal hqdn3d_row_%1_x86, 8,10,0, src, dst, lineant, frameant, width, spatial, temporal, pixelant, t0, t1
 %else
-cglobal hqdn3d_row_%1_x86, 7,7,0, src, dst, lineant, frameant, width, spatial, temporal
+cglobal hqdn3d_row_%1_x86, 7,7,0, src, dst, lineant, frameant, width, spatial, temporal, pixelant
 %endif
     %assign bytedepth (%1+7)>>3
     %assign lut_bits 4+4*(%1/16)
@@ -69,8 +71,10 @@ cglobal hqdn3d_row_%1_x86, 7,7,0, src, dst, lineant, frameant, width, spatial, t
     %define pixelantq r1
     %define pixelantd r1d
     DECLARE_REG_TMP 2,3
+    mov    pixelantd, pixelantm
+%else
+    mov    pixelantd, pixelantd ; clear the upper half
 %endif
-    LOAD   pixelantd, xq, %1
 ALIGN 16
 .loop:
     movifnidn srcq, srcmp
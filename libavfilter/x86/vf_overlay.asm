@@ -0,0 +1,116 @@
+;*****************************************************************************
+;* x86-optimized functions for overlay filter
+;*
+;* This file is part of Libav.
+;*
+;* Libav is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* Libav is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with Libav; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pw_128: times 16 dw 128
+pb_129: times 32 db 129
+
+SECTION .text
+
+;------------------------------------------------------------------------------
+; void ff_overlay_blend_row(uint8_t *dst, const uint8_t *src,
+;                           const uint8_t *alpha, int w)
+;
+; w is a positive multiple of mmsize. As in the C version, the blocks with a
+; constant alpha of 0 or 255 only have the samples above 128 of dst or src
+; decremented. The other ones are blended with 16-bit products, which do not
+; overflow since dst * (255 - alpha) + src * alpha + 128 < 65536. The bytes
+; are unpacked and packed back within each 128-bit lane, so their order is
+; kept in the AVX2 version as well.
+;------------------------------------------------------------------------------
+
+%macro BLEND_ROW 0
+cglobal overlay_blend_row, 4, 5, 8, dst, src, alpha, w
+    movsxdifnidn    wq, wd
+    add           dstq, wq
+    add           srcq, wq
+    add         alphaq, wq
+    neg             wq
+    pxor            m7, m7
+    pcmpeqb         m6, m6
+.loop:
+    movu            m0, [alphaq+wq]
+    pcmpeqb         m2, m0, m7
+    pmovmskb       r4d, m2
+%if mmsize == 32
+    cmp            r4d, -1
+%else
+    cmp            r4d, 0xffff
+%endif
+    je .transparent
+    pcmpeqb         m2, m0, m6
+    pmovmskb       r4d, m2
+%if mmsize == 32
+    cmp            r4d, -1
+%else
+    cmp            r4d, 0xffff
+%endif
+    je .opaque
+
+    movu            m1, [srcq+wq]
+    movu            m2, [dstq+wq]
+    pxor            m3, m0, m6
+    punpckhbw       m4, m2, m7
+    punpcklbw       m2, m7
+    punpckhbw       m5, m3, m7
+    punpcklbw       m3, m7
+    pmullw          m4, m5
+    pmullw          m2, m3
+    punpckhbw       m5, m1, m7
+    punpcklbw       m1, m7
+    punpckhbw       m3, m0, m7
+    punpcklbw       m0, m7
+    pmullw          m5, m3
+    pmullw          m1, m0
+    paddw           m4, m5
+    paddw           m2, m1
+    paddw           m4, [pw_128]
+    paddw           m2, [pw_128]
+    psrlw           m4, 8
+    psrlw           m2, 8
+    packuswb        m2, m4
+    movu   [dstq+wq], m2
+    jmp .next
+
+.opaque:
+    movu            m1, [srcq+wq]
+    jmp .round
+.transparent:
+    movu            m1, [dstq+wq]
+.round:
+    pmaxub          m2, m1, [pb_129]
+    pcmpeqb         m2, m1
+    paddb           m1, m2
+    movu   [dstq+wq], m1
+.next:
+    add             wq, mmsize
+    jl .loop
+    REP_RET
+%endmacro
+
+INIT_XMM sse2
+BLEND_ROW
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+BLEND_ROW
+%endif
@@ -0,0 +1,64 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/overlay.h"
+
+void ff_overlay_blend_row_sse2(uint8_t *dst, const uint8_t *src,
+                               const uint8_t *alpha, int w);
+void ff_overlay_blend_row_avx2(uint8_t *dst, const uint8_t *src,
+                               const uint8_t *alpha, int w);
+
+/* The SIMD versions only process whole registers, the rest of the row is
+ * left to the next smaller version. */
+
+static void blend_row_sse2(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *alpha, int w)
+{
+    int end = w & ~15;
+
+    if (end > 0)
+        ff_overlay_blend_row_sse2(dst, src, alpha, end);
+    ff_overlay_blend_row_c(dst + end, src + end, alpha + end, w & 15);
+}
+
+#if HAVE_AVX2_EXTERNAL
+static void blend_row_avx2(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *alpha, int w)
+{
+    int end = w & ~31;
+
+    if (end > 0)
+        ff_overlay_blend_row_avx2(dst, src, alpha, end);
+    blend_row_sse2(dst + end, src + end, alpha + end, w & 31);
+}
+#endif
+
+av_cold void ff_overlay_init_x86(OverlayDSPContext *dsp)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE2(cpu_flags))
+        dsp->blend_row = blend_row_sse2;
+#if HAVE_AVX2_EXTERNAL
+    if (EXTERNAL_AVX2(cpu_flags))
+        dsp->blend_row = blend_row_avx2;
+#endif
+}
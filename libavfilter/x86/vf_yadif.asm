@@ -252,3 +252,248 @@ YADIF
 INIT_MMX mmxext
 YADIF
 %endif
+
+; The 16-bit samples are processed in 32-bit lanes, which hold the sums of up
+; to three absolute differences without overflowing.
+
+%macro LOADW 2
+    pmovzxwd  m%1, %2
+%endmacro
+
+%macro CHECK16 6
+    LOADW         0, [curq+t1+2*(%1)]
+    LOADW         1, [curq+t0+2*(%2)]
+    psubd        m0, m1
+    pabsd        m0, m0
+    LOADW         1, [curq+t1+2*(%5)]
+    LOADW         2, [curq+t0+2*(%6)]
+    psubd        m1, m2
+    pabsd        m1, m1
+    paddd        m0, m1
+    LOADW         1, [curq+t1+2*(%3)]
+    LOADW         2, [curq+t0+2*(%4)]
+    mova         m3, m1
+    paddd        m3, m2
+    psrld        m3, 1
+    psubd        m1, m2
+    pabsd        m1, m1
+    paddd        m0, m1
+    mova         m1, m6
+    pcmpgtd      m1, m0
+    pand         m7, m1
+    pxor         m0, m6
+    pand         m0, m7
+    pxor         m6, m0
+    pxor         m3, m5
+    pand         m3, m7
+    pxor         m5, m3
+%endmacro
+
+; Filter mmsize/4 pixels, with the spatial check if %3 is set, and leave them
+; packed in m5. DAVG, the mean of the temporal neighbours, is kept on the
+; stack when the spatial check needs m7.
+%macro FILTER16 4
+%if %3
+    %define DAVG [rsp+0*mmsize]
+%else
+    %define DAVG m7
+%endif
+    LOADW         0, [curq+t1]
+    LOADW         1, [curq+t0]
+    LOADW         2, [%1]
+    LOADW         3, [%2]
+    mova         m4, m2
+    psubd        m4, m3
+    pabsd        m4, m4
+    psrld        m4, 1
+    paddd        m3, m2
+    psrld        m3, 1
+    mova          DAVG, m3
+    LOADW         2, [prevq+t1]
+    LOADW         3, [prevq+t0]
+    psubd        m2, m0
+    psubd        m3, m1
+    pabsd        m2, m2
+    pabsd        m3, m3
+    paddd        m2, m3
+    psrld        m2, 1
+    pmaxsd       m4, m2
+    LOADW         2, [nextq+t1]
+    LOADW         3, [nextq+t0]
+    psubd        m2, m0
+    psubd        m3, m1
+    pabsd        m2, m2
+    pabsd        m3, m3
+    paddd        m2, m3
+    psrld        m2, 1
+    pmaxsd       m4, m2
+    mova         m5, m0
+    paddd        m5, m1
+    psrld        m5, 1
+%if %3
+    mova [rsp+1*mmsize], m0
+    mova [rsp+2*mmsize], m1
+    mova [rsp+3*mmsize], m4
+    mova         m6, m0
+    psubd        m6, m1
+    pabsd        m6, m6
+    LOADW         2, [curq+t1-2]
+    LOADW         3, [curq+t0-2]
+    psubd        m2, m3
+    pabsd        m2, m2
+    paddd        m6, m2
+    LOADW         2, [curq+t1+2]
+    LOADW         3, [curq+t0+2]
+    psubd        m2, m3
+    pabsd        m2, m2
+    paddd        m6, m2
+    pcmpeqd      m7, m7
+    paddd        m6, m7
+
+    CHECK16      -2,  0, -1,  1,  0,  2
+    CHECK16      -3,  1, -2,  2, -1,  3
+    pcmpeqd      m7, m7
+    CHECK16       0, -2,  1, -1,  2,  0
+    CHECK16       1, -3,  2, -2,  3, -1
+
+    mova         m0, [rsp+1*mmsize]
+    mova         m1, [rsp+2*mmsize]
+    mova         m4, [rsp+3*mmsize]
+%endif
+
+    cmp   DWORD r8m, 2
+    jge .end%4
+    LOADW         2, [%1+t1*2]
+    LOADW         3, [%2+t1*2]
+    paddd        m2, m3
+    psrld        m2, 1
+    LOADW         3, [%1+t0*2]
+    LOADW         6, [%2+t0*2]
+    paddd        m3, m6
+    psrld        m3, 1
+    psubd        m2, m0
+    psubd        m3, m1
+    mova         m6, m2
+    pminsd       m6, m3
+    pmaxsd       m2, m3
+    mova         m3, DAVG
+    psubd        m3, m0
+    pmaxsd       m6, m3
+    pminsd       m2, m3
+    mova         m3, DAVG
+    psubd        m3, m1
+    pmaxsd       m6, m3
+    pminsd       m2, m3
+    pmaxsd       m4, m2
+    pxor         m3, m3
+    psubd        m3, m6
+    pmaxsd       m4, m3
+
+.end%4:
+    mova         m2, DAVG
+    mova         m3, m2
+    paddd        m2, m4
+    psubd        m3, m4
+    pminsd       m5, m2
+    pmaxsd       m5, m3
+    packusdw     m5, m5
+%undef DAVG
+%endmacro
+
+%macro FILTER16_LINE 3
+.loop%1:
+    FILTER16 %2, %3, 1, %1
+%if mmsize == 32
+    vpermq       m5, m5, q0020
+    movu     [dstq], xm5
+%else
+    movh     [dstq], m5
+%endif
+    add        dstq, mmsize/2
+    add       prevq, mmsize/2
+    add        curq, mmsize/2
+    add       nextq, mmsize/2
+    sub   DWORD r4m, mmsize/4
+    jg .loop%1
+%endmacro
+
+; The SSE4 version writes up to 3 pixels past the end of the line, which are
+; filtered again by yadif_filter_edges_16bit. The AVX2 version is only called
+; on multiples of 8 pixels.
+%macro YADIF16 0
+%if ARCH_X86_32
+cglobal yadif_filter_line_16bit, 4, 6, 8, 4*mmsize, dst, prev, cur, next, w, \
+                                                   prefs, mrefs, parity, mode
+%else
+cglobal yadif_filter_line_16bit, 4, 7, 8, 4*mmsize, dst, prev, cur, next, w, \
+                                                   prefs, mrefs, parity, mode
+%endif
+    cmp      DWORD wm, 0
+    jle .ret
+%if ARCH_X86_32
+    mov            r4, r5mp
+    mov            r5, r6mp
+    DECLARE_REG_TMP 4,5
+%else
+    movsxd         r5, DWORD r5m
+    movsxd         r6, DWORD r6m
+    DECLARE_REG_TMP 5,6
+%endif
+
+    cmp DWORD paritym, 0
+    je .parity0
+    FILTER16_LINE 1, prevq, curq
+    jmp .ret
+
+.parity0:
+    FILTER16_LINE 0, curq, nextq
+
+.ret:
+    RET
+%endmacro
+
+; The first and last 3 pixels, without the spatial check, which would read
+; outside of the line.
+%macro FILTER16_EDGES 3
+    FILTER16 %2, %3, 0, %1l
+    movd     [dstq], m5
+    pextrw [dstq+4], m5, 2
+    add        dstq, t2
+    add       prevq, t2
+    add        curq, t2
+    add       nextq, t2
+    FILTER16 %2, %3, 0, %1r
+    movd     [dstq], m5
+    pextrw [dstq+4], m5, 2
+%endmacro
+
+INIT_XMM sse4
+cglobal yadif_filter_edges_16bit, 4, 7, 8, dst, prev, cur, next, w, prefs, \
+                                           mrefs, parity, mode
+%if ARCH_X86_32
+    mov            r4, r5mp
+    mov            r5, r6mp
+    mov            r6, r4mp
+    DECLARE_REG_TMP 4,5,6
+%else
+    movsxd         r5, DWORD r5m
+    movsxd         r6, DWORD r6m
+    movsxd         r4, DWORD r4m
+    DECLARE_REG_TMP 5,6,4
+%endif
+    lea            t2, [t2*2-6]
+
+    cmp DWORD paritym, 0
+    je .parity0
+    FILTER16_EDGES 1, prevq, curq
+    RET
+
+.parity0:
+    FILTER16_EDGES 0, curq, nextq
+    RET
+
+YADIF16
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+YADIF16
+%endif
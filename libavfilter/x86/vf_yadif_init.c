@@ -22,7 +22,6 @@
 #include "libavutil/cpu.h"
 #include "libavutil/internal.h"
 #include "libavutil/mem.h"
-#include "libavutil/x86/asm.h"
 #include "libavutil/x86/cpu.h"
 #include "libavfilter/yadif.h"
 
@@ -36,10 +35,52 @@ void ff_yadif_filter_line_ssse3(void *dst, void *prev, void *cur,
                                 void *next, int w, int prefs,
                                 int mrefs, int parity, int mode);
 
+void ff_yadif_filter_line_16bit_sse4(void *dst, void *prev, void *cur,
+                                     void *next, int w, int prefs,
+                                     int mrefs, int parity, int mode);
+void ff_yadif_filter_line_16bit_avx2(void *dst, void *prev, void *cur,
+                                     void *next, int w, int prefs,
+                                     int mrefs, int parity, int mode);
+void ff_yadif_filter_edges_16bit_sse4(void *dst, void *prev, void *cur,
+                                      void *next, int w, int prefs,
+                                      int mrefs, int parity, int mode);
+
+#if HAVE_AVX2_EXTERNAL
+/* The AVX2 version processes whole groups of 8 pixels, so as not to write
+ * past the right edge, and leaves the rest to the SSE4 version. */
+static void yadif_filter_line_16bit_avx2(void *dst, void *prev, void *cur,
+                                         void *next, int w, int prefs,
+                                         int mrefs, int parity, int mode)
+{
+    int w8 = w & ~7;
+
+    if (w8 > 0)
+        ff_yadif_filter_line_16bit_avx2(dst, prev, cur, next, w8,
+                                        prefs, mrefs, parity, mode);
+    ff_yadif_filter_line_16bit_sse4((uint16_t *)dst  + w8,
+                                    (uint16_t *)prev + w8,
+                                    (uint16_t *)cur  + w8,
+                                    (uint16_t *)next + w8, w & 7,
+                                    prefs, mrefs, parity, mode);
+}
+#endif
+
 av_cold void ff_yadif_init_x86(YADIFContext *yadif)
 {
     int cpu_flags = av_get_cpu_flags();
 
+    if (yadif->csp->comp[0].depth_minus1 / 8 == 1) {
+        if (EXTERNAL_SSE4(cpu_flags)) {
+            yadif->filter_line  = ff_yadif_filter_line_16bit_sse4;
+            yadif->filter_edges = ff_yadif_filter_edges_16bit_sse4;
+        }
+#if HAVE_AVX2_EXTERNAL
+        if (EXTERNAL_AVX2(cpu_flags))
+            yadif->filter_line = yadif_filter_line_16bit_avx2;
+#endif
+        return;
+    }
+
 #if ARCH_X86_32
     if (EXTERNAL_MMXEXT(cpu_flags))
         yadif->filter_line = ff_yadif_filter_line_mmxext;
@@ -0,0 +1,218 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "url.h"
+
+/* Stand-in for a remote resource, counting the data fetched from it and the
+ * seeks. The seeks are slow, with a delay set by an option which is given
+ * to the async protocol and has to be passed on to the nested protocol. */
+
+#define RESOURCE_SIZE 1000000
+#define BUFFER_SIZE   65536
+
+typedef struct RemoteContext {
+    const AVClass *class;
+    int64_t pos;
+    int seek_delay;
+} RemoteContext;
+
+static int64_t fetched, nb_seeks;
+static int interrupt;
+
+static uint8_t byte_at(int64_t pos)
+{
+    return (pos * 7 + (pos >> 8)) & 0xff;
+}
+
+static int remote_open(URLContext *h, const char *url, int flags)
+{
+    RemoteContext *c = h->priv_data;
+
+    printf("remote seek delay: %d us\n", c->seek_delay);
+    return 0;
+}
+
+static int remote_read(URLContext *h, unsigned char *buf, int size)
+{
+    RemoteContext *c = h->priv_data;
+    int i;
+
+    /* return short reads, as a network protocol would */
+    size = FFMIN(size, 4096 - c->pos % 4096);
+    size = FFMIN(size, RESOURCE_SIZE - c->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    for (i = 0; i < size; i++)
+        buf[i] = byte_at(c->pos + i);
+    c->pos  += size;
+    fetched += size;
+    return size;
+}
+
+static int64_t remote_seek(URLContext *h, int64_t pos, int whence)
+{
+    RemoteContext *c = h->priv_data;
+
+    if (whence == AVSEEK_SIZE)
+        return RESOURCE_SIZE;
+    if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    av_usleep(c->seek_delay);
+    nb_seeks++;
+    return c->pos = pos;
+}
+
+static int remote_close(URLContext *h)
+{
+    return 0;
+}
+
+static const AVOption remote_options[] = {
+    { "remote_seek_delay", "Duration of the seeks, in microseconds", offsetof(RemoteContext, seek_delay), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL }
+};
+
+static const AVClass remote_class = {
+    .class_name = "remote",
+    .item_name  = av_default_item_name,
+    .option     = remote_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+static URLProtocol remote_protocol = {
+    .name            = "remote",
+    .url_open        = remote_open,
+    .url_read        = remote_read,
+    .url_seek        = remote_seek,
+    .url_close       = remote_close,
+    .priv_data_size  = sizeof(RemoteContext),
+    .priv_data_class = &remote_class,
+};
+
+static int interrupt_cb(void *opaque)
+{
+    return interrupt;
+}
+
+static int64_t get_stat(URLContext *h, const char *name)
+{
+    int64_t val = -1;
+
+    av_opt_get_int(h->priv_data, name, 0, &val);
+    return val;
+}
+
+/* The reading thread stops once BUFFER_SIZE bytes are buffered ahead of the
+ * reader, wait for it so that the counters do not depend on the timing. */
+static int wait_fill(URLContext *h)
+{
+    int i;
+
+    for (i = 0; i < 5000; i++) {
+        if (get_stat(h, "async_fill") >= BUFFER_SIZE)
+            return 0;
+        av_usleep(1000);
+    }
+    printf("the buffer is not filled\n");
+    return 1;
+}
+
+static int check_range(URLContext *h, const char *desc, int64_t pos, int size,
+                       int seek)
+{
+    uint8_t buf[65536];
+    int i, ret, len = 0;
+
+    if (seek && ffurl_seek(h, pos, SEEK_SET) != pos) {
+        printf("seek to %"PRId64" failed\n", pos);
+        return 1;
+    }
+    while (len < size) {
+        ret = ffurl_read(h, buf, FFMIN(size - len, sizeof(buf)));
+        if (ret <= 0) {
+            printf("read at %"PRId64" failed\n", pos + len);
+            return 1;
+        }
+        for (i = 0; i < ret; i++) {
+            if (buf[i] != byte_at(pos + len + i)) {
+                printf("wrong data at %"PRId64"\n", pos + len + i);
+                return 1;
+            }
+        }
+        len += ret;
+    }
+    if (wait_fill(h))
+        return 1;
+    printf("%-16s read %5d bytes at %6"PRId64": fill %6"PRId64", "
+           "%6"PRId64" bytes fetched, %"PRId64" remote seeks, "
+           "%"PRId64" seeks, %"PRId64" inside\n", desc, len, pos,
+           get_stat(h, "async_fill"), fetched, nb_seeks,
+           get_stat(h, "async_seeks"), get_stat(h, "async_seeks_inside"));
+    return 0;
+}
+
+int main(void)
+{
+    AVIOInterruptCB int_cb = { interrupt_cb, NULL };
+    AVDictionary *opts = NULL;
+    URLContext *h;
+    int64_t ret;
+
+    av_register_all();
+    ffurl_register_protocol(&remote_protocol);
+
+    av_dict_set(&opts, "async_buffer_size", "65536", 0);
+    av_dict_set(&opts, "async_back_size", "65536", 0);
+    av_dict_set(&opts, "remote_seek_delay", "300000", 0);
+    ret = ffurl_open(&h, "async:remote:", AVIO_FLAG_READ, &int_cb, &opts);
+    if (ret < 0) {
+        printf("cannot open the async protocol\n");
+        return 1;
+    }
+    printf("options not used: %d\n", av_dict_count(opts));
+    av_dict_free(&opts);
+    if (wait_fill(h))
+        return 1;
+
+    /* the ring holds 128 KiB, the reader is at 30000 and the thread stops
+     * 64 KiB ahead of it */
+    if (check_range(h, "sequential",     0, 30000, 0) ||
+        check_range(h, "back inside", 10000,  5000, 1) ||
+        check_range(h, "forward inside", 90000, 1000, 1) ||
+        check_range(h, "back outside", 10000,  1000, 1))
+        return 1;
+
+    /* give up on a seek while the nested protocol is still seeking, the
+     * reader has to go on with the data following its position */
+    interrupt = 1;
+    ret = ffurl_seek(h, 500000, SEEK_SET);
+    interrupt = 0;
+    printf("seek interrupted: %s\n", ret == AVERROR_EXIT ? "yes" : "no");
+    if (check_range(h, "after abandoned", 11000, 100000, 0))
+        return 1;
+
+    ffurl_close(h);
+    return 0;
+}
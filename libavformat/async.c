@@ -0,0 +1,381 @@
+/*
+ * Asynchronous read-ahead protocol
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Asynchronous read-ahead protocol
+ *
+ * The nested resource is read by a separate thread into a ring buffer,
+ * ahead of the reader. The data already read is kept in the ring as long
+ * as possible, so that the seeks to a position inside the buffered window
+ * are served without touching the nested resource.
+ */
+
+#include <pthread.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+
+#include "avformat.h"
+#include "url.h"
+
+/* size of the reads done on the nested resource */
+#define READ_CHUNK_SIZE 32768
+
+typedef struct AsyncContext {
+    const AVClass *class;
+    URLContext *inner;
+    int buffer_size;            ///< size of the data read ahead
+    int back_size;              ///< size of the data kept behind for seeks
+
+    uint8_t *buf;               ///< ring of buffer_size + back_size bytes
+    int ring_size;
+    int64_t start_pos;          ///< position of the oldest data in the ring
+    int64_t end_pos;            ///< position following the newest data
+    int64_t read_pos;           ///< position of the reader
+    int64_t size;               ///< size of the nested resource, if known
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;        ///< signaled when the ring or the requests change
+    int thread_started;
+    int abort_request;
+    int eof;
+    int error;
+    int seek_request;
+    int seek_serial;            ///< incremented on each seek request
+    int64_t seek_pos;
+    int64_t seek_ret;
+
+    /* statistics */
+    int64_t fill;               ///< size of the data buffered ahead of the reader
+    int64_t nb_reads;
+    int64_t fill_sum;           ///< sum of the fill levels seen by the reads
+    int64_t average_fill;
+    int64_t nb_stalls;          ///< reads which found the ring empty
+    int64_t stall_start;
+    int64_t stall_time;         ///< time spent waiting for the data, in us
+    int64_t nb_seeks;
+    int64_t nb_seeks_inside;    ///< seeks served from the ring
+} AsyncContext;
+
+static int async_check_interrupt(void *arg)
+{
+    URLContext *h   = arg;
+    AsyncContext *c = h->priv_data;
+
+    return c->abort_request || ff_check_interrupt(&h->interrupt_callback);
+}
+
+static void *async_thread(void *arg)
+{
+    URLContext *h   = arg;
+    AsyncContext *c = h->priv_data;
+    int64_t seek_ret;
+    int ret, len, offset;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort_request) {
+        if (c->seek_request) {
+            int64_t pos = c->seek_pos, end_pos = c->end_pos;
+            int serial  = c->seek_serial;
+            pthread_mutex_unlock(&c->mutex);
+
+            seek_ret = ffurl_seek(c->inner, pos, SEEK_SET);
+
+            pthread_mutex_lock(&c->mutex);
+            if (!c->seek_request) {
+                /* the seek was abandoned, the reader still expects the data
+                 * following the ring */
+                if (seek_ret >= 0) {
+                    pthread_mutex_unlock(&c->mutex);
+                    ret = ffurl_seek(c->inner, end_pos, SEEK_SET);
+                    pthread_mutex_lock(&c->mutex);
+                    if (ret < 0 && !c->seek_request)
+                        c->error = ret;
+                }
+                continue;
+            }
+            if (c->seek_serial != serial)
+                continue;
+            if (seek_ret >= 0) {
+                c->start_pos = c->end_pos = c->read_pos = pos;
+                c->fill  = 0;
+                c->eof   = 0;
+                c->error = 0;
+            }
+            c->seek_ret     = seek_ret;
+            c->seek_request = 0;
+            pthread_cond_broadcast(&c->cond);
+            continue;
+        }
+
+        if (c->eof || c->error ||
+            c->end_pos - c->read_pos >= c->buffer_size) {
+            pthread_cond_wait(&c->cond, &c->mutex);
+            continue;
+        }
+
+        /* read into the contiguous space following the newest data,
+         * dropping the oldest data if needed */
+        offset = c->end_pos % c->ring_size;
+        len    = FFMIN(READ_CHUNK_SIZE, c->ring_size - offset);
+        len    = FFMIN(len, c->buffer_size - (c->end_pos - c->read_pos));
+        if (c->end_pos + len - c->start_pos > c->ring_size)
+            c->start_pos = c->end_pos + len - c->ring_size;
+        pthread_mutex_unlock(&c->mutex);
+
+        ret = ffurl_read(c->inner, c->buf + offset, len);
+
+        pthread_mutex_lock(&c->mutex);
+        if (c->seek_request) {
+            /* the data read is not wanted anymore */
+        } else if (ret > 0) {
+            c->end_pos += ret;
+            c->fill     = c->end_pos - c->read_pos;
+        } else if (!ret || ret == AVERROR_EOF) {
+            c->eof = 1;
+        } else if (!c->abort_request) {
+            c->error = ret;
+        }
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+static int async_open(URLContext *h, const char *arg, int flags,
+                      AVDictionary **options)
+{
+    AsyncContext *c = h->priv_data;
+    const AVIOInterruptCB interrupt_callback = { async_check_interrupt, h };
+    int ret;
+
+    av_strstart(arg, "async:", &arg);
+
+    if (flags & AVIO_FLAG_WRITE)
+        return AVERROR(ENOSYS);
+
+    /* the options not used by async are meant for the nested protocol */
+    ret = ffurl_open(&c->inner, arg, flags, &interrupt_callback, options);
+    if (ret < 0)
+        return ret;
+
+    h->is_streamed = c->inner->is_streamed;
+    c->size        = ffurl_size(c->inner);
+
+    c->ring_size = c->buffer_size + c->back_size;
+    c->buf       = av_malloc(c->ring_size);
+    if (!c->buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->cond, NULL);
+
+    ret = pthread_create(&c->thread, NULL, async_thread, h);
+    if (ret) {
+        av_log(h, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        pthread_mutex_destroy(&c->mutex);
+        pthread_cond_destroy(&c->cond);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    c->thread_started = 1;
+
+    return 0;
+
+fail:
+    av_freep(&c->buf);
+    ffurl_close(c->inner);
+    return ret;
+}
+
+static int async_read(URLContext *h, unsigned char *buf, int size)
+{
+    AsyncContext *c = h->priv_data;
+    int len, offset, ret = 0;
+
+    pthread_mutex_lock(&c->mutex);
+
+    if (c->end_pos == c->read_pos && !c->eof && !c->error) {
+        if (!c->stall_start) {
+            c->nb_stalls++;
+            c->stall_start = av_gettime();
+        }
+        if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+            /* wake up regularly for the caller to check the interrupt
+             * callback */
+            int64_t t = av_gettime() + 100000;
+            struct timespec tv = { .tv_sec  =  t / 1000000,
+                                   .tv_nsec = (t % 1000000) * 1000 };
+            pthread_cond_timedwait(&c->cond, &c->mutex, &tv);
+        }
+    }
+
+    if (c->end_pos > c->read_pos) {
+        if (c->stall_start) {
+            c->stall_time += av_gettime() - c->stall_start;
+            c->stall_start = 0;
+        }
+        c->nb_reads++;
+        c->fill_sum += c->end_pos - c->read_pos;
+        c->average_fill = c->fill_sum / c->nb_reads;
+
+        while (size > 0 && c->end_pos > c->read_pos) {
+            offset = c->read_pos % c->ring_size;
+            len    = FFMIN(size, c->end_pos - c->read_pos);
+            len    = FFMIN(len, c->ring_size - offset);
+            memcpy(buf, c->buf + offset, len);
+            buf         += len;
+            size        -= len;
+            ret         += len;
+            c->read_pos += len;
+        }
+        c->fill = c->end_pos - c->read_pos;
+        pthread_cond_broadcast(&c->cond);
+    } else if (c->error) {
+        ret = c->error;
+    } else if (!c->eof) {
+        ret = AVERROR(EAGAIN);
+    }
+
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int64_t async_seek(URLContext *h, int64_t pos, int whence)
+{
+    AsyncContext *c = h->priv_data;
+    int64_t ret;
+
+    if (whence == AVSEEK_SIZE)
+        return c->size;
+
+    pthread_mutex_lock(&c->mutex);
+
+    if (whence == SEEK_CUR) {
+        pos += c->read_pos;
+    } else if (whence == SEEK_END) {
+        if (c->size < 0) {
+            pthread_mutex_unlock(&c->mutex);
+            return AVERROR(EINVAL);
+        }
+        pos += c->size;
+    } else if (whence != SEEK_SET) {
+        pthread_mutex_unlock(&c->mutex);
+        return AVERROR(EINVAL);
+    }
+
+    c->nb_seeks++;
+    if (pos >= c->start_pos && pos <= c->end_pos) {
+        c->nb_seeks_inside++;
+        c->read_pos = pos;
+        c->fill     = c->end_pos - c->read_pos;
+        pthread_cond_broadcast(&c->cond);
+        pthread_mutex_unlock(&c->mutex);
+        return pos;
+    }
+
+    c->seek_request = 1;
+    c->seek_serial++;
+    c->seek_pos     = pos;
+    pthread_cond_broadcast(&c->cond);
+    while (c->seek_request && !c->abort_request) {
+        int64_t t = av_gettime() + 100000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        pthread_cond_timedwait(&c->cond, &c->mutex, &tv);
+        if (c->seek_request && ff_check_interrupt(&h->interrupt_callback)) {
+            c->seek_request = 0;
+            pthread_mutex_unlock(&c->mutex);
+            return AVERROR_EXIT;
+        }
+    }
+    ret = c->seek_ret;
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret < 0 ? ret : pos;
+}
+
+static int async_close(URLContext *h)
+{
+    AsyncContext *c = h->priv_data;
+
+    if (c->thread_started) {
+        pthread_mutex_lock(&c->mutex);
+        c->abort_request = 1;
+        pthread_cond_broadcast(&c->cond);
+        pthread_mutex_unlock(&c->mutex);
+        pthread_join(c->thread, NULL);
+        pthread_mutex_destroy(&c->mutex);
+        pthread_cond_destroy(&c->cond);
+    }
+
+    av_log(h, c->nb_stalls ? AV_LOG_VERBOSE : AV_LOG_DEBUG,
+           "%"PRId64" reads, average fill %"PRId64" bytes, "
+           "%"PRId64" stalls for %.3f s, "
+           "%"PRId64" of %"PRId64" seeks in the buffer.\n",
+           c->nb_reads, c->average_fill,
+           c->nb_stalls, c->stall_time / 1000000.0,
+           c->nb_seeks_inside, c->nb_seeks);
+
+    av_freep(&c->buf);
+    return ffurl_close(c->inner);
+}
+
+#define OFFSET(x) offsetof(AsyncContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+#define E AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
+static const AVOption options[] = {
+    { "async_buffer_size", "Size of the data read ahead", OFFSET(buffer_size), AV_OPT_TYPE_INT, { .i64 = 4 << 20 }, READ_CHUNK_SIZE, INT_MAX / 2, D },
+    { "async_back_size", "Size of the data kept behind the read position for seeking back", OFFSET(back_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 0, INT_MAX / 2, D },
+    { "async_fill", "Size of the data currently buffered ahead of the read position", OFFSET(fill), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "async_reads", "Number of reads which found data", OFFSET(nb_reads), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "async_average_fill", "Average size of the data buffered when reading", OFFSET(average_fill), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "async_stalls", "Number of reads which had to wait for the data", OFFSET(nb_stalls), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "async_stall_time", "Time spent waiting for the data, in microseconds", OFFSET(stall_time), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "async_seeks", "Number of seeks", OFFSET(nb_seeks), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "async_seeks_inside", "Number of seeks served from the buffered data", OFFSET(nb_seeks_inside), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { NULL }
+};
+
+static const AVClass async_class = {
+    .class_name = "async",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+URLProtocol ff_async_protocol = {
+    .name            = "async",
+    .url_open2       = async_open,
+    .url_read        = async_read,
+    .url_seek        = async_seek,
+    .url_close       = async_close,
+    .priv_data_size  = sizeof(AsyncContext),
+    .priv_data_class = &async_class,
+};
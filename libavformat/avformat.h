@@ -843,6 +843,13 @@ typedef struct AVStream {
                                     support seeking natively. */
     int nb_index_entries;
     unsigned int index_entries_allocated_size;
+
+    /**
+     * Predicted dts of the next packet queued for interleaving, from the dts
+     * and duration of the last one, or AV_NOPTS_VALUE if unknown.
+     * Muxing only.
+     */
+    int64_t mux_next_dts;
 } AVStream;
 
 #define AV_PROGRAM_RUNNING 1
@@ -996,6 +1003,7 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_CUSTOM_IO    0x0080 ///< The caller has supplied a custom AVIOContext, don't avio_close() it.
 #define AVFMT_FLAG_DISCARD_CORRUPT  0x0100 ///< Discard frames marked corrupted
 #define AVFMT_FLAG_FLUSH_PACKETS    0x0200 ///< Flush the AVIOContext every packet.
+#define AVFMT_FLAG_LOW_LATENCY      0x0400 ///< When muxing, output interleaved packets as soon as the packet durations show no other stream can precede them.
 
     /**
      * Maximum size of the data read from input for determining
@@ -1134,6 +1142,18 @@ typedef struct AVFormatContext {
      */
     int64_t max_interleave_delta;
 
+    /**
+     * Maximum size in bytes of the packets buffered for interleaving.
+     *
+     * When the packets queued by av_interleaved_write_frame() take more
+     * memory than this, libavformat outputs packets regardless of whether it
+     * has queued a packet for all the streams, as with max_interleave_delta.
+     * 0 means no limit.
+     *
+     * Muxing only, set by the caller before avformat_write_header().
+     */
+    int64_t max_interleave_size;
+
     /*****************************************************************
      * All fields below this line are not part of the public API. They
      * may not be used outside of libavformat and can be changed and
@@ -1622,6 +1642,20 @@ int av_write_frame(AVFormatContext *s, AVPacket *pkt);
  */
 int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt);
 
+/**
+ * Get the amount of data currently buffered by av_interleaved_write_frame()
+ * for interleaving.
+ *
+ * @param s          media file handle
+ * @param nb_packets if not NULL, set to the number of buffered packets
+ * @param size       if not NULL, set to the total size of the buffered
+ *                   packets in bytes
+ *
+ * @see AVFormatContext.max_interleave_size
+ */
+void av_interleaved_queue_size(AVFormatContext *s, int *nb_packets,
+                               int64_t *size);
+
 /**
  * Write the stream trailer to an output media file and free the
  * file private data.
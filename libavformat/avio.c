@@ -72,7 +72,13 @@ static const AVClass *urlcontext_child_class_next(const AVClass *prev)
     return NULL;
 }
 
-static const AVOption options[] = { { NULL } };
+#define OFFSET(x) offsetof(URLContext, x)
+#define E AV_OPT_FLAG_ENCODING_PARAM
+#define D AV_OPT_FLAG_DECODING_PARAM
+static const AVOption options[] = {
+    { "io_buffer_size", "Size of the I/O buffer, the writes of at least this size bypass it", OFFSET(io_buffer_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E|D },
+    { NULL }
+};
 const AVClass ffurl_context_class = {
     .class_name       = "URLContext",
     .item_name        = urlcontext_to_name,
@@ -214,6 +220,8 @@ int ffurl_open(URLContext **puc, const char *filename, int flags,
     int ret = ffurl_alloc(puc, filename, flags, int_cb);
     if (ret)
         return ret;
+    if (options && (ret = av_opt_set_dict(*puc, options)) < 0)
+        goto fail;
     if (options && (*puc)->prot->priv_data_class &&
         (ret = av_opt_set_dict((*puc)->priv_data, options)) < 0)
         goto fail;
@@ -284,6 +292,68 @@ int ffurl_write(URLContext *h, const unsigned char *buf, int size)
     return retry_transfer_wrapper(h, buf, size, size, h->prot->url_write);
 }
 
+int ffurl_writev(URLContext *h, const URLIOVec *iov, int iovcnt)
+{
+    URLIOVec vec[URL_IOV_MAX];
+    int i, ret, len = 0, size = 0;
+    int fast_retries = 5;
+
+    if (!(h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EIO);
+    if (iovcnt > URL_IOV_MAX)
+        return AVERROR(EINVAL);
+
+    if (!h->prot->url_writev || h->max_packet_size) {
+        for (i = 0; i < iovcnt; i++) {
+            ret = ffurl_write(h, iov[i].data, iov[i].size);
+            if (ret < 0)
+                return ret;
+            len += ret;
+            if (ret < iov[i].size)
+                break;
+        }
+        return len;
+    }
+
+    memcpy(vec, iov, iovcnt * sizeof(*vec));
+    for (i = 0; i < iovcnt; i++)
+        size += iov[i].size;
+
+    /* same retry logic as retry_transfer_wrapper(), the blocks written
+     * being dropped from the vector */
+    i = 0;
+    while (len < size) {
+        ret = h->prot->url_writev(h, vec + i, iovcnt - i);
+        if (ret == AVERROR(EINTR))
+            continue;
+        if (h->flags & AVIO_FLAG_NONBLOCK)
+            return ret;
+        if (ret == AVERROR(EAGAIN)) {
+            ret = 0;
+            if (fast_retries)
+                fast_retries--;
+            else
+                av_usleep(1000);
+        } else if (ret < 1)
+            return (ret < 0 && ret != AVERROR_EOF) ? ret : len;
+        if (ret)
+            fast_retries = FFMAX(fast_retries, 2);
+        len += ret;
+        while (ret > 0) {
+            if (ret >= vec[i].size) {
+                ret -= vec[i++].size;
+            } else {
+                vec[i].data += ret;
+                vec[i].size -= ret;
+                ret = 0;
+            }
+        }
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+    }
+    return len;
+}
+
 int64_t ffurl_seek(URLContext *h, int64_t pos, int whence)
 {
     int64_t ret;
@@ -356,6 +426,23 @@ int ffurl_get_file_handle(URLContext *h)
     return h->prot->url_get_file_handle(h);
 }
 
+int ffurl_get_poll_fd(URLContext *h, int *fd, int *events)
+{
+    if (h->prot->url_get_poll_fd)
+        return h->prot->url_get_poll_fd(h, fd, events);
+    if (!h->prot->url_get_file_handle ||
+        (*fd = h->prot->url_get_file_handle(h)) < 0)
+        return AVERROR(ENOSYS);
+    return 0;
+}
+
+int ffurl_get_buffer(URLContext *h, int64_t pos, int size, AVBufferRef **buf)
+{
+    if (!h->prot->url_get_buffer)
+        return AVERROR(ENOSYS);
+    return h->prot->url_get_buffer(h, pos, size, buf);
+}
+
 int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles)
 {
     if (!h->prot->url_get_multi_file_handle) {
@@ -235,6 +235,8 @@ void avio_flush(AVIOContext *s);
 
 /**
  * Read size bytes from AVIOContext into buf.
+ * On a context opened with AVIO_FLAG_NONBLOCK, return the data available
+ * without waiting, or AVERROR(EAGAIN) if there is none.
  * @return number of bytes read or AVERROR
  */
 int avio_read(AVIOContext *s, unsigned char *buf, int size);
@@ -307,9 +309,20 @@ int avio_get_str16be(AVIOContext *pb, int maxlen, char *buf, int buflen);
  * network protocols) but never hang (e.g. on busy devices).
  * Warning: non-blocking protocols is work-in-progress; this flag may be
  * silently ignored.
+ * @see avio_get_poll_fd()
  */
 #define AVIO_FLAG_NONBLOCK 8
 
+/**
+ * @name Events to wait for, returned by avio_get_poll_fd()
+ * @{
+ */
+#define AVIO_POLL_IN  1 /**< wait for the file descriptor to be readable */
+#define AVIO_POLL_OUT 2 /**< wait for the file descriptor to be writable */
+/**
+ * @}
+ */
+
 /**
  * Create and initialize a AVIOContext for accessing the
  * resource indicated by url.
@@ -372,6 +385,27 @@ int avio_close(AVIOContext *s);
  */
 int avio_closep(AVIOContext **s);
 
+/**
+ * Get the file descriptor to wait on, with poll(), epoll or a similar
+ * event loop, before retrying an operation which returned AVERROR(EAGAIN)
+ * on a context opened with AVIO_FLAG_NONBLOCK.
+ *
+ * The data can be buffered at several levels above the file descriptor,
+ * so it is only worth waiting once avio_read() returned AVERROR(EAGAIN).
+ * The file descriptor and the events to wait for may change after each
+ * operation, for instance when a secure connection has to be renegotiated.
+ *
+ * Only reading is supported in non-blocking mode, opening the resource
+ * blocks as documented with AVIO_FLAG_NONBLOCK.
+ *
+ * @param s      context opened by avio_open2()
+ * @param fd     set to the file descriptor
+ * @param events set to the AVIO_POLL_* events to wait for
+ * @return 0 on success, AVERROR(ENOSYS) if the protocol has no file
+ *         descriptor to wait on
+ */
+int avio_get_poll_fd(AVIOContext *s, int *fd, int *events);
+
 
 /**
  * Open a write only memory stream.
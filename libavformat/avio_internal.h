@@ -62,6 +62,17 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
  */
 int ffio_read_partial(AVIOContext *s, unsigned char *buf, int size);
 
+/**
+ * Read size bytes from AVIOContext as a reference to the data of the
+ * underlying protocol, if it can provide one without copying the data.
+ * @param buf set to the reference, the data is writable and followed by
+ *            FF_INPUT_BUFFER_PADDING_SIZE zeroed bytes, so that it can be
+ *            used as the data of a packet
+ * @return size on success, AVERROR(ENOSYS) if the data has to be read
+ *         with avio_read()
+ */
+int ffio_read_buffer(AVIOContext *s, AVBufferRef **buf, int size);
+
 void ffio_fill(AVIOContext *s, int b, int count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
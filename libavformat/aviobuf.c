@@ -162,8 +162,34 @@ void ffio_fill(AVIOContext *s, int b, int count)
     }
 }
 
+/**
+ * Write the buffered data followed by buf with a single vectored write,
+ * without copying buf into the buffer.
+ */
+static void write_direct(AVIOContext *s, const unsigned char *buf, int size)
+{
+    int buffered = s->buf_ptr - s->buffer;
+    URLIOVec iov[2] = { { s->buffer, buffered }, { buf, size } };
+    int ret;
+
+    ret = ffurl_writev(s->opaque, iov + !buffered, 2 - !buffered);
+    if (ret < 0)
+        s->error = ret;
+    s->pos    += buffered + size;
+    s->buf_ptr = s->buffer;
+}
+
 void avio_write(AVIOContext *s, const unsigned char *buf, int size)
 {
+    /* the data that would fill the whole buffer is passed through, the
+     * checksummed and packetized output still has to go through the buffer */
+    if (s->av_class == &ffio_url_class && size >= s->buffer_size &&
+        size <= INT_MAX - s->buffer_size && !s->update_checksum &&
+        !s->max_packet_size && !s->error) {
+        write_direct(s, buf, size);
+        return;
+    }
+
     while (size > 0) {
         int len = FFMIN(s->buf_end - s->buf_ptr, size);
         memcpy(s->buf_ptr, buf, len);
@@ -368,6 +394,10 @@ static void fill_buffer(AVIOContext *s)
     int max_buffer_size = s->max_packet_size ?
                           s->max_packet_size : IO_BUFFER_SIZE;
 
+    if (s->av_class == &ffio_url_class && !s->max_packet_size &&
+        ((URLContext *)s->opaque)->io_buffer_size)
+        max_buffer_size = ((URLContext *)s->opaque)->io_buffer_size;
+
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
         s->eof_reached = 1;
@@ -376,6 +406,10 @@ static void fill_buffer(AVIOContext *s)
     if (s->eof_reached)
         return;
 
+    /* the reads which would have blocked are retried */
+    if (s->error == AVERROR(EAGAIN))
+        s->error = 0;
+
     if (s->update_checksum && dst == s->buffer) {
         if (s->buf_end > s->checksum_ptr)
             s->checksum = s->update_checksum(s->checksum, s->checksum_ptr,
@@ -395,7 +429,10 @@ static void fill_buffer(AVIOContext *s)
         len = s->read_packet(s->opaque, dst, len);
     else
         len = 0;
-    if (len <= 0) {
+    if (len == AVERROR(EAGAIN)) {
+        /* no data available yet in non-blocking mode, not an end of file */
+        s->error = len;
+    } else if (len <= 0) {
         /* do not modify buffer if EOF reached so that a seek back can
            be done without rereading data */
         s->eof_reached = 1;
@@ -453,6 +490,9 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
 {
     int len, size1;
 
+    if (s->error == AVERROR(EAGAIN))
+        s->error = 0;
+
     size1 = size;
     while (size > 0) {
         len = s->buf_end - s->buf_ptr;
@@ -462,7 +502,10 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
             if(size > s->buffer_size && !s->update_checksum){
                 if(s->read_packet)
                     len = s->read_packet(s->opaque, buf, size);
-                if (len <= 0) {
+                if (len == AVERROR(EAGAIN)) {
+                    s->error = len;
+                    break;
+                } else if (len <= 0) {
                     /* do not modify buffer if EOF reached so that a seek back can
                     be done without rereading data */
                     s->eof_reached = 1;
@@ -685,7 +728,7 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     if (max_packet_size) {
         buffer_size = max_packet_size; /* no need to bufferize more than one packet */
     } else {
-        buffer_size = IO_BUFFER_SIZE;
+        buffer_size = h->io_buffer_size ? h->io_buffer_size : IO_BUFFER_SIZE;
     }
     buffer = av_malloc(buffer_size);
     if (!buffer)
@@ -707,6 +750,37 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     return 0;
 }
 
+int ffio_read_buffer(AVIOContext *s, AVBufferRef **buf, int size)
+{
+    URLContext *h = s->opaque;
+    int64_t pos   = avio_tell(s);
+    int64_t ret;
+
+    /* the data read must go through the buffer to be checksummed */
+    if (s->av_class != &ffio_url_class || s->write_flag || s->update_checksum)
+        return AVERROR(ENOSYS);
+
+    ret = ffurl_get_buffer(h, pos, size, buf);
+    if (ret < 0)
+        return ret;
+
+    if (size <= s->buf_end - s->buf_ptr) {
+        s->buf_ptr += size;
+    } else {
+        /* skip the data in the protocol, dropping the buffer */
+        ret = ffurl_seek(h, pos + size, SEEK_SET);
+        if (ret < 0) {
+            av_buffer_unref(buf);
+            return ret;
+        }
+        s->buf_ptr = s->buf_end = s->buffer;
+        s->pos     = pos + size;
+    }
+    s->eof_reached = 0;
+
+    return size;
+}
+
 int ffio_set_buf_size(AVIOContext *s, int buf_size)
 {
     uint8_t *buffer;
@@ -797,6 +871,14 @@ int avio_open2(AVIOContext **s, const char *filename, int flags,
     return 0;
 }
 
+int avio_get_poll_fd(AVIOContext *s, int *fd, int *events)
+{
+    if (s->av_class != &ffio_url_class)
+        return AVERROR(ENOSYS);
+    *events = s->write_flag ? AVIO_POLL_OUT : AVIO_POLL_IN;
+    return ffurl_get_poll_fd(s->opaque, fd, events);
+}
+
 int avio_close(AVIOContext *s)
 {
     URLContext *h;
@@ -0,0 +1,150 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/common.h"
+#include "avformat.h"
+#include "url.h"
+
+/* Stand-in for a remote resource, counting the data fetched from it. */
+
+#define RESOURCE_SIZE 1000000
+
+typedef struct RemoteContext {
+    int64_t pos;
+} RemoteContext;
+
+static int64_t fetched, nb_seeks;
+
+static uint8_t byte_at(int64_t pos)
+{
+    return (pos * 7 + (pos >> 8)) & 0xff;
+}
+
+static int remote_open(URLContext *h, const char *url, int flags)
+{
+    return 0;
+}
+
+static int remote_read(URLContext *h, unsigned char *buf, int size)
+{
+    RemoteContext *c = h->priv_data;
+    int i;
+
+    /* return short reads, as a network protocol would */
+    size = FFMIN(size, 4096 - c->pos % 4096);
+    size = FFMIN(size, RESOURCE_SIZE - c->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    for (i = 0; i < size; i++)
+        buf[i] = byte_at(c->pos + i);
+    c->pos  += size;
+    fetched += size;
+    return size;
+}
+
+static int64_t remote_seek(URLContext *h, int64_t pos, int whence)
+{
+    RemoteContext *c = h->priv_data;
+
+    if (whence == AVSEEK_SIZE)
+        return RESOURCE_SIZE;
+    if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    nb_seeks++;
+    return c->pos = pos;
+}
+
+static int remote_close(URLContext *h)
+{
+    return 0;
+}
+
+static URLProtocol remote_protocol = {
+    .name           = "remote",
+    .url_open       = remote_open,
+    .url_read       = remote_read,
+    .url_seek       = remote_seek,
+    .url_close      = remote_close,
+    .priv_data_size = sizeof(RemoteContext),
+};
+
+static int check_range(URLContext *h, int64_t pos, int size)
+{
+    uint8_t buf[65536];
+    int i, ret, len = 0;
+
+    if (ffurl_seek(h, pos, SEEK_SET) != pos) {
+        printf("seek to %"PRId64" failed\n", pos);
+        return 1;
+    }
+    while (len < size) {
+        ret = ffurl_read(h, buf, FFMIN(size - len, sizeof(buf)));
+        if (!ret || ret == AVERROR_EOF)
+            break;
+        if (ret < 0) {
+            printf("read at %"PRId64" failed\n", pos + len);
+            return 1;
+        }
+        for (i = 0; i < ret; i++) {
+            if (buf[i] != byte_at(pos + len + i)) {
+                printf("wrong data at %"PRId64"\n", pos + len + i);
+                return 1;
+            }
+        }
+        len += ret;
+    }
+    printf("read %7d bytes at %7"PRId64": %7"PRId64" bytes fetched, "
+           "%"PRId64" seeks\n", len, pos, fetched, nb_seeks);
+    return 0;
+}
+
+int main(void)
+{
+    static const struct {
+        int64_t pos;
+        int size;
+    } reads[] = {
+        {      0,   2048 },      /* probing the start */
+        { 900000,  50000 },      /* reading the index at the end */
+        {      0,  10000 },      /* back to the start */
+        { 500000, 100000 },      /* seeking forward */
+        { 400000, 300000 },      /* around the range stored above */
+        { 450000, 200000 },      /* entirely stored */
+        { 950000, 100000 },      /* up to the end of the resource */
+        {      0, RESOURCE_SIZE },
+    };
+    URLContext *h;
+    int i, ret;
+
+    av_register_all();
+    ffurl_register_protocol(&remote_protocol);
+
+    if ((ret = ffurl_open(&h, "cache:remote:", AVIO_FLAG_READ, NULL, NULL)) < 0) {
+        printf("cannot open the cache protocol\n");
+        return 1;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(reads); i++)
+        if (check_range(h, reads[i].pos, reads[i].size))
+            return 1;
+
+    ffurl_close(h);
+    return 0;
+}
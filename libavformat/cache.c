@@ -0,0 +1,310 @@
+/*
+ * Input cache protocol
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Input cache protocol
+ *
+ * The data read from the nested resource is stored in a temporary file, at
+ * the same offset as in the resource, and the ranges stored are indexed in
+ * a tree. The reads inside a stored range are served from the file, so
+ * that reading the same data again or seeking back does not touch the
+ * nested resource.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/tree.h"
+
+#include "avformat.h"
+#include "os_support.h"
+#include "url.h"
+
+typedef struct CacheEntry {
+    int64_t pos;
+    int64_t size;
+} CacheEntry;
+
+typedef struct CacheContext {
+    const AVClass *class;
+    URLContext *inner;
+    char *cache_dir;
+    int fd;
+    struct AVTreeNode *root;    ///< index of the stored ranges, by position
+    int64_t pos;                ///< position of the reader
+    int64_t inner_pos;          ///< position of the nested resource
+    int64_t size;               ///< size of the nested resource, if known
+    int64_t end;                ///< position where the resource ended, if seen
+
+    /* statistics */
+    int64_t hit_bytes;
+    int64_t miss_bytes;
+    int64_t nb_inner_seeks;
+} CacheContext;
+
+static int cmp_pos(void *key, const void *node)
+{
+    const CacheEntry *a = key, *b = node;
+
+    return (a->pos > b->pos) - (a->pos < b->pos);
+}
+
+static int free_entry(void *opaque, void *elem)
+{
+    av_free(elem);
+    return 0;
+}
+
+/**
+ * Find the range containing pos, if any, and the start of the next range.
+ */
+static CacheEntry *find_range(CacheContext *c, int64_t pos, int64_t *next_pos)
+{
+    CacheEntry key = { pos, 0 };
+    CacheEntry *next[2] = { NULL, NULL };
+    CacheEntry *entry;
+
+    entry = av_tree_find(c->root, &key, cmp_pos, (void **)next);
+    if (!entry && next[0] && next[0]->pos + next[0]->size > pos)
+        entry = next[0];
+    *next_pos = next[1] ? next[1]->pos : INT64_MAX;
+
+    return entry;
+}
+
+/**
+ * Add the range [pos, pos + size) to the index, merging it with the ranges
+ * ending at pos and starting at pos + size. The range must not overlap any
+ * range already stored.
+ */
+static int add_range(CacheContext *c, int64_t pos, int64_t size)
+{
+    CacheEntry key = { pos, 0 };
+    CacheEntry *next[2] = { NULL, NULL };
+    CacheEntry *entry;
+    struct AVTreeNode *node;
+
+    av_tree_find(c->root, &key, cmp_pos, (void **)next);
+
+    if (next[0] && next[0]->pos + next[0]->size == pos) {
+        entry        = next[0];
+        entry->size += size;
+    } else {
+        entry = av_malloc(sizeof(*entry));
+        node  = av_tree_node_alloc();
+        if (!entry || !node) {
+            av_free(entry);
+            av_free(node);
+            return AVERROR(ENOMEM);
+        }
+        entry->pos  = pos;
+        entry->size = size;
+        av_tree_insert(&c->root, entry, cmp_pos, &node);
+    }
+
+    if (next[1] && next[1]->pos == entry->pos + entry->size) {
+        CacheEntry *merged = next[1];
+        node = NULL;
+        entry->size += merged->size;
+        av_tree_insert(&c->root, merged, cmp_pos, &node);
+        av_free(node);
+        av_free(merged);
+    }
+
+    return 0;
+}
+
+static int cache_open(URLContext *h, const char *arg, int flags)
+{
+    CacheContext *c = h->priv_data;
+    const char *dir = c->cache_dir;
+    char *filename;
+    int len, ret;
+
+    av_strstart(arg, "cache:", &arg);
+
+    if (flags & AVIO_FLAG_WRITE)
+        return AVERROR(ENOSYS);
+
+    if (!dir || !*dir)
+        dir = getenv("TMPDIR");
+    if (!dir || !*dir)
+        dir = "/tmp";
+    len      = strlen(dir) + sizeof("/avcache.XXXXXX");
+    filename = av_malloc(len);
+    if (!filename)
+        return AVERROR(ENOMEM);
+    snprintf(filename, len, "%s/avcache.XXXXXX", dir);
+    c->fd = mkstemp(filename);
+    if (c->fd < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Failed to create the cache file %s\n",
+               filename);
+        av_free(filename);
+        return ret;
+    }
+    /* the file is only reached through the descriptor */
+    unlink(filename);
+    av_free(filename);
+
+    ret = ffurl_open(&c->inner, arg, flags, &h->interrupt_callback, NULL);
+    if (ret < 0) {
+        close(c->fd);
+        return ret;
+    }
+
+    h->is_streamed = c->inner->is_streamed;
+    c->size        = ffurl_size(c->inner);
+    c->end         = -1;
+
+    return 0;
+}
+
+static int cache_read(URLContext *h, unsigned char *buf, int size)
+{
+    CacheContext *c = h->priv_data;
+    CacheEntry *entry;
+    int64_t next_pos, r;
+    int ret;
+
+    if (c->pos == c->end)
+        return AVERROR_EOF;
+
+    entry = find_range(c, c->pos, &next_pos);
+    if (entry) {
+        size = FFMIN(size, entry->pos + entry->size - c->pos);
+        r    = lseek(c->fd, c->pos, SEEK_SET);
+        if (r >= 0) {
+            ret = read(c->fd, buf, size);
+            if (ret > 0) {
+                c->pos       += ret;
+                c->hit_bytes += ret;
+                return ret;
+            }
+        }
+        av_log(h, AV_LOG_ERROR, "Failed to read from the cache file\n");
+        return AVERROR(EIO);
+    }
+
+    if (c->inner_pos != c->pos) {
+        r = ffurl_seek(c->inner, c->pos, SEEK_SET);
+        if (r < 0)
+            return r;
+        c->inner_pos = c->pos;
+        c->nb_inner_seeks++;
+    }
+
+    /* do not read again the data stored in the next range */
+    size = FFMIN(size, next_pos - c->pos);
+    ret  = ffurl_read(c->inner, buf, size);
+    if (!ret || ret == AVERROR_EOF) {
+        c->end = c->pos;
+        return AVERROR_EOF;
+    }
+    if (ret < 0)
+        return ret;
+
+    r = lseek(c->fd, c->pos, SEEK_SET);
+    if (r < 0 || write(c->fd, buf, ret) != ret) {
+        av_log(h, AV_LOG_WARNING, "Failed to write to the cache file\n");
+    } else {
+        r = add_range(c, c->pos, ret);
+        if (r < 0)
+            return r;
+    }
+
+    c->pos        += ret;
+    c->inner_pos  += ret;
+    c->miss_bytes += ret;
+
+    return ret;
+}
+
+static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
+{
+    CacheContext *c = h->priv_data;
+
+    if (whence == AVSEEK_SIZE)
+        return c->size;
+
+    if (whence == SEEK_CUR) {
+        pos += c->pos;
+    } else if (whence == SEEK_END) {
+        if (c->size < 0)
+            return AVERROR(EINVAL);
+        pos += c->size;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    /* the nested resource is only seeked when reading outside the cache */
+    c->pos = pos;
+
+    return pos;
+}
+
+static int cache_close(URLContext *h)
+{
+    CacheContext *c = h->priv_data;
+
+    av_log(h, AV_LOG_VERBOSE,
+           "%"PRId64" bytes read from the cache, %"PRId64" bytes fetched, "
+           "%"PRId64" seeks in the nested resource.\n",
+           c->hit_bytes, c->miss_bytes, c->nb_inner_seeks);
+
+    close(c->fd);
+    av_tree_enumerate(c->root, NULL, NULL, free_entry);
+    av_tree_destroy(c->root);
+    c->root = NULL;
+
+    return ffurl_close(c->inner);
+}
+
+#define OFFSET(x) offsetof(CacheContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+static const AVOption options[] = {
+    { "cache_dir", "Directory of the temporary cache file", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { NULL }
+};
+
+static const AVClass cache_class = {
+    .class_name = "cache",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+URLProtocol ff_cache_protocol = {
+    .name            = "cache",
+    .url_open        = cache_open,
+    .url_read        = cache_read,
+    .url_seek        = cache_seek,
+    .url_close       = cache_close,
+    .priv_data_size  = sizeof(CacheContext),
+    .priv_data_class = &cache_class,
+};
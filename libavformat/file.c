@@ -20,6 +20,7 @@
  */
 
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
@@ -30,8 +31,18 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <sys/stat.h>
+#if HAVE_WRITEV
+#include <sys/uio.h>
+#endif
 #include <stdlib.h>
+#if CONFIG_IO_URING
+#include <pthread.h>
+#include "iouring.h"
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -42,10 +53,41 @@ typedef struct FileContext {
     const AVClass *class;
     int fd;
     int trunc;
+    int use_mmap;
+    int readahead;
+#if HAVE_MMAP
+    AVBufferRef *map;           ///< mapping of the whole file
+    int64_t map_size;
+    int64_t pos;                ///< read position in the mapping
+    int64_t advised_end;        ///< end of the range advised to be read ahead
+    int64_t bytes_read;
+    int64_t run_start;          ///< bytes_read at the last seek outside of
+                                ///  the read ahead range
+    int random;                 ///< access pattern considered random
+#endif
+    int use_io_uring;
+    int io_uring_depth;
+#if CONFIG_IO_URING
+    int uring;                  ///< the reads or writes go through the ring
+    int writing;
+    struct FileBlock *blocks;
+    int nb_blocks;
+    int head;                   ///< oldest block read ahead
+    int nb_used;                ///< blocks read ahead
+    int cur;                    ///< block being filled for writing, or -1
+    int nb_inflight;
+    int64_t io_pos;             ///< position of the reader or writer
+    int64_t next_pos;           ///< position of the next block read ahead
+    int error;                  ///< error of a write completed
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
     { "truncate", "Truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Map the file in memory when reading and point the packets into it", offsetof(FileContext, use_mmap), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead", "Size of the mapped data read ahead of the read position", offsetof(FileContext, readahead), AV_OPT_TYPE_INT, { .i64 = 8 << 20 }, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring", "Read ahead and write behind through io_uring", offsetof(FileContext, use_io_uring), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_depth", "Number of blocks read ahead or written behind through io_uring", offsetof(FileContext, io_uring_depth), AV_OPT_TYPE_INT, { .i64 = 8 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -56,18 +98,661 @@ static const AVClass file_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_MMAP
+/* smaller packets are copied, which is cheaper than mapping them */
+#define MAP_MIN_PACKET_SIZE (64 * 1024)
+
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+static void file_set_access_pattern(URLContext *h, int random)
+{
+    FileContext *c = h->priv_data;
+
+    if (random == c->random)
+        return;
+    av_log(h, AV_LOG_DEBUG, "Switching to %s access.\n",
+           random ? "random" : "sequential");
+#if HAVE_POSIX_MADVISE
+    posix_madvise(c->map->data, c->map_size,
+                  random ? POSIX_MADV_RANDOM : POSIX_MADV_SEQUENTIAL);
+#endif
+    c->random = random;
+}
+
+/**
+ * Tell the kernel which part of the mapping is about to be accessed: the
+ * range following the read position when reading sequentially, only the
+ * range requested when seeking around.
+ */
+static void file_advise(URLContext *h, int64_t pos, int size)
+{
+    FileContext *c = h->priv_data;
+    int64_t start, end;
+
+    if (c->random && c->bytes_read - c->run_start >= c->readahead)
+        file_set_access_pattern(h, 0);
+
+    if (c->random) {
+        start = pos;
+        end   = pos + size;
+    } else if (pos + size + c->readahead / 2 > c->advised_end) {
+        start = FFMAX(pos, c->advised_end);
+        end   = FFMIN(pos + size + c->readahead, c->map_size);
+    } else
+        return;
+    c->advised_end = FFMAX(c->advised_end, end);
+
+#if HAVE_POSIX_MADVISE
+    start &= ~(sysconf(_SC_PAGESIZE) - 1);
+    if (end > start)
+        posix_madvise(c->map->data + start, end - start, POSIX_MADV_WILLNEED);
+#endif
+}
+
+/**
+ * Move the read position. The accesses are considered random when less
+ * than the read ahead range was read since the previous seek out of it.
+ */
+static void file_seek_mapped(URLContext *h, int64_t pos)
+{
+    FileContext *c = h->priv_data;
+
+    if (pos < c->pos || pos > c->advised_end) {
+        file_set_access_pattern(h, c->bytes_read - c->run_start < c->readahead);
+        c->run_start   = c->bytes_read;
+        c->advised_end = pos;
+    }
+    c->pos = pos;
+}
+
+static int file_map(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+    void *data;
+
+    if (fstat(c->fd, &st) < 0 || !S_ISREG(st.st_mode) || !st.st_size ||
+        st.st_size > SIZE_MAX)
+        return AVERROR(ENOSYS);
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, c->fd, 0);
+    if (data == MAP_FAILED)
+        return AVERROR(errno);
+
+    /* the size of the file may not fit in the buffer, map_size is used */
+    c->map = av_buffer_create(data, 0, file_unmap,
+                              (void *)(uintptr_t)st.st_size, 0);
+    if (!c->map) {
+        munmap(data, st.st_size);
+        return AVERROR(ENOMEM);
+    }
+    c->map_size = st.st_size;
+#if HAVE_POSIX_MADVISE
+    posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+    return 0;
+}
+
+static int file_read_mapped(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    int ret;
+
+    /* the file grew since it was mapped */
+    if (c->pos >= c->map_size) {
+        if (lseek(c->fd, c->pos, SEEK_SET) < 0)
+            return AVERROR(errno);
+        ret = read(c->fd, buf, size);
+        if (ret > 0)
+            c->pos += ret;
+        return ret;
+    }
+
+    size = FFMIN(size, c->map_size - c->pos);
+    file_advise(h, c->pos, size);
+    memcpy(buf, c->map->data + c->pos, size);
+    c->pos        += size;
+    c->bytes_read += size;
+
+    return size;
+}
+
+/**
+ * Map the range in a private mapping of its own, so that the padding
+ * following the data can be zeroed, and the packet modified in place,
+ * without touching the data seen by the other reads. Only the last page is
+ * copied on the write. The range must not reach the end of the file, the
+ * last packet is copied into a padded buffer instead.
+ */
+static int file_get_buffer(URLContext *h, int64_t pos, int size,
+                           AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+    int64_t start;
+    uint8_t *data;
+    int len;
+
+    if (!c->map || pos < 0 || size < MAP_MIN_PACKET_SIZE ||
+        pos + size + FF_INPUT_BUFFER_PADDING_SIZE > c->map_size)
+        return AVERROR(ENOSYS);
+
+    file_advise(h, pos, size);
+
+    start = pos & ~(int64_t)(sysconf(_SC_PAGESIZE) - 1);
+    len   = pos - start + size + FF_INPUT_BUFFER_PADDING_SIZE;
+    data  = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, c->fd, start);
+    if (data == MAP_FAILED)
+        return AVERROR(errno);
+
+    *buf = av_buffer_create(data, len, file_unmap, (void *)(uintptr_t)len, 0);
+    if (!*buf) {
+        munmap(data, len);
+        return AVERROR(ENOMEM);
+    }
+    (*buf)->data += pos - start;
+    (*buf)->size  = size + FF_INPUT_BUFFER_PADDING_SIZE;
+    memset((*buf)->data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+
+    c->bytes_read += size;
+
+    return 0;
+}
+#endif
+
+#if CONFIG_IO_URING
+#define URING_BLOCK_SIZE (128 * 1024)
+
+/* entries of the ring, and so maximum number of requests in flight */
+#define RING_ENTRIES 256
+
+enum FileBlockState {
+    BLOCK_FREE,
+    BLOCK_FILLING,              ///< being filled with the data to write
+    BLOCK_INFLIGHT,
+    BLOCK_DONE,                 ///< read completed
+};
+
+typedef struct FileBlock {
+    URLContext *h;              ///< context reading or writing the block
+    uint8_t *data;
+    int64_t pos;                ///< position of the data in the file
+    int size;                   ///< size of the data read or written
+    int done;                   ///< size of the data written so far
+    int res;                    ///< result of the read
+    enum FileBlockState state;
+} FileBlock;
+
+/* A single ring is shared by all the files, so that the requests of
+ * several files are submitted with a single system call. The mutex is
+ * held while waiting: whichever context waits processes the completions
+ * of all the files. */
+static struct {
+    IOURing ring;
+    int refcount;
+    int nb_inflight;            ///< requests queued or submitted
+    int nb_unsubmitted;
+} file_ring;
+static pthread_mutex_t file_ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int file_uring_queue(URLContext *h, FileBlock *b);
+
+static int file_ring_submit(void)
+{
+    int ret = ff_iouring_submit(&file_ring.ring, 0, -1);
+    if (ret >= 0)
+        file_ring.nb_unsubmitted = 0;
+    return ret;
+}
+
+/**
+ * Process the completions available, for all the files.
+ */
+static void file_ring_reap(void)
+{
+    struct io_uring_cqe *cqe;
+
+    while ((cqe = ff_iouring_peek_cqe(&file_ring.ring))) {
+        FileBlock *b   = (FileBlock *)(uintptr_t)cqe->user_data;
+        FileContext *c = b->h->priv_data;
+        int ret, res   = cqe->res;
+
+        ff_iouring_cqe_seen(&file_ring.ring);
+        file_ring.nb_inflight--;
+        c->nb_inflight--;
+        if (!c->writing) {
+            b->res   = res;
+            b->state = BLOCK_DONE;
+        } else if (res < 0 || (!res && b->done < b->size)) {
+            if (!c->error)
+                c->error = res < 0 ? AVERROR(-res) : AVERROR(EIO);
+            b->state = BLOCK_FREE;
+        } else if ((b->done += res) < b->size) {
+            if ((ret = file_uring_queue(b->h, b)) < 0 && !c->error)
+                c->error = ret;
+        } else {
+            b->state = BLOCK_FREE;
+        }
+    }
+}
+
+/**
+ * Submit the queued requests, wait for at least one completion if wait is
+ * set, and process the completions.
+ */
+static int file_ring_complete(int wait)
+{
+    int ret = ff_iouring_submit(&file_ring.ring,
+                                wait && file_ring.nb_inflight, -1);
+    if (ret < 0)
+        return ret;
+    file_ring.nb_unsubmitted = 0;
+    file_ring_reap();
+    return 0;
+}
+
+static int file_uring_queue(URLContext *h, FileBlock *b)
+{
+    FileContext *c = h->priv_data;
+    struct io_uring_sqe *sqe;
+    int ret;
+
+    /* the completion queue is twice as large, so it cannot overflow */
+    while (file_ring.nb_inflight >= file_ring.ring.sq_entries)
+        if ((ret = file_ring_complete(1)) < 0)
+            return ret;
+
+    sqe = ff_iouring_get_sqe(&file_ring.ring);
+    sqe->opcode    = c->writing ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd        = c->fd;
+    sqe->addr      = (uintptr_t)(b->data + b->done);
+    sqe->len       = b->size - b->done;
+    sqe->off       = b->pos + b->done;
+    sqe->user_data = (uintptr_t)b;
+    b->state       = BLOCK_INFLIGHT;
+    c->nb_inflight++;
+    file_ring.nb_inflight++;
+
+    /* the requests of all the files count towards the batch */
+    if (++file_ring.nb_unsubmitted >= FFMAX(c->nb_blocks / 2, 1))
+        return file_ring_submit();
+    return 0;
+}
+
+/**
+ * Wait for all the requests of the context, so that its blocks can be
+ * reused and the written data is in the file.
+ */
+static int file_uring_drain(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    int ret;
+
+    while (c->nb_inflight)
+        if ((ret = file_ring_complete(1)) < 0)
+            return ret;
+    return 0;
+}
+
+/**
+ * Queue the reads of the free blocks, following the blocks read ahead.
+ */
+static int file_uring_read_ahead(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    int ret;
+
+    if (!c->nb_used)
+        c->next_pos = c->io_pos;
+    while (c->nb_used < c->nb_blocks) {
+        FileBlock *b = &c->blocks[(c->head + c->nb_used++) % c->nb_blocks];
+        b->pos       = c->next_pos;
+        b->size      = URING_BLOCK_SIZE;
+        b->done      = 0;
+        c->next_pos += URING_BLOCK_SIZE;
+        if ((ret = file_uring_queue(h, b)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+/**
+ * Drop the blocks read ahead, for reading again from io_pos.
+ */
+static int file_uring_reset(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    int ret = file_uring_drain(h);
+
+    c->head    = 0;
+    c->nb_used = 0;
+    return ret;
+}
+
+static int file_uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileBlock *b;
+    int ret, offset, len;
+
+    for (;;) {
+        if (!c->nb_used) {
+            if ((ret = file_uring_read_ahead(h)) < 0 ||
+                (ret = file_ring_submit()) < 0)
+                return ret;
+        }
+        b = &c->blocks[c->head];
+        while (b->state != BLOCK_DONE)
+            if ((ret = file_ring_complete(1)) < 0)
+                return ret;
+
+        if (b->res < 0) {
+            ret = AVERROR(-b->res);
+            file_uring_reset(h);
+            return ret;
+        }
+        offset = c->io_pos - b->pos;
+        if (offset < b->res) {
+            len = FFMIN(size, b->res - offset);
+            memcpy(buf, b->data + offset, len);
+            c->io_pos += len;
+            return len;
+        }
+
+        if (b->res < b->size) {
+            /* end of file, or a short read leaving a gap before the next
+             * block: read again from here on the next call */
+            ret = file_uring_reset(h);
+            if (ret < 0 || !b->res || offset > b->res)
+                return ret;
+            continue;
+        }
+
+        /* the block is consumed, read it again further ahead */
+        c->head = (c->head + 1) % c->nb_blocks;
+        c->nb_used--;
+        if ((ret = file_uring_read_ahead(h)) < 0)
+            return ret;
+    }
+}
+
+static int file_uring_write(URLContext *h, const unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileBlock *b;
+    int i, ret, len, written = 0;
+
+    while (written < size) {
+        if (c->error)
+            return c->error;
+        if (c->cur < 0) {
+            for (i = 0; i < c->nb_blocks; i++)
+                if (c->blocks[i].state == BLOCK_FREE)
+                    break;
+            if (i == c->nb_blocks) {
+                if ((ret = file_ring_complete(1)) < 0)
+                    return ret;
+                continue;
+            }
+            c->cur   = i;
+            b        = &c->blocks[i];
+            b->pos   = c->io_pos;
+            b->size  = 0;
+            b->done  = 0;
+            b->state = BLOCK_FILLING;
+        }
+        b   = &c->blocks[c->cur];
+        len = FFMIN(size - written, URING_BLOCK_SIZE - b->size);
+        memcpy(b->data + b->size, buf + written, len);
+        b->size   += len;
+        c->io_pos += len;
+        written   += len;
+        if (b->size == URING_BLOCK_SIZE) {
+            c->cur = -1;
+            if ((ret = file_uring_queue(h, b)) < 0)
+                return ret;
+        }
+    }
+    /* free the blocks already written, the queued writes are submitted
+     * with the next batch */
+    file_ring_reap();
+    return written;
+}
+
+/**
+ * Write the block being filled and wait for all the writes.
+ */
+static int file_uring_flush(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    int ret;
+
+    if (c->cur >= 0) {
+        FileBlock *b = &c->blocks[c->cur];
+        c->cur = -1;
+        if ((ret = file_uring_queue(h, b)) < 0)
+            return ret;
+    }
+    ret = file_uring_drain(h);
+    return ret < 0 ? ret : c->error;
+}
+
+static int64_t file_uring_seek(URLContext *h, int64_t pos, int whence)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+    int ret;
+
+    if (c->writing) {
+        /* the writes in flight may overlap the data written next */
+        if ((ret = file_uring_flush(h)) < 0)
+            return ret;
+    }
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        if (whence == AVSEEK_SIZE)
+            return st.st_size;
+        pos += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        pos += c->io_pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    if (!c->writing) {
+        /* keep the blocks read ahead when seeking forward into them */
+        while (c->nb_used && c->blocks[c->head].state == BLOCK_DONE &&
+               c->blocks[c->head].res == URING_BLOCK_SIZE &&
+               pos >= c->blocks[c->head].pos + URING_BLOCK_SIZE &&
+               pos < c->next_pos) {
+            c->head = (c->head + 1) % c->nb_blocks;
+            c->nb_used--;
+        }
+        if (c->nb_used && (pos < c->blocks[c->head].pos || pos >= c->next_pos))
+            ret = file_uring_reset(h);
+        else if (c->nb_used)
+            ret = file_uring_read_ahead(h);
+        else
+            ret = 0;
+        if (ret < 0)
+            return ret;
+    }
+    c->io_pos = pos;
+
+    return pos;
+}
+
+static void file_uring_uninit(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    int i;
+
+    if (c->blocks)
+        for (i = 0; i < c->nb_blocks; i++)
+            av_free(c->blocks[i].data);
+    av_freep(&c->blocks);
+    if (c->uring && !--file_ring.refcount)
+        ff_iouring_uninit(&file_ring.ring);
+    c->uring = 0;
+}
+
+static int file_uring_init(URLContext *h, int flags)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+    int i, ret;
+
+    /* the reads and writes are done at explicit positions */
+    if (fstat(c->fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        (flags & AVIO_FLAG_READ && flags & AVIO_FLAG_WRITE)) {
+        av_log(h, AV_LOG_VERBOSE, "Not using io_uring for this file.\n");
+        return 0;
+    }
+
+    if (!file_ring.refcount) {
+        ret = ff_iouring_init(&file_ring.ring, RING_ENTRIES);
+        if (ret < 0)
+            return ret;
+        /* the kernels reporting this feature support IORING_OP_READ/WRITE */
+        if (!(file_ring.ring.features & IORING_FEAT_RW_CUR_POS)) {
+            ff_iouring_uninit(&file_ring.ring);
+            return AVERROR(ENOSYS);
+        }
+    }
+    file_ring.refcount++;
+
+    c->uring     = 1;
+    c->writing   = !!(flags & AVIO_FLAG_WRITE);
+    c->nb_blocks = c->io_uring_depth;
+    c->cur       = -1;
+    c->blocks    = av_mallocz(c->nb_blocks * sizeof(*c->blocks));
+    if (!c->blocks) {
+        file_uring_uninit(h);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < c->nb_blocks; i++) {
+        c->blocks[i].h    = h;
+        c->blocks[i].data = av_malloc(URING_BLOCK_SIZE);
+        if (!c->blocks[i].data) {
+            file_uring_uninit(h);
+            return AVERROR(ENOMEM);
+        }
+    }
+    return 0;
+}
+
+/* The entry points, serialized on the shared ring. */
+
+static int file_read_uring(URLContext *h, unsigned char *buf, int size)
+{
+    int ret;
+
+    pthread_mutex_lock(&file_ring_mutex);
+    ret = file_uring_read(h, buf, size);
+    pthread_mutex_unlock(&file_ring_mutex);
+    return ret;
+}
+
+static int file_writev_uring(URLContext *h, const URLIOVec *iov, int iovcnt)
+{
+    int i, ret = 0, len = 0;
+
+    pthread_mutex_lock(&file_ring_mutex);
+    for (i = 0; i < iovcnt && ret >= 0; i++)
+        if ((ret = file_uring_write(h, iov[i].data, iov[i].size)) > 0)
+            len += ret;
+    pthread_mutex_unlock(&file_ring_mutex);
+    return ret < 0 ? ret : len;
+}
+
+static int64_t file_seek_uring(URLContext *h, int64_t pos, int whence)
+{
+    int64_t ret;
+
+    pthread_mutex_lock(&file_ring_mutex);
+    ret = file_uring_seek(h, pos, whence);
+    pthread_mutex_unlock(&file_ring_mutex);
+    return ret;
+}
+
+static int file_open_uring(URLContext *h, int flags)
+{
+    int ret;
+
+    pthread_mutex_lock(&file_ring_mutex);
+    ret = file_uring_init(h, flags);
+    pthread_mutex_unlock(&file_ring_mutex);
+    return ret;
+}
+
+static int file_close_uring(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    int ret;
+
+    pthread_mutex_lock(&file_ring_mutex);
+    ret = c->writing ? file_uring_flush(h) : file_uring_drain(h);
+    file_uring_uninit(h);
+    pthread_mutex_unlock(&file_ring_mutex);
+    return ret;
+}
+#endif /* CONFIG_IO_URING */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
+#if HAVE_MMAP
+    if (c->map)
+        return file_read_mapped(h, buf, size);
+#endif
+#if CONFIG_IO_URING
+    if (c->uring)
+        return file_read_uring(h, buf, size);
+#endif
     return read(c->fd, buf, size);
 }
 
 static int file_write(URLContext *h, const unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
+#if CONFIG_IO_URING
+    if (c->uring) {
+        URLIOVec iov = { buf, size };
+        return file_writev_uring(h, &iov, 1);
+    }
+#endif
     return write(c->fd, buf, size);
 }
 
+#if HAVE_WRITEV
+static int file_writev(URLContext *h, const URLIOVec *iov, int iovcnt)
+{
+    FileContext *c = h->priv_data;
+    struct iovec vec[URL_IOV_MAX];
+    int i, ret;
+
+#if CONFIG_IO_URING
+    /* the data is copied into the blocks written behind anyway */
+    if (c->uring)
+        return file_writev_uring(h, iov, iovcnt);
+#endif
+
+    for (i = 0; i < iovcnt; i++) {
+        vec[i].iov_base = (void *)(uintptr_t)iov[i].data;
+        vec[i].iov_len  = iov[i].size;
+    }
+    ret = writev(c->fd, vec, iovcnt);
+    return ret < 0 ? AVERROR(errno) : ret;
+}
+#endif
+
 static int file_get_handle(URLContext *h)
 {
     FileContext *c = h->priv_data;
@@ -115,6 +800,35 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (fd == -1)
         return AVERROR(errno);
     c->fd = fd;
+
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE)) {
+#if HAVE_MMAP
+        int ret = file_map(h);
+        if (ret < 0 && ret != AVERROR(ENOSYS))
+            av_log(h, AV_LOG_WARNING, "Cannot map the file, reading it.\n");
+#else
+        av_log(h, AV_LOG_WARNING, "Mapping files is not supported.\n");
+#endif
+    }
+
+    if (c->use_io_uring) {
+#if CONFIG_IO_URING
+        int ret = 0;
+#if HAVE_MMAP
+        if (!c->map)
+#endif
+            ret = file_open_uring(h, flags);
+        if (ret < 0) {
+            char errbuf[128];
+            av_strerror(ret, errbuf, sizeof(errbuf));
+            av_log(h, AV_LOG_WARNING, "io_uring is not available (%s), "
+                   "using the synchronous system calls.\n", errbuf);
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "io_uring is not supported.\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -124,6 +838,11 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#if CONFIG_IO_URING
+    if (c->uring)
+        return file_seek_uring(h, pos, whence);
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
 
@@ -131,6 +850,23 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : st.st_size;
     }
 
+#if HAVE_MMAP
+    if (c->map) {
+        if (whence == SEEK_CUR) {
+            pos += c->pos;
+        } else if (whence == SEEK_END) {
+            struct stat st;
+            if (fstat(c->fd, &st) < 0)
+                return AVERROR(errno);
+            pos += st.st_size;
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        file_seek_mapped(h, pos);
+        return pos;
+    }
+#endif
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -139,6 +875,18 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if HAVE_MMAP
+    av_buffer_unref(&c->map);
+#endif
+#if CONFIG_IO_URING
+    if (c->uring) {
+        int ret = file_close_uring(h);
+        if (ret < 0) {
+            close(c->fd);
+            return ret;
+        }
+    }
+#endif
     return close(c->fd);
 }
 
@@ -153,6 +901,12 @@ URLProtocol ff_file_protocol = {
     .url_check           = file_check,
     .priv_data_size      = sizeof(FileContext),
     .priv_data_class     = &file_class,
+#if HAVE_MMAP
+    .url_get_buffer      = file_get_buffer,
+#endif
+#if HAVE_WRITEV
+    .url_writev          = file_writev,
+#endif
 };
 
 #endif /* CONFIG_FILE_PROTOCOL */
@@ -190,6 +944,9 @@ URLProtocol ff_pipe_protocol = {
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
     .priv_data_size      = sizeof(FileContext),
+#if HAVE_WRITEV
+    .url_writev          = file_writev,
+#endif
 };
 
 #endif /* CONFIG_PIPE_PROTOCOL */
@@ -0,0 +1,231 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "url.h"
+
+/* Stand-in for a remote HLS stream: a playlist of segments which are the
+ * consecutive parts of a WAV file, downloaded slowly. The protocol counts
+ * the segments opened and how many of them are downloaded at once. The
+ * stream is read without and with prefetching, then interrupted while
+ * prefetching, which must not call the interrupt callback from the
+ * prefetching threads. */
+
+#define NB_SEGMENTS  10
+#define SEGMENT_SIZE 20000
+#define HEADER_SIZE  44
+#define STREAM_SIZE  (NB_SEGMENTS * SEGMENT_SIZE)
+
+typedef struct RemoteContext {
+    uint8_t *data;
+    int size;
+    int pos;
+    int segment;
+} RemoteContext;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int nb_opened, nb_open, max_open;
+
+static pthread_t main_thread;
+static int interrupt_after, nb_foreign_calls;
+
+static uint8_t byte_at(int pos)
+{
+    return (pos * 7 + (pos >> 8)) & 0xff;
+}
+
+static void write_stream(uint8_t *buf)
+{
+    int i;
+
+    for (i = HEADER_SIZE; i < STREAM_SIZE; i++)
+        buf[i] = byte_at(i);
+    /* mono 16-bit PCM at 8 kHz, with the samples after the header */
+    memcpy(buf,      "RIFF", 4);
+    AV_WL32(buf + 4, STREAM_SIZE - 8);
+    memcpy(buf + 8,  "WAVEfmt ", 8);
+    AV_WL32(buf + 16, 16);
+    AV_WL16(buf + 20, 1);
+    AV_WL16(buf + 22, 1);
+    AV_WL32(buf + 24, 8000);
+    AV_WL32(buf + 28, 16000);
+    AV_WL16(buf + 32, 2);
+    AV_WL16(buf + 34, 16);
+    memcpy(buf + 36, "data", 4);
+    AV_WL32(buf + 40, STREAM_SIZE - HEADER_SIZE);
+}
+
+static int remote_open(URLContext *h, const char *url, int flags)
+{
+    RemoteContext *c = h->priv_data;
+    const char *name = strrchr(url, '/') + 1;
+    char playlist[1024];
+    int i, len;
+
+    if (!strcmp(name, "playlist.m3u8")) {
+        len = snprintf(playlist, sizeof(playlist), "#EXTM3U\n"
+                       "#EXT-X-TARGETDURATION:2\n#EXT-X-MEDIA-SEQUENCE:0\n");
+        for (i = 0; i < NB_SEGMENTS; i++)
+            len += snprintf(playlist + len, sizeof(playlist) - len,
+                            "#EXTINF:1.25,\nsegment%d.wav\n", i);
+        len += snprintf(playlist + len, sizeof(playlist) - len,
+                        "#EXT-X-ENDLIST\n");
+        if (!(c->data = av_malloc(len)))
+            return AVERROR(ENOMEM);
+        memcpy(c->data, playlist, len);
+        c->size    = len;
+        c->segment = -1;
+        return 0;
+    }
+
+    if (sscanf(name, "segment%d.wav", &c->segment) != 1 ||
+        c->segment < 0 || c->segment >= NB_SEGMENTS)
+        return AVERROR(ENOENT);
+    if (!(c->data = av_malloc(STREAM_SIZE)))
+        return AVERROR(ENOMEM);
+    write_stream(c->data);
+    c->pos  = c->segment * SEGMENT_SIZE;
+    c->size = c->pos + SEGMENT_SIZE;
+
+    pthread_mutex_lock(&lock);
+    nb_opened++;
+    nb_open++;
+    max_open = FFMAX(max_open, nb_open);
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+static int remote_read(URLContext *h, unsigned char *buf, int size)
+{
+    RemoteContext *c = h->priv_data;
+
+    size = FFMIN(size, 4096);
+    size = FFMIN(size, c->size - c->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    /* the latency of each network read */
+    if (c->segment >= 0)
+        av_usleep(2000);
+    memcpy(buf, c->data + c->pos, size);
+    c->pos += size;
+    return size;
+}
+
+static int remote_close(URLContext *h)
+{
+    RemoteContext *c = h->priv_data;
+
+    if (c->segment >= 0) {
+        pthread_mutex_lock(&lock);
+        nb_open--;
+        pthread_mutex_unlock(&lock);
+    }
+    av_freep(&c->data);
+    return 0;
+}
+
+static URLProtocol remote_protocol = {
+    .name           = "remote",
+    .url_open       = remote_open,
+    .url_read       = remote_read,
+    .url_close      = remote_close,
+    .priv_data_size = sizeof(RemoteContext),
+};
+
+static int interrupt_cb(void *opaque)
+{
+    int *nb_packets = opaque;
+
+    if (!pthread_equal(pthread_self(), main_thread)) {
+        pthread_mutex_lock(&lock);
+        nb_foreign_calls++;
+        pthread_mutex_unlock(&lock);
+    }
+    return interrupt_after && *nb_packets >= interrupt_after;
+}
+
+static int read_stream(int prefetch_segments, int interrupt)
+{
+    AVFormatContext *s = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket pkt;
+    uint32_t crc = 0;
+    int nb_packets = 0, size = 0, ret;
+    char value[16];
+
+    nb_opened = max_open = 0;
+    interrupt_after    = interrupt;
+    nb_foreign_calls   = 0;
+
+    if (!(s = avformat_alloc_context()))
+        return 1;
+    s->interrupt_callback.callback = interrupt_cb;
+    s->interrupt_callback.opaque   = &nb_packets;
+    snprintf(value, sizeof(value), "%d", prefetch_segments);
+    av_dict_set(&opts, "prefetch_segments", value, 0);
+    ret = avformat_open_input(&s, "remote://server/playlist.m3u8", NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        printf("cannot open the playlist\n");
+        return 1;
+    }
+
+    while ((ret = av_read_frame(s, &pkt)) >= 0) {
+        crc   = av_adler32_update(crc, pkt.data, pkt.size);
+        size += pkt.size;
+        nb_packets++;
+        av_free_packet(&pkt);
+    }
+    avformat_close_input(&s);
+
+    /* the demuxer ends the stream when interrupted, the number of segments
+     * opened until then depends on the timing */
+    if (interrupt)
+        printf("prefetch %d: %s after %d packets, %d still open, "
+               "%d interrupt checks from other threads\n", prefetch_segments,
+               size < STREAM_SIZE - HEADER_SIZE ? "stopped" : "not stopped",
+               interrupt_after, nb_open, nb_foreign_calls);
+    else
+        printf("prefetch %d: %d bytes, checksum 0x%08x, %d segments opened, "
+               "at most %d at once, %d interrupt checks from other threads\n",
+               prefetch_segments, size, crc, nb_opened, max_open,
+               nb_foreign_calls);
+    return ret != AVERROR_EOF;
+}
+
+int main(void)
+{
+    av_log_set_level(AV_LOG_ERROR);
+    av_register_all();
+    ffurl_register_protocol(&remote_protocol);
+    main_thread = pthread_self();
+
+    if (read_stream(0, 0) || read_stream(3, 0) || read_stream(3, 20))
+        return 1;
+    return 0;
+}
@@ -25,7 +25,14 @@
  * http://tools.ietf.org/html/draft-pantos-http-live-streaming
  */
 
+#include "config.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "libavutil/avstring.h"
+#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
@@ -38,6 +45,9 @@
 
 #define INITIAL_BUFFER_SIZE 32768
 
+/* size of the reads done by the prefetching threads */
+#define PREFETCH_CHUNK_SIZE 32768
+
 /*
  * An apple http stream consists of a playlist with media segment files,
  * played sequentially. There may be several playlists with the same
@@ -63,6 +73,24 @@ struct segment {
     uint8_t iv[16];
 };
 
+/*
+ * A segment downloaded ahead by a thread of its own. The segment is copied,
+ * so that it stays valid when the playlist is reloaded.
+ */
+struct prefetch {
+    struct variant *var;
+    int seq_no;                 ///< sequence number of the segment, -1 if unused
+    struct segment seg;
+    AVFifoBuffer *fifo;         ///< data downloaded, not yet read
+    int eof;
+    int error;
+    int abort;
+#if HAVE_PTHREADS
+    pthread_t thread;
+#endif
+    int thread_started;
+};
+
 /*
  * Each variant has its own demuxer. If it currently is active,
  * it has an open AVIOContext too, and potentially an AVPacket
@@ -91,9 +119,24 @@ struct variant {
 
     char key_url[MAX_URL_SIZE];
     uint8_t key[16];
+
+    struct prefetch *prefetch;          ///< prefetch_segments slots
+    struct prefetch *cur_prefetch;      ///< slot of the segment being read
+    /**
+     * Set when the interrupt callback fired while waiting for a prefetched
+     * segment, until the reading resumes. It interrupts the transfers of the
+     * prefetching threads, which never call the callback of the caller
+     * since it may not be thread-safe.
+     */
+    int interrupted;
+#if HAVE_PTHREADS
+    pthread_mutex_t mutex;  ///< protects the slots, the key cache and interrupted
+    pthread_cond_t cond;    ///< signaled when the state of a slot changes
+#endif
 };
 
 typedef struct HLSContext {
+    const AVClass *class;
     int n_variants;
     struct variant **variants;
     int cur_seq_no;
@@ -103,6 +146,11 @@ typedef struct HLSContext {
     int64_t seek_timestamp;
     int seek_flags;
     AVIOInterruptCB *interrupt_callback;
+
+    int prefetch_segments;
+    int prefetch_buffer_size;
+    int nb_segments;            ///< segments opened through the prefetching
+    int nb_segments_ready;      ///< segments with data already downloaded
 } HLSContext;
 
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
@@ -122,26 +170,6 @@ static void free_segment_list(struct variant *var)
     var->n_segments = 0;
 }
 
-static void free_variant_list(HLSContext *c)
-{
-    int i;
-    for (i = 0; i < c->n_variants; i++) {
-        struct variant *var = c->variants[i];
-        free_segment_list(var);
-        av_free_packet(&var->pkt);
-        av_free(var->pb.buffer);
-        if (var->input)
-            ffurl_close(var->input);
-        if (var->ctx) {
-            var->ctx->pb = NULL;
-            avformat_close_input(&var->ctx);
-        }
-        av_free(var);
-    }
-    av_freep(&c->variants);
-    c->n_variants = 0;
-}
-
 /*
  * Used to reset a statically allocated AVPacket to a clean slate,
  * containing no data.
@@ -329,46 +357,82 @@ fail:
     return ret;
 }
 
-static int open_input(struct variant *var)
+static void lock_variant(struct variant *var)
+{
+#if HAVE_PTHREADS
+    if (var->prefetch)
+        pthread_mutex_lock(&var->mutex);
+#endif
+}
+
+static void unlock_variant(struct variant *var)
+{
+#if HAVE_PTHREADS
+    if (var->prefetch)
+        pthread_mutex_unlock(&var->mutex);
+#endif
+}
+
+/*
+ * Get the key of a segment, from the key of the last segment if it is the
+ * same. The key is only cached when read successfully, so that a canceled
+ * prefetching does not leave a wrong key behind.
+ */
+static void get_key(struct variant *var, const struct segment *seg,
+                    uint8_t *key, const AVIOInterruptCB *int_cb)
+{
+    URLContext *uc;
+    int cached;
+
+    lock_variant(var);
+    cached = !strcmp(seg->key, var->key_url);
+    memcpy(key, var->key, sizeof(var->key));
+    unlock_variant(var);
+    if (cached)
+        return;
+
+    if (ffurl_open(&uc, seg->key, AVIO_FLAG_READ, int_cb, NULL) == 0) {
+        if (ffurl_read_complete(uc, key, sizeof(var->key))
+            != sizeof(var->key)) {
+            av_log(NULL, AV_LOG_ERROR, "Unable to read key file %s\n",
+                   seg->key);
+        } else {
+            lock_variant(var);
+            memcpy(var->key, key, sizeof(var->key));
+            av_strlcpy(var->key_url, seg->key, sizeof(var->key_url));
+            unlock_variant(var);
+        }
+        ffurl_close(uc);
+    } else {
+        av_log(NULL, AV_LOG_ERROR, "Unable to open key file %s\n",
+               seg->key);
+    }
+}
+
+static int open_segment(struct variant *var, const struct segment *seg,
+                        URLContext **in, const AVIOInterruptCB *int_cb)
 {
-    struct segment *seg = var->segments[var->cur_seq_no - var->start_seq_no];
     if (seg->key_type == KEY_NONE) {
-        return ffurl_open(&var->input, seg->url, AVIO_FLAG_READ,
-                          &var->parent->interrupt_callback, NULL);
+        return ffurl_open(in, seg->url, AVIO_FLAG_READ, int_cb, NULL);
     } else if (seg->key_type == KEY_AES_128) {
         char iv[33], key[33], url[MAX_URL_SIZE];
+        uint8_t key_data[16];
         int ret;
-        if (strcmp(seg->key, var->key_url)) {
-            URLContext *uc;
-            if (ffurl_open(&uc, seg->key, AVIO_FLAG_READ,
-                           &var->parent->interrupt_callback, NULL) == 0) {
-                if (ffurl_read_complete(uc, var->key, sizeof(var->key))
-                    != sizeof(var->key)) {
-                    av_log(NULL, AV_LOG_ERROR, "Unable to read key file %s\n",
-                           seg->key);
-                }
-                ffurl_close(uc);
-            } else {
-                av_log(NULL, AV_LOG_ERROR, "Unable to open key file %s\n",
-                       seg->key);
-            }
-            av_strlcpy(var->key_url, seg->key, sizeof(var->key_url));
-        }
+        get_key(var, seg, key_data, int_cb);
         ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
-        ff_data_to_hex(key, var->key, sizeof(var->key), 0);
+        ff_data_to_hex(key, key_data, sizeof(key_data), 0);
         iv[32] = key[32] = '\0';
         if (strstr(seg->url, "://"))
             snprintf(url, sizeof(url), "crypto+%s", seg->url);
         else
             snprintf(url, sizeof(url), "crypto:%s", seg->url);
-        if ((ret = ffurl_alloc(&var->input, url, AVIO_FLAG_READ,
-                               &var->parent->interrupt_callback)) < 0)
+        if ((ret = ffurl_alloc(in, url, AVIO_FLAG_READ, int_cb)) < 0)
             return ret;
-        av_opt_set(var->input->priv_data, "key", key, 0);
-        av_opt_set(var->input->priv_data, "iv", iv, 0);
-        if ((ret = ffurl_connect(var->input, NULL)) < 0) {
-            ffurl_close(var->input);
-            var->input = NULL;
+        av_opt_set((*in)->priv_data, "key", key, 0);
+        av_opt_set((*in)->priv_data, "iv", iv, 0);
+        if ((ret = ffurl_connect(*in, NULL)) < 0) {
+            ffurl_close(*in);
+            *in = NULL;
             return ret;
         }
         return 0;
@@ -376,6 +440,307 @@ static int open_input(struct variant *var)
     return AVERROR(ENOSYS);
 }
 
+static int open_input(struct variant *var)
+{
+    struct segment *seg = var->segments[var->cur_seq_no - var->start_seq_no];
+    return open_segment(var, seg, &var->input,
+                        &var->parent->interrupt_callback);
+}
+
+#if HAVE_PTHREADS
+/* only called by the prefetching threads, without the mutex locked */
+static int prefetch_check_interrupt(void *arg)
+{
+    struct prefetch *p = arg;
+    int ret;
+
+    pthread_mutex_lock(&p->var->mutex);
+    ret = p->abort || p->var->interrupted;
+    pthread_mutex_unlock(&p->var->mutex);
+    return ret;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    struct prefetch *p  = arg;
+    struct variant *var = p->var;
+    HLSContext *c       = var->parent->priv_data;
+    const AVIOInterruptCB int_cb = { prefetch_check_interrupt, p };
+    uint8_t buf[PREFETCH_CHUNK_SIZE];
+    URLContext *in = NULL;
+    int ret = 0, len;
+
+    pthread_mutex_lock(&var->mutex);
+    while (!p->abort) {
+        int size  = av_fifo_size(p->fifo);
+        int space = av_fifo_space(p->fifo);
+
+        /* the transfers interrupted are resumed along with the reading */
+        if (var->interrupted) {
+            pthread_cond_wait(&var->cond, &var->mutex);
+            continue;
+        }
+        if (!in) {
+            pthread_mutex_unlock(&var->mutex);
+            ret = open_segment(var, &p->seg, &in, &int_cb);
+            pthread_mutex_lock(&var->mutex);
+            if (ret < 0 && ret != AVERROR_EXIT)
+                break;
+            continue;
+        }
+        /* grow the buffer up to prefetch_buffer_size, then wait for the
+         * reader to make room */
+        if (space < PREFETCH_CHUNK_SIZE &&
+            size + space < c->prefetch_buffer_size) {
+            int new_size = FFMAX(2 * (size + space), size + PREFETCH_CHUNK_SIZE);
+            new_size = FFMIN(new_size, c->prefetch_buffer_size);
+            if ((ret = av_fifo_realloc2(p->fifo, new_size)) < 0)
+                break;
+            continue;
+        }
+        if (!space) {
+            pthread_cond_wait(&var->cond, &var->mutex);
+            continue;
+        }
+        len = FFMIN(space, PREFETCH_CHUNK_SIZE);
+        pthread_mutex_unlock(&var->mutex);
+
+        ret = ffurl_read(in, buf, len);
+
+        pthread_mutex_lock(&var->mutex);
+        if (ret > 0) {
+            av_fifo_generic_write(p->fifo, buf, ret, NULL);
+            pthread_cond_broadcast(&var->cond);
+        } else if (!ret) {
+            ret = AVERROR_EOF;
+            break;
+        } else if (ret != AVERROR_EXIT) {
+            break;
+        }
+    }
+    if (ret == AVERROR_EOF)
+        p->eof = 1;
+    else if (!p->abort)
+        p->error = ret;
+    pthread_cond_broadcast(&var->cond);
+    pthread_mutex_unlock(&var->mutex);
+
+    if (in)
+        ffurl_close(in);
+    return NULL;
+}
+
+static void prefetch_release(struct variant *var, struct prefetch *p)
+{
+    if (p->thread_started) {
+        pthread_mutex_lock(&var->mutex);
+        p->abort = 1;
+        pthread_cond_broadcast(&var->cond);
+        pthread_mutex_unlock(&var->mutex);
+        pthread_join(p->thread, NULL);
+        p->thread_started = 0;
+    }
+    av_fifo_free(p->fifo);
+    p->fifo   = NULL;
+    p->seq_no = -1;
+    if (var->cur_prefetch == p)
+        var->cur_prefetch = NULL;
+}
+
+static void prefetch_release_all(struct variant *var)
+{
+    HLSContext *c = var->parent->priv_data;
+    int i;
+
+    if (!var->prefetch)
+        return;
+    for (i = 0; i < c->prefetch_segments; i++)
+        prefetch_release(var, &var->prefetch[i]);
+}
+
+static void prefetch_uninit(struct variant *var)
+{
+    if (!var->prefetch)
+        return;
+    prefetch_release_all(var);
+    pthread_mutex_destroy(&var->mutex);
+    pthread_cond_destroy(&var->cond);
+    av_freep(&var->prefetch);
+}
+
+static int prefetch_start(struct variant *var, struct prefetch *p, int seq_no)
+{
+    int ret;
+
+    p->fifo = av_fifo_alloc(PREFETCH_CHUNK_SIZE);
+    if (!p->fifo)
+        return AVERROR(ENOMEM);
+    p->seq_no = seq_no;
+    p->seg    = *var->segments[seq_no - var->start_seq_no];
+    p->eof    = p->error = p->abort = 0;
+
+    ret = pthread_create(&p->thread, NULL, prefetch_thread, p);
+    if (ret) {
+        prefetch_release(var, p);
+        return AVERROR(ret);
+    }
+    p->thread_started = 1;
+    return 0;
+}
+
+/*
+ * Make sure that the current segment and the ones following it, up to
+ * the prefetching depth, are being downloaded, and select the slot of the
+ * current segment for reading.
+ */
+static int prefetch_open(struct variant *var)
+{
+    HLSContext *c = var->parent->priv_data;
+    int i, seq_no, ret;
+    int end = FFMIN(var->cur_seq_no + c->prefetch_segments,
+                    var->start_seq_no + var->n_segments);
+
+    if (!var->prefetch) {
+        var->prefetch = av_mallocz(c->prefetch_segments *
+                                   sizeof(*var->prefetch));
+        if (!var->prefetch)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < c->prefetch_segments; i++) {
+            var->prefetch[i].var    = var;
+            var->prefetch[i].seq_no = -1;
+        }
+        pthread_mutex_init(&var->mutex, NULL);
+        pthread_cond_init(&var->cond, NULL);
+    }
+
+    /* Drop the segments already read or out of the window, and the ones
+     * which changed in a playlist reload. */
+    for (i = 0; i < c->prefetch_segments; i++) {
+        struct prefetch *p = &var->prefetch[i];
+        int idx = p->seq_no - var->start_seq_no;
+
+        if (p->seq_no < 0)
+            continue;
+        if (p->seq_no < var->cur_seq_no || p->seq_no >= end ||
+            strcmp(p->seg.url, var->segments[idx]->url))
+            prefetch_release(var, p);
+    }
+
+    for (seq_no = var->cur_seq_no; seq_no < end; seq_no++) {
+        struct prefetch *p = NULL;
+        for (i = 0; i < c->prefetch_segments; i++) {
+            if (var->prefetch[i].seq_no == seq_no) {
+                p = &var->prefetch[i];
+                break;
+            }
+            if (var->prefetch[i].seq_no < 0 && !p)
+                p = &var->prefetch[i];
+        }
+        if (p->seq_no < 0 && (ret = prefetch_start(var, p, seq_no)) < 0)
+            return ret;
+        if (seq_no == var->cur_seq_no)
+            var->cur_prefetch = p;
+    }
+
+    pthread_mutex_lock(&var->mutex);
+    c->nb_segments++;
+    if (av_fifo_size(var->cur_prefetch->fifo) || var->cur_prefetch->eof)
+        c->nb_segments_ready++;
+    pthread_mutex_unlock(&var->mutex);
+
+    return 0;
+}
+
+static int prefetch_read(struct variant *var, uint8_t *buf, int buf_size)
+{
+    struct prefetch *p = var->cur_prefetch;
+    int ret = 0;
+
+    pthread_mutex_lock(&var->mutex);
+    if (var->interrupted) {
+        var->interrupted = 0;
+        pthread_cond_broadcast(&var->cond);
+    }
+    while (!av_fifo_size(p->fifo) && !p->eof && !p->error) {
+        /* wake up regularly to check the interrupt callback */
+        int64_t t = av_gettime() + 100000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        pthread_cond_timedwait(&var->cond, &var->mutex, &tv);
+        if (ff_check_interrupt(&var->parent->interrupt_callback)) {
+            var->interrupted = 1;
+            pthread_cond_broadcast(&var->cond);
+            ret = AVERROR_EXIT;
+            break;
+        }
+    }
+    if (!ret) {
+        if (av_fifo_size(p->fifo)) {
+            ret = FFMIN(buf_size, av_fifo_size(p->fifo));
+            av_fifo_generic_read(p->fifo, buf, ret, NULL);
+            pthread_cond_broadcast(&var->cond);
+        } else {
+            ret = p->eof ? AVERROR_EOF : p->error;
+        }
+    }
+    pthread_mutex_unlock(&var->mutex);
+
+    return ret;
+}
+#else
+static void prefetch_release(struct variant *var, struct prefetch *p)
+{
+}
+
+static void prefetch_release_all(struct variant *var)
+{
+}
+
+static void prefetch_uninit(struct variant *var)
+{
+}
+
+static int prefetch_open(struct variant *var)
+{
+    return AVERROR(ENOSYS);
+}
+
+static int prefetch_read(struct variant *var, uint8_t *buf, int buf_size)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+
+static void close_input(struct variant *var)
+{
+    if (var->cur_prefetch)
+        prefetch_release(var, var->cur_prefetch);
+    if (var->input)
+        ffurl_close(var->input);
+    var->input = NULL;
+}
+
+static void free_variant_list(HLSContext *c)
+{
+    int i;
+    for (i = 0; i < c->n_variants; i++) {
+        struct variant *var = c->variants[i];
+        free_segment_list(var);
+        av_free_packet(&var->pkt);
+        av_free(var->pb.buffer);
+        close_input(var);
+        prefetch_uninit(var);
+        if (var->ctx) {
+            var->ctx->pb = NULL;
+            avformat_close_input(&var->ctx);
+        }
+        av_free(var);
+    }
+    av_freep(&c->variants);
+    c->n_variants = 0;
+}
+
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct variant *v = opaque;
@@ -383,7 +748,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     int ret, i;
 
 restart:
-    if (!v->input) {
+    if (!v->input && !v->cur_prefetch) {
         /* If this is a live stream and the reload interval has elapsed since
          * the last playlist reload, reload the variant playlists now. */
         int64_t reload_interval = v->n_segments > 0 ?
@@ -418,15 +783,23 @@ reload:
             goto reload;
         }
 
-        ret = open_input(v);
+        if (c->prefetch_segments)
+            ret = prefetch_open(v);
+        else
+            ret = open_input(v);
         if (ret < 0)
             return ret;
     }
-    ret = ffurl_read(v->input, buf, buf_size);
+    if (v->cur_prefetch)
+        ret = prefetch_read(v, buf, buf_size);
+    else
+        ret = ffurl_read(v->input, buf, buf_size);
     if (ret > 0)
         return ret;
-    ffurl_close(v->input);
-    v->input = NULL;
+    /* the segment is read further once the caller resumes */
+    if (ret == AVERROR_EXIT)
+        return ret;
+    close_input(v);
     v->cur_seq_no++;
 
     c->end_of_segment = 1;
@@ -442,6 +815,7 @@ reload:
         }
     }
     if (!v->needed) {
+        prefetch_release_all(v);
         av_log(v->parent, AV_LOG_INFO, "No longer receiving variant %d\n",
                v->index);
         return AVERROR_EOF;
@@ -456,6 +830,14 @@ static int hls_read_header(AVFormatContext *s)
 
     c->interrupt_callback = &s->interrupt_callback;
 
+#if !HAVE_PTHREADS
+    if (c->prefetch_segments) {
+        av_log(s, AV_LOG_WARNING,
+               "Segment prefetching is not supported without threads.\n");
+        c->prefetch_segments = 0;
+    }
+#endif
+
     if ((ret = parse_playlist(c, s->filename, NULL, s->pb)) < 0)
         goto fail;
 
@@ -599,9 +981,8 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             v->pb.eof_reached = 0;
             av_log(s, AV_LOG_INFO, "Now receiving variant %d\n", i);
         } else if (first && !v->cur_needed && v->needed) {
-            if (v->input)
-                ffurl_close(v->input);
-            v->input = NULL;
+            close_input(v);
+            prefetch_release_all(v);
             v->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving variant %d\n", i);
@@ -711,6 +1092,11 @@ static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
+    if (c->prefetch_segments)
+        av_log(s, AV_LOG_VERBOSE,
+               "%d of %d segments were prefetched when needed.\n",
+               c->nb_segments_ready, c->nb_segments);
+
     free_variant_list(c);
     return 0;
 }
@@ -745,10 +1131,8 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         struct variant *var = c->variants[i];
         int64_t pos = c->first_timestamp == AV_NOPTS_VALUE ?
                       0 : c->first_timestamp;
-        if (var->input) {
-            ffurl_close(var->input);
-            var->input = NULL;
-        }
+        close_input(var);
+        prefetch_release_all(var);
         av_free_packet(&var->pkt);
         reset_packet(&var->pkt);
         var->pb.eof_reached = 0;
@@ -786,6 +1170,21 @@ static int hls_probe(AVProbeData *p)
     return 0;
 }
 
+#define OFFSET(x) offsetof(HLSContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+static const AVOption hls_options[] = {
+    { "prefetch_segments", "Number of segments downloaded in parallel, ahead of the reading", OFFSET(prefetch_segments), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, D },
+    { "prefetch_buffer_size", "Size of the data buffered for each prefetched segment", OFFSET(prefetch_buffer_size), AV_OPT_TYPE_INT, { .i64 = 4 << 20 }, PREFETCH_CHUNK_SIZE, INT_MAX, D },
+    { NULL }
+};
+
+static const AVClass hls_class = {
+    .class_name = "hls demuxer",
+    .item_name  = av_default_item_name,
+    .option     = hls_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 AVInputFormat ff_hls_demuxer = {
     .name           = "hls,applehttp",
     .long_name      = NULL_IF_CONFIG_SMALL("Apple HTTP Live Streaming"),
@@ -795,4 +1194,5 @@ AVInputFormat ff_hls_demuxer = {
     .read_packet    = hls_read_packet,
     .read_close     = hls_close,
     .read_seek      = hls_read_seek,
+    .priv_class     = &hls_class,
 };
@@ -0,0 +1,259 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "network.h"
+#include "os_support.h"
+#include "url.h"
+
+/* A HTTP/1.1 server on the loopback, run by a thread, answering each
+ * request with a body of the size given in the path. The requests read
+ * one after the other must reuse the idle connection when allowed to, but
+ * not once the server closed it, and the connections left idle have to be
+ * closed by avformat_network_deinit(). */
+
+#define MAX_CONNECTIONS 8
+
+typedef struct Connection {
+    int fd;
+    char request[1024];
+    int len;
+} Connection;
+
+static Connection connections[MAX_CONNECTIONS];
+static int listen_fd, nb_connections;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int nb_accepted, nb_open, nb_dropped, stop;
+
+static uint8_t byte_at(int pos)
+{
+    return (pos * 7 + (pos >> 8)) & 0xff;
+}
+
+static void close_connection(int i)
+{
+    closesocket(connections[i].fd);
+    connections[i] = connections[--nb_connections];
+    pthread_mutex_lock(&lock);
+    nb_open--;
+    pthread_mutex_unlock(&lock);
+}
+
+/* Answer the request of the connection i, return 1 if the connection was
+ * closed. The path is the size of the body, followed by -close to close the
+ * connection as announced in the reply, or -drop to close it silently. */
+static int answer(int i)
+{
+    static uint8_t body[65536];
+    char header[256], path[256] = "";
+    int size, j, header_len, close_mode = 0;
+
+    sscanf(connections[i].request, "GET /%255s", path);
+    size = FFMIN(atoi(path), sizeof(body));
+    if (strstr(path, "-close"))
+        close_mode = 1;
+    else if (strstr(path, "-drop"))
+        close_mode = 2;
+
+    for (j = 0; j < size; j++)
+        body[j] = byte_at(j);
+    header_len = snprintf(header, sizeof(header),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Type: application/octet-stream\r\n"
+                          "Content-Length: %d\r\n%s\r\n", size,
+                          close_mode == 1 ? "Connection: close\r\n" : "");
+    if (send(connections[i].fd, header, header_len, 0) != header_len ||
+        send(connections[i].fd, body, size, 0) != size || close_mode) {
+        close_connection(i);
+        if (close_mode == 2) {
+            pthread_mutex_lock(&lock);
+            nb_dropped++;
+            pthread_mutex_unlock(&lock);
+        }
+        return 1;
+    }
+    connections[i].len = 0;
+    return 0;
+}
+
+static void *server(void *arg)
+{
+    struct pollfd p[MAX_CONNECTIONS + 1];
+    int i, ret;
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        ret = stop;
+        pthread_mutex_unlock(&lock);
+        if (ret)
+            break;
+
+        p[0].fd     = listen_fd;
+        p[0].events = nb_connections < MAX_CONNECTIONS ? POLLIN : 0;
+        for (i = 0; i < nb_connections; i++) {
+            p[i + 1].fd     = connections[i].fd;
+            p[i + 1].events = POLLIN;
+        }
+        if (poll(p, nb_connections + 1, 10) <= 0)
+            continue;
+
+        /* look at the existing connections first, p is out of date once
+         * one of them is closed */
+        for (i = 0; i < nb_connections; i++) {
+            Connection *c = &connections[i];
+            if (!p[i + 1].revents)
+                continue;
+            ret = recv(c->fd, c->request + c->len,
+                       sizeof(c->request) - 1 - c->len, 0);
+            if (ret <= 0) {
+                close_connection(i);
+                break;
+            }
+            c->len += ret;
+            c->request[c->len] = '\0';
+            if (strstr(c->request, "\r\n\r\n") && answer(i))
+                break;
+        }
+        if (i == nb_connections && p[0].revents) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd < 0)
+                continue;
+            connections[nb_connections].fd  = fd;
+            connections[nb_connections].len = 0;
+            nb_connections++;
+            pthread_mutex_lock(&lock);
+            nb_accepted++;
+            nb_open++;
+            pthread_mutex_unlock(&lock);
+        }
+    }
+
+    while (nb_connections)
+        close_connection(0);
+    return NULL;
+}
+
+static int get(const char *url_base, const char *path, int reuse)
+{
+    static uint8_t buf[65536];
+    AVDictionary *opts = NULL;
+    URLContext *h;
+    char url[256];
+    int64_t nb_new = -1, nb_reused = -1;
+    int i, ret, size = 0;
+
+    snprintf(url, sizeof(url), "%s/%s", url_base, path);
+    av_dict_set(&opts, "reuse_connections", reuse ? "1" : "0", 0);
+    ret = ffurl_open(&h, url, AVIO_FLAG_READ, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+    while ((ret = ffurl_read(h, buf + size, sizeof(buf) - size)) > 0)
+        size += ret;
+    for (i = 0; i < size; i++) {
+        if (buf[i] != byte_at(i)) {
+            printf("wrong data at %d\n", i);
+            return 1;
+        }
+    }
+    av_opt_get_int(h->priv_data, "new_connections", 0, &nb_new);
+    av_opt_get_int(h->priv_data, "reused_connections", 0, &nb_reused);
+    ffurl_close(h);
+
+    pthread_mutex_lock(&lock);
+    printf("%-11s reuse %d: %5d bytes, %"PRId64" new, %"PRId64" reused, "
+           "%d connections accepted\n", path, reuse, size, nb_new, nb_reused,
+           nb_accepted);
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+/* Wait for the server to see the connections closed or dropped. */
+static int wait_server(int open, int dropped)
+{
+    int i, done = 0;
+
+    for (i = 0; i < 5000 && !done; i++) {
+        pthread_mutex_lock(&lock);
+        done = nb_open == open && nb_dropped == dropped;
+        pthread_mutex_unlock(&lock);
+        if (!done)
+            av_usleep(1000);
+    }
+    return !done;
+}
+
+int main(void)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addr_len = sizeof(addr);
+    pthread_t thread;
+    char url[100];
+    int ret;
+
+    av_register_all();
+    avformat_network_init();
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listen_fd < 0 ||
+        bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(listen_fd, MAX_CONNECTIONS) ||
+        getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len)) {
+        printf("cannot listen on the loopback\n");
+        return 1;
+    }
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d", ntohs(addr.sin_port));
+    if (pthread_create(&thread, NULL, server, NULL)) {
+        printf("cannot create the server thread\n");
+        return 1;
+    }
+
+    ret = get(url, "1000", 1) ||
+          get(url, "20000", 1) ||
+          /* the idle connection is left to the next requests */
+          get(url, "3000", 0) ||
+          get(url, "4000-close", 1) || wait_server(0, 0) ||
+          get(url, "5000", 1) ||
+          get(url, "6000-drop", 1) || wait_server(0, 1) ||
+          get(url, "7000", 1);
+    if (!ret) {
+        avformat_network_deinit();
+        ret = wait_server(0, 1);
+        printf("idle connections closed on deinit: %s\n", ret ? "no" : "yes");
+    }
+
+    pthread_mutex_lock(&lock);
+    stop = 1;
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    closesocket(listen_fd);
+    return ret;
+}
@@ -20,6 +20,7 @@
  */
 
 #include "libavutil/avstring.h"
+#include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
 #include "network.h"
@@ -32,6 +33,9 @@
 #if CONFIG_ZLIB
 #include <zlib.h>
 #endif
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 /* XXX: POST protocol is not completely implemented because avconv uses
    only a subset of it. */
@@ -43,6 +47,9 @@
 #define BUFFER_SIZE MAX_URL_SIZE
 #define MAX_REDIRECTS 8
 
+/* maximum number of idle connections kept open */
+#define POOL_SIZE 16
+
 typedef struct {
     const AVClass *class;
     URLContext *hd;
@@ -52,6 +59,9 @@ typedef struct {
     /* Used if "Transfer-Encoding: chunked" otherwise -1. */
     int64_t chunksize;
     int64_t off, end_off, filesize;
+    /* Offset following the body of the response, -1 if unknown. */
+    int64_t body_end;
+    int64_t content_length;
     char *location;
     HTTPAuthState auth_state;
     HTTPAuthState proxy_auth_state;
@@ -85,8 +95,37 @@ typedef struct {
 #endif
     AVDictionary *chained_options;
     int send_expect_100;
+    /* Url and tls options of the connection, used to find it again once
+     * idle. Empty if the connection cannot be reused. */
+    char connection_url[MAX_URL_SIZE];
+    int reuse_connections;
+    int idle_timeout;
+    int nb_new_connections;
+    int nb_reused_connections;
 } HTTPContext;
 
+typedef struct HTTPIdleConnection {
+    char url[MAX_URL_SIZE];
+    URLContext *hd;
+    int64_t expiry;
+} HTTPIdleConnection;
+
+/* Connections kept open once their response has been read, shared by all
+ * the contexts, including the prefetching threads of hls. */
+static HTTPIdleConnection idle_connections[POOL_SIZE];
+static int nb_idle_connections;
+static int total_new_connections, total_reused_connections;
+
+#if HAVE_PTHREADS
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define POOL_LOCK()   pthread_mutex_lock(&pool_mutex)
+#define POOL_UNLOCK() pthread_mutex_unlock(&pool_mutex)
+#else
+/* the connections are not kept without a mutex to protect the pool */
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
 #define OFFSET(x) offsetof(HTTPContext, x)
 #define D AV_OPT_FLAG_DECODING_PARAM
 #define E AV_OPT_FLAG_ENCODING_PARAM
@@ -110,6 +149,10 @@ static const AVOption options[] = {
 {"location", "The actual location of the data received", OFFSET(location), AV_OPT_TYPE_STRING, { 0 }, 0, 0, D|E },
 {"offset", "initial byte offset", OFFSET(off), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, D },
 {"end_offset", "try to limit the request to bytes preceding this offset", OFFSET(end_off), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, D },
+{"reuse_connections", "keep the connections open once idle, for the next requests to the same server", OFFSET(reuse_connections), AV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, D },
+{"idle_timeout", "time in seconds an idle connection is kept open", OFFSET(idle_timeout), AV_OPT_TYPE_INT, {.i64 = 5}, 0, INT_MAX, D },
+{"new_connections", "number of connections opened", OFFSET(nb_new_connections), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+{"reused_connections", "number of idle connections reused", OFFSET(nb_reused_connections), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
 {NULL}
 };
 #define HTTP_CLASS(flavor)\
@@ -136,6 +179,144 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+static int can_reuse_connection(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    return HAVE_PTHREADS && s->reuse_connections &&
+           !(h->flags & AVIO_FLAG_WRITE) && !s->post_data;
+}
+
+/* Build the key identifying a connection in the pool: the URL of the lower
+ * protocol, and for tls the options setting the certificates checked and
+ * presented. Return 0 if the key does not fit, the connection is then not
+ * reused. */
+static int connection_key(char *key, int size, const char *url,
+                          const char *lower_proto, AVDictionary *options)
+{
+    static const char *const tls_options[] = {
+        "ca_file", "tls_verify", "cert_file", "key_file", NULL
+    };
+    int i;
+
+    if (av_strlcpy(key, url, size) >= size)
+        return 0;
+    if (strcmp(lower_proto, "tls"))
+        return 1;
+    for (i = 0; tls_options[i]; i++) {
+        AVDictionaryEntry *e = av_dict_get(options, tls_options[i], NULL, 0);
+        if (av_strlcatf(key, size, " %s=%s", tls_options[i],
+                        e ? e->value : "") >= size)
+            return 0;
+    }
+    return 1;
+}
+
+/* Close the idle connections which expired, or the oldest if the pool is
+ * full and room is needed. The pool lock must be held, and the
+ * connections are returned to be closed after releasing it. */
+static int expire_idle_connections(URLContext **expired, int make_room)
+{
+    int64_t now = av_gettime();
+    int i, nb_expired = 0;
+
+    for (i = 0; i < nb_idle_connections; i++) {
+        if (idle_connections[i].expiry > now &&
+            !(make_room && nb_idle_connections == POOL_SIZE && !i))
+            continue;
+        expired[nb_expired++] = idle_connections[i].hd;
+        memmove(&idle_connections[i], &idle_connections[i + 1],
+                (--nb_idle_connections - i) * sizeof(*idle_connections));
+        i--;
+    }
+    return nb_expired;
+}
+
+static URLContext *get_idle_connection(URLContext *h, const char *url)
+{
+    URLContext *expired[POOL_SIZE], *hd = NULL;
+    int i, nb_expired;
+
+    POOL_LOCK();
+    nb_expired = expire_idle_connections(expired, 0);
+    for (i = nb_idle_connections - 1; i >= 0; i--) {
+        if (!strcmp(idle_connections[i].url, url)) {
+            hd = idle_connections[i].hd;
+            memmove(&idle_connections[i], &idle_connections[i + 1],
+                    (--nb_idle_connections - i) * sizeof(*idle_connections));
+            break;
+        }
+    }
+    POOL_UNLOCK();
+
+    for (i = 0; i < nb_expired; i++)
+        ffurl_close(expired[i]);
+
+    if (hd) {
+        /* The server may have closed the connection, or sent something
+         * unexpected, while it was idle. */
+        struct pollfd p = { ffurl_get_file_handle(hd), POLLIN, 0 };
+        if (p.fd < 0 || poll(&p, 1, 0)) {
+            ffurl_close(hd);
+            return NULL;
+        }
+        hd->interrupt_callback = h->interrupt_callback;
+    }
+    return hd;
+}
+
+/* Keep the connection open for the next requests if the whole response
+ * has been read. Return 1 if the connection has been kept. */
+static int put_idle_connection(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    URLContext *expired[POOL_SIZE];
+    int i, nb_expired;
+
+    if (!can_reuse_connection(h) || !s->connection_url[0] ||
+        s->willclose || s->body_end < 0 ||
+        s->off != s->body_end || s->buf_ptr != s->buf_end ||
+        s->chunksize >= 0)
+        return 0;
+
+    /* do not call back the interrupt callback of this context anymore */
+    s->hd->interrupt_callback.callback = NULL;
+    s->hd->interrupt_callback.opaque   = NULL;
+    s->hd->flags &= ~AVIO_FLAG_NONBLOCK;
+
+    POOL_LOCK();
+    nb_expired = expire_idle_connections(expired, 1);
+    av_strlcpy(idle_connections[nb_idle_connections].url, s->connection_url,
+               sizeof(idle_connections[nb_idle_connections].url));
+    idle_connections[nb_idle_connections].hd     = s->hd;
+    idle_connections[nb_idle_connections].expiry = av_gettime() +
+                                                   s->idle_timeout * 1000000LL;
+    nb_idle_connections++;
+    POOL_UNLOCK();
+
+    for (i = 0; i < nb_expired; i++)
+        ffurl_close(expired[i]);
+
+    s->hd = NULL;
+    return 1;
+}
+
+void ff_http_close_idle_connections(void)
+{
+    URLContext *idle[POOL_SIZE];
+    int i, nb_idle;
+
+    POOL_LOCK();
+    nb_idle = nb_idle_connections;
+    for (i = 0; i < nb_idle; i++)
+        idle[i] = idle_connections[i].hd;
+    nb_idle_connections = 0;
+    POOL_UNLOCK();
+
+    for (i = 0; i < nb_idle; i++)
+        ffurl_close(idle[i]);
+}
+
 /* return non zero if error */
 static int http_open_cnx(URLContext *h, AVDictionary **options)
 {
@@ -143,8 +324,9 @@ static int http_open_cnx(URLContext *h, AVDictionary **options)
     char hostname[1024], hoststr[1024], proto[10];
     char auth[1024], proxyauth[1024] = "";
     char path1[MAX_URL_SIZE];
-    char buf[1024], urlbuf[MAX_URL_SIZE];
+    char buf[1024], urlbuf[MAX_URL_SIZE], key[MAX_URL_SIZE];
     int port, use_proxy, err, location_changed = 0, redirects = 0, attempts = 0;
+    int reused = 0, use_idle = can_reuse_connection(h);
     HTTPAuthType cur_auth_type, cur_proxy_auth_type;
     HTTPContext *s = h->priv_data;
 
@@ -187,16 +369,43 @@ static int http_open_cnx(URLContext *h, AVDictionary **options)
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
     if (!s->hd) {
-        err = ffurl_open(&s->hd, buf, AVIO_FLAG_READ_WRITE,
-                         &h->interrupt_callback, options);
-        if (err < 0)
-            goto fail;
+        if (!connection_key(key, sizeof(key), buf, lower_proto,
+                            options ? *options : NULL))
+            key[0] = '\0';
+        if (use_idle && key[0] && (s->hd = get_idle_connection(h, key))) {
+            reused = 1;
+            s->nb_reused_connections++;
+        } else {
+            err = ffurl_open(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                             &h->interrupt_callback, options);
+            if (err < 0)
+                goto fail;
+            s->nb_new_connections++;
+        }
+        POOL_LOCK();
+        if (reused)
+            total_reused_connections++;
+        else
+            total_new_connections++;
+        POOL_UNLOCK();
+        av_strlcpy(s->connection_url, key, sizeof(s->connection_url));
     }
 
     cur_auth_type = s->auth_state.auth_type;
     cur_proxy_auth_type = s->auth_state.auth_type;
-    if (http_connect(h, path, local_path, hoststr, auth, proxyauth, &location_changed) < 0)
+    if (http_connect(h, path, local_path, hoststr, auth, proxyauth, &location_changed) < 0) {
+        if (reused) {
+            /* the server may have dropped the idle connection, retry once
+             * with a new one */
+            ffurl_close(s->hd);
+            s->hd    = NULL;
+            reused   = 0;
+            use_idle = 0;
+            goto redo;
+        }
         goto fail;
+    }
+    reused = 0;
     attempts++;
     if (s->http_code == 401) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
@@ -230,6 +439,10 @@ static int http_open_cnx(URLContext *h, AVDictionary **options)
         location_changed = 0;
         goto redo;
     }
+    /* the headers are read in blocking mode, the body can be read in
+     * non-blocking mode, except for the interleaved icecast metadata */
+    if (h->flags & AVIO_FLAG_NONBLOCK && !s->icy_metaint)
+        s->hd->flags |= AVIO_FLAG_NONBLOCK;
     return 0;
  fail:
     if (s->hd)
@@ -324,6 +537,31 @@ static int http_get_line(HTTPContext *s, char *line, int line_size)
     }
 }
 
+/**
+ * Make sure that a whole line is buffered, so that a read which would block
+ * in non-blocking mode does not lose the start of the line.
+ */
+static int http_buffer_line(HTTPContext *s)
+{
+    int len;
+
+    while (!memchr(s->buf_ptr, '\n', s->buf_end - s->buf_ptr)) {
+        len = s->buf_end - s->buf_ptr;
+        if (len == BUFFER_SIZE)
+            return AVERROR_INVALIDDATA;
+        memmove(s->buffer, s->buf_ptr, len);
+        s->buf_ptr = s->buffer;
+        s->buf_end = s->buffer + len;
+        len = ffurl_read(s->hd, s->buf_end, BUFFER_SIZE - len);
+        if (len < 0)
+            return len;
+        if (!len)
+            return AVERROR_EOF;
+        s->buf_end += len;
+    }
+    return 0;
+}
+
 static int check_http_code(URLContext *h, int http_code, const char *end)
 {
     HTTPContext *s = h->priv_data;
@@ -442,6 +680,9 @@ static int process_line(URLContext *h, char *line, int line_count,
         while (av_isspace(*p))
             p++;
         s->http_code = strtol(p, &end, 10);
+        /* HTTP/1.0 servers close the connection unless told otherwise */
+        if (av_stristart(line, "HTTP/1.0", NULL))
+            s->willclose = 1;
 
         av_dlog(NULL, "http_code=%d\n", s->http_code);
 
@@ -462,8 +703,10 @@ static int process_line(URLContext *h, char *line, int line_count,
             if ((ret = parse_location(s, p)) < 0)
                 return ret;
             *new_location = 1;
-        } else if (!av_strcasecmp(tag, "Content-Length") && s->filesize == -1) {
-            s->filesize = strtoll(p, NULL, 10);
+        } else if (!av_strcasecmp(tag, "Content-Length")) {
+            s->content_length = strtoll(p, NULL, 10);
+            if (s->filesize == -1)
+                s->filesize = s->content_length;
         } else if (!av_strcasecmp(tag, "Content-Range")) {
             parse_content_range(h, p);
         } else if (!av_strcasecmp(tag, "Accept-Ranges") &&
@@ -482,6 +725,8 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Connection")) {
             if (!strcmp(p, "close"))
                 s->willclose = 1;
+            else if (!av_strcasecmp(p, "keep-alive"))
+                s->willclose = 0;
         } else if (!av_strcasecmp (tag, "Content-Type")) {
             av_free(s->mime_type);
             s->mime_type = av_strdup(p);
@@ -596,7 +841,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                            "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: ")) {
-        if (s->multiple_requests) {
+        if (s->multiple_requests || can_reuse_connection(h)) {
             len += av_strlcpy(headers + len, "Connection: keep-alive\r\n",
                               sizeof(headers) - len);
         } else {
@@ -654,6 +899,8 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     s->off = 0;
     s->icy_data_read = 0;
     s->filesize = -1;
+    s->body_end = -1;
+    s->content_length = -1;
     s->willclose = 0;
     s->end_chunked_post = 0;
     s->end_header = 0;
@@ -670,6 +917,9 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     if (err < 0)
         return err;
 
+    if (s->content_length >= 0 && s->chunksize < 0)
+        s->body_end = s->off + s->content_length;
+
     return (off == s->off) ? 0 : -1;
 }
 
@@ -686,7 +936,9 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
         memcpy(buf, s->buf_ptr, len);
         s->buf_ptr += len;
     } else {
-        if (!s->willclose && s->filesize >= 0 && s->off >= s->filesize)
+        if (!s->willclose &&
+            ((s->filesize >= 0 && s->off >= s->filesize) ||
+             (s->body_end >= 0 && s->off >= s->body_end)))
             return AVERROR_EOF;
         len = ffurl_read(s->hd, buf, size);
     }
@@ -750,6 +1002,9 @@ static int http_read_stream(URLContext *h, uint8_t *buf, int size)
 
             for(;;) {
                 do {
+                    if (s->hd->flags & AVIO_FLAG_NONBLOCK &&
+                        (err = http_buffer_line(s)) < 0)
+                        return err;
                     if ((err = http_get_line(s, line, sizeof(line))) < 0)
                         return err;
                 } while (!*line);    /* skip CR LF from last chunk */
@@ -894,8 +1149,13 @@ static int http_close(URLContext *h)
         ret = http_shutdown(h, h->flags);
     }
 
-    if (s->hd)
+    if (s->hd && !put_idle_connection(h))
         ffurl_close(s->hd);
+    av_log(h, AV_LOG_DEBUG,
+           "%d new and %d reused connections, "
+           "%d new and %d reused in total.\n",
+           s->nb_new_connections, s->nb_reused_connections,
+           total_new_connections, total_reused_connections);
     av_dict_free(&s->chained_options);
     return ret;
 }
@@ -906,6 +1166,7 @@ static int64_t http_seek(URLContext *h, int64_t off, int whence)
     URLContext *old_hd = s->hd;
     int64_t old_off = s->off;
     uint8_t old_buf[BUFFER_SIZE];
+    char old_url[sizeof(s->connection_url)];
     int old_buf_size, ret;
     AVDictionary *options = NULL;
 
@@ -920,6 +1181,7 @@ static int64_t http_seek(URLContext *h, int64_t off, int whence)
     /* we save the old context in case the seek fails */
     old_buf_size = s->buf_end - s->buf_ptr;
     memcpy(old_buf, s->buf_ptr, old_buf_size);
+    av_strlcpy(old_url, s->connection_url, sizeof(old_url));
     s->hd = NULL;
     if (whence == SEEK_CUR)
         off += s->off;
@@ -936,6 +1198,7 @@ static int64_t http_seek(URLContext *h, int64_t off, int whence)
         s->buf_end = s->buffer + old_buf_size;
         s->hd = old_hd;
         s->off = old_off;
+        av_strlcpy(s->connection_url, old_url, sizeof(s->connection_url));
         return ret;
     }
     av_dict_free(&options);
@@ -950,6 +1213,15 @@ http_get_file_handle(URLContext *h)
     return ffurl_get_file_handle(s->hd);
 }
 
+static int http_get_poll_fd(URLContext *h, int *fd, int *events)
+{
+    HTTPContext *s = h->priv_data;
+
+    if (!s->hd)
+        return AVERROR(ENOSYS);
+    return ffurl_get_poll_fd(s->hd, fd, events);
+}
+
 #if CONFIG_HTTP_PROTOCOL
 URLProtocol ff_http_protocol = {
     .name                = "http",
@@ -959,6 +1231,7 @@ URLProtocol ff_http_protocol = {
     .url_seek            = http_seek,
     .url_close           = http_close,
     .url_get_file_handle = http_get_file_handle,
+    .url_get_poll_fd     = http_get_poll_fd,
     .url_shutdown        = http_shutdown,
     .priv_data_size      = sizeof(HTTPContext),
     .priv_data_class     = &http_context_class,
@@ -974,6 +1247,7 @@ URLProtocol ff_https_protocol = {
     .url_seek            = http_seek,
     .url_close           = http_close,
     .url_get_file_handle = http_get_file_handle,
+    .url_get_poll_fd     = http_get_poll_fd,
     .url_shutdown        = http_shutdown,
     .priv_data_size      = sizeof(HTTPContext),
     .priv_data_class     = &https_context_class,
@@ -1062,8 +1336,11 @@ redo:
         goto redo;
     }
 
-    if (s->http_code < 400)
+    if (s->http_code < 400) {
+        if (h->flags & AVIO_FLAG_NONBLOCK)
+            s->hd->flags |= AVIO_FLAG_NONBLOCK;
         return 0;
+    }
     ret = AVERROR(EIO);
 
 fail:
@@ -1084,6 +1361,7 @@ URLProtocol ff_httpproxy_protocol = {
     .url_write           = http_proxy_write,
     .url_close           = http_proxy_close,
     .url_get_file_handle = http_get_file_handle,
+    .url_get_poll_fd     = http_get_poll_fd,
     .priv_data_size      = sizeof(HTTPContext),
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
 };
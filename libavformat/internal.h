@@ -48,6 +48,20 @@ struct AVFormatInternal {
      * Muxing only.
      */
     int nb_interleaved_streams;
+
+    /**
+     * Number and total size of the packets in the interleaving queue.
+     * Muxing only.
+     */
+    int     nb_interleaved_packets;
+    int64_t interleaved_size;
+
+    /**
+     * Set while the interleaving queue exceeds max_interleave_size, so that
+     * the overflow is only reported once.
+     * Muxing only.
+     */
+    int interleave_overflow;
 };
 
 void ff_dynarray_add(intptr_t **tab_ptr, int *nb_ptr, intptr_t elem);
@@ -83,6 +97,12 @@ int ff_hex_to_data(uint8_t *data, const char *p);
 
 void ff_program_add_stream_index(AVFormatContext *ac, int progid, unsigned int idx);
 
+/**
+ * Account for a packet removed from AVFormatContext->packet_buffer by a
+ * custom interleaving function.
+ */
+void ff_interleave_remove_packet(AVFormatContext *s, AVPacket *pkt);
+
 /**
  * Add packet to AVFormatContext->packet_buffer list, determining its
  * interleaved position using compare() function argument.
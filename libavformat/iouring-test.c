@@ -0,0 +1,220 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/lfg.h"
+#include "avformat.h"
+
+/* Files written at the same time through io_uring, in chunks of various
+ * sizes and with some bytes rewritten after seeking back, then read back
+ * with seeks. The same files are written with the usual system calls to
+ * compare them. */
+
+#define NB_FILES 3
+
+static const int file_sizes[NB_FILES] = { 1000, 1 << 20, 5000001 };
+
+static uint8_t byte_at(int file, int64_t pos)
+{
+    return (pos * 7 + (pos >> 8) + (pos >> 17) + file) & 0xff;
+}
+
+static int open_file(AVIOContext **pb, const char *prefix, int index,
+                     int io_uring, int depth, int flags)
+{
+    AVDictionary *opts = NULL;
+    char filename[1024], value[16];
+    int ret;
+
+    snprintf(filename, sizeof(filename), "%s-%d%s.bin", prefix, index,
+             io_uring ? "" : "-sync");
+    snprintf(value, sizeof(value), "%d", depth);
+    av_dict_set(&opts, "io_uring", io_uring ? "1" : "0", 0);
+    av_dict_set(&opts, "io_uring_depth", value, 0);
+    ret = avio_open2(pb, filename, flags, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        printf("cannot open %s\n", filename);
+    return ret;
+}
+
+static int write_files(const char *prefix, int io_uring, int depth)
+{
+    static uint8_t buf[300000];
+    AVIOContext *pb[NB_FILES];
+    int64_t pos[NB_FILES] = { 0 };
+    AVLFG lfg;
+    int i, j, n, active;
+
+    av_lfg_init(&lfg, 1);
+    for (i = 0; i < NB_FILES; i++)
+        if (open_file(&pb[i], prefix, i, io_uring, depth, AVIO_FLAG_WRITE) < 0)
+            return 1;
+
+    /* the header is written last, as the muxers often do */
+    for (i = 0; i < NB_FILES; i++) {
+        avio_wb32(pb[i], 0);
+        pos[i] = 4;
+    }
+    do {
+        active = 0;
+        for (i = 0; i < NB_FILES; i++) {
+            if (pos[i] == file_sizes[i])
+                continue;
+            active = 1;
+            n = FFMIN(av_lfg_get(&lfg) % sizeof(buf), file_sizes[i] - pos[i]);
+            for (j = 0; j < n; j++)
+                buf[j] = byte_at(i, pos[i] + j);
+            avio_write(pb[i], buf, n);
+            pos[i] += n;
+            if (!(av_lfg_get(&lfg) % 8)) {
+                int64_t back = av_lfg_get(&lfg) % pos[i];
+                /* seeking within the write buffer would drop its end */
+                avio_flush(pb[i]);
+                avio_seek(pb[i], back, SEEK_SET);
+                avio_w8(pb[i], byte_at(i, back));
+                avio_flush(pb[i]);
+                avio_seek(pb[i], pos[i], SEEK_SET);
+            }
+        }
+    } while (active);
+
+    for (i = 0; i < NB_FILES; i++) {
+        avio_flush(pb[i]);
+        avio_seek(pb[i], 0, SEEK_SET);
+        avio_wb32(pb[i], file_sizes[i]);
+        if (avio_close(pb[i]) < 0) {
+            printf("file %d: closing failed\n", i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_files(const char *prefix, int depth)
+{
+    AVIOContext *a, *b;
+    uint8_t buf_a[4096], buf_b[4096];
+    int i, len_a, len_b;
+
+    for (i = 0; i < NB_FILES; i++) {
+        if (open_file(&a, prefix, i, 1, depth, AVIO_FLAG_READ) < 0 ||
+            open_file(&b, prefix, i, 0, depth, AVIO_FLAG_READ) < 0)
+            return 1;
+        do {
+            len_a = avio_read(a, buf_a, sizeof(buf_a));
+            len_b = avio_read(b, buf_b, sizeof(buf_b));
+            if (len_a != len_b || (len_a > 0 && memcmp(buf_a, buf_b, len_a))) {
+                printf("file %d: different at %"PRId64"\n", i, avio_tell(b));
+                return 1;
+            }
+        } while (len_a > 0);
+        avio_close(a);
+        avio_close(b);
+    }
+    return 0;
+}
+
+static int read_files(const char *prefix, int depth)
+{
+    static uint8_t buf[300000];
+    AVIOContext *pb;
+    AVLFG lfg;
+    int64_t pos;
+    int i, j, k, ret;
+
+    av_lfg_init(&lfg, 2);
+    for (i = 0; i < NB_FILES; i++) {
+        if (open_file(&pb, prefix, i, 1, depth, AVIO_FLAG_READ) < 0)
+            return 1;
+        if (avio_size(pb) != file_sizes[i] || avio_rb32(pb) != file_sizes[i]) {
+            printf("file %d: wrong size\n", i);
+            return 1;
+        }
+        pos = 4;
+        for (k = 0; k < 100; k++) {
+            ret = avio_read(pb, buf, av_lfg_get(&lfg) % sizeof(buf));
+            if (ret < 0 && pos < file_sizes[i]) {
+                printf("file %d: reading at %"PRId64" failed\n", i, pos);
+                return 1;
+            }
+            for (j = 0; j < ret; j++) {
+                if (buf[j] != byte_at(i, pos + j)) {
+                    printf("file %d: wrong data at %"PRId64"\n", i, pos + j);
+                    return 1;
+                }
+            }
+            pos += FFMAX(ret, 0);
+            switch (av_lfg_get(&lfg) % 4) {
+            case 0:
+                pos = 4 + av_lfg_get(&lfg) % (file_sizes[i] - 4);
+                break;
+            case 1:
+                pos = FFMAX(file_sizes[i] - 100, 4);
+                break;
+            default:
+                continue;
+            }
+            if (avio_seek(pb, pos, SEEK_SET) != pos) {
+                printf("file %d: seeking to %"PRId64" failed\n", i, pos);
+                return 1;
+            }
+        }
+        avio_close(pb);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const int depths[] = { 1, 8 };
+    char filename[1024];
+    int i, d;
+
+    if (argc < 2) {
+        printf("usage: %s prefix\n", argv[0]);
+        return 1;
+    }
+
+    av_register_all();
+
+    for (d = 0; d < FF_ARRAY_ELEMS(depths); d++) {
+        if (write_files(argv[1], 1, depths[d]) ||
+            write_files(argv[1], 0, depths[d]) ||
+            compare_files(argv[1], depths[d]))
+            return 1;
+        printf("depth %d: %d files written, identical to the synchronous "
+               "output\n", depths[d], NB_FILES);
+        if (read_files(argv[1], depths[d]))
+            return 1;
+        printf("depth %d: %d files read with seeks\n", depths[d], NB_FILES);
+    }
+
+    for (i = 0; i < NB_FILES; i++) {
+        snprintf(filename, sizeof(filename), "%s-%d.bin", argv[1], i);
+        unlink(filename);
+        snprintf(filename, sizeof(filename), "%s-%d-sync.bin", argv[1], i);
+        unlink(filename);
+    }
+    return 0;
+}
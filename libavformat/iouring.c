@@ -0,0 +1,193 @@
+/*
+ * Minimal io_uring interface
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Minimal io_uring interface, using the system calls directly.
+ */
+
+#define _GNU_SOURCE     /* Needed for syscall() and MAP_POPULATE */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "libavutil/atomic.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+
+#include "iouring.h"
+
+/* the heads and tails of the rings are shared with the kernel */
+#define LOAD_ACQUIRE(p)     ((unsigned)avpriv_atomic_int_get((volatile int *)(p)))
+#define STORE_RELEASE(p, v) avpriv_atomic_int_set((volatile int *)(p), (v))
+
+int ff_iouring_init(IOURing *r, unsigned entries)
+{
+    struct io_uring_params p = { 0 };
+    int ret;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0)
+        return AVERROR(errno);
+    r->features = p.features;
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (r->features & IORING_FEAT_SINGLE_MMAP)
+        r->sq_ring_size = r->cq_ring_size = FFMAX(r->sq_ring_size,
+                                                  r->cq_ring_size);
+
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        r->sq_ring = NULL;
+        goto fail;
+    }
+    if (r->features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) {
+            r->cq_ring = NULL;
+            goto fail;
+        }
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes      = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        goto fail;
+    }
+
+    r->sq_head    = (unsigned *)((uint8_t *)r->sq_ring + p.sq_off.head);
+    r->sq_tail    = (unsigned *)((uint8_t *)r->sq_ring + p.sq_off.tail);
+    r->sq_mask    = (unsigned *)((uint8_t *)r->sq_ring + p.sq_off.ring_mask);
+    r->sq_array   = (unsigned *)((uint8_t *)r->sq_ring + p.sq_off.array);
+    r->sq_entries = p.sq_entries;
+    r->sqe_tail   = *r->sq_tail;
+
+    r->cq_head = (unsigned *)((uint8_t *)r->cq_ring + p.cq_off.head);
+    r->cq_tail = (unsigned *)((uint8_t *)r->cq_ring + p.cq_off.tail);
+    r->cq_mask = (unsigned *)((uint8_t *)r->cq_ring + p.cq_off.ring_mask);
+    r->cqes    = (struct io_uring_cqe *)((uint8_t *)r->cq_ring + p.cq_off.cqes);
+
+    return 0;
+
+fail:
+    ret = AVERROR(errno);
+    ff_iouring_uninit(r);
+    return ret;
+}
+
+void ff_iouring_uninit(IOURing *r)
+{
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring && r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_size);
+    if (r->sq_ring)
+        munmap(r->sq_ring, r->sq_ring_size);
+    if (r->fd >= 0)
+        close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+struct io_uring_sqe *ff_iouring_get_sqe(IOURing *r)
+{
+    struct io_uring_sqe *sqe;
+    unsigned index;
+
+    if (r->sqe_tail - LOAD_ACQUIRE(r->sq_head) >= r->sq_entries)
+        return NULL;
+
+    index = r->sqe_tail & *r->sq_mask;
+    sqe   = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[index] = index;
+    r->sqe_tail++;
+
+    return sqe;
+}
+
+int ff_iouring_submit(IOURing *r, unsigned wait_nr, int64_t timeout)
+{
+    struct {
+        int64_t tv_sec;
+        long long tv_nsec;
+    } ts = { timeout / 1000000, timeout % 1000000 * 1000 };
+    struct io_uring_getevents_arg arg = { 0 };
+    unsigned flags = 0;
+    void *argp     = NULL;
+    size_t argsz   = 0;
+    int ret;
+
+    if (timeout >= 0 && wait_nr) {
+        if (!(r->features & IORING_FEAT_EXT_ARG))
+            return AVERROR(ENOSYS);
+        arg.ts = (uintptr_t)&ts;
+        argp   = &arg;
+        argsz  = sizeof(arg);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    if (wait_nr)
+        flags |= IORING_ENTER_GETEVENTS;
+
+    STORE_RELEASE(r->sq_tail, r->sqe_tail);
+
+    for (;;) {
+        /* the kernel consumes the entries even when the wait fails */
+        unsigned to_submit = r->sqe_tail - LOAD_ACQUIRE(r->sq_head);
+
+        if (!to_submit && LOAD_ACQUIRE(r->cq_tail) - *r->cq_head >= wait_nr)
+            return 0;
+        ret = syscall(__NR_io_uring_enter, r->fd, to_submit, wait_nr,
+                      flags, argp, argsz);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ETIME)
+                return AVERROR(ETIMEDOUT);
+            return AVERROR(errno);
+        }
+        if (!wait_nr)
+            return 0;
+    }
+}
+
+struct io_uring_cqe *ff_iouring_peek_cqe(IOURing *r)
+{
+    unsigned head = *r->cq_head;
+
+    if (head == LOAD_ACQUIRE(r->cq_tail))
+        return NULL;
+    return &r->cqes[head & *r->cq_mask];
+}
+
+void ff_iouring_cqe_seen(IOURing *r)
+{
+    STORE_RELEASE(r->cq_head, *r->cq_head + 1);
+}
@@ -0,0 +1,90 @@
+/*
+ * Minimal io_uring interface
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_IOURING_H
+#define AVFORMAT_IOURING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+/**
+ * Submission and completion queues shared with the kernel, used by a
+ * single thread.
+ */
+typedef struct IOURing {
+    int fd;
+    unsigned features;          ///< IORING_FEAT_* flags of the kernel
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned sqe_tail;          ///< tail including the entries not submitted
+
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+} IOURing;
+
+/**
+ * Set up a ring of at least entries submission queue entries.
+ *
+ * @return 0 on success, a negative error code if io_uring is not
+ *         available, in which case the caller has to fall back to the
+ *         synchronous system calls
+ */
+int ff_iouring_init(IOURing *r, unsigned entries);
+
+void ff_iouring_uninit(IOURing *r);
+
+/**
+ * Get a cleared submission queue entry to prepare. It is submitted by the
+ * next call to ff_iouring_submit().
+ *
+ * @return the entry, NULL if the submission queue is full
+ */
+struct io_uring_sqe *ff_iouring_get_sqe(IOURing *r);
+
+/**
+ * Submit the entries prepared and wait for at least wait_nr completions,
+ * with a single system call.
+ *
+ * @param timeout maximum time to wait in microseconds, negative to wait
+ *                without limit
+ * @return 0 on success, AVERROR(ETIMEDOUT) if the timeout expired first,
+ *         another negative error code on failure
+ */
+int ff_iouring_submit(IOURing *r, unsigned wait_nr, int64_t timeout);
+
+/**
+ * Get the oldest completion, without waiting. It has to be released with
+ * ff_iouring_cqe_seen() before getting the next one.
+ *
+ * @return the completion, NULL if there is none
+ */
+struct io_uring_cqe *ff_iouring_peek_cqe(IOURing *r);
+
+void ff_iouring_cqe_seen(IOURing *r);
+
+#endif /* AVFORMAT_IOURING_H */
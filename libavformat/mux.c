@@ -481,6 +481,7 @@ void ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
                               int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
 {
     AVPacketList **next_point, *this_pktl;
+    AVStream *st;
 
     this_pktl      = av_mallocz(sizeof(AVPacketList));
     this_pktl->pkt = *pkt;
@@ -515,6 +516,30 @@ next_non_null:
 
     s->streams[pkt->stream_index]->last_in_packet_buffer =
         *next_point                                      = this_pktl;
+
+    s->internal->nb_interleaved_packets++;
+    s->internal->interleaved_size += this_pktl->pkt.size;
+
+    st = s->streams[this_pktl->pkt.stream_index];
+    if (this_pktl->pkt.dts != AV_NOPTS_VALUE && this_pktl->pkt.duration > 0)
+        st->mux_next_dts = this_pktl->pkt.dts + this_pktl->pkt.duration;
+    else
+        st->mux_next_dts = AV_NOPTS_VALUE;
+}
+
+void ff_interleave_remove_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    s->internal->nb_interleaved_packets--;
+    s->internal->interleaved_size -= pkt->size;
+}
+
+void av_interleaved_queue_size(AVFormatContext *s, int *nb_packets,
+                               int64_t *size)
+{
+    if (nb_packets)
+        *nb_packets = s->internal->nb_interleaved_packets;
+    if (size)
+        *size = s->internal->interleaved_size;
 }
 
 static int interleave_compare_dts(AVFormatContext *s, AVPacket *next,
@@ -530,6 +555,35 @@ static int interleave_compare_dts(AVFormatContext *s, AVPacket *next,
     return comp > 0;
 }
 
+/**
+ * Check whether the first queued packet can be output before the next packet
+ * of every stream that has none queued, predicting the dts of those from the
+ * dts and duration of their last packet.
+ */
+static int interleave_next_dts_known(AVFormatContext *s)
+{
+    AVPacket *top_pkt = &s->packet_buffer->pkt;
+    AVStream *top_st  = s->streams[top_pkt->stream_index];
+    int i;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        int comp;
+
+        if (st->last_in_packet_buffer ||
+            st->codec->codec_type == AVMEDIA_TYPE_ATTACHMENT)
+            continue;
+        if (st->mux_next_dts == AV_NOPTS_VALUE)
+            return 0;
+
+        comp = av_compare_ts(top_pkt->dts, top_st->time_base,
+                             st->mux_next_dts, st->time_base);
+        if (comp > 0 || (!comp && top_pkt->stream_index > i))
+            return 0;
+    }
+    return 1;
+}
+
 int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
                                  AVPacket *pkt, int flush)
 {
@@ -541,6 +595,21 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
         ff_interleave_add_packet(s, pkt, interleave_compare_dts);
     }
 
+    if (s->max_interleave_size > 0 && !flush) {
+        if (s->internal->interleaved_size > s->max_interleave_size) {
+            if (!s->internal->interleave_overflow)
+                av_log(s, AV_LOG_WARNING,
+                       "Size of the muxing queue is %"PRId64" > %"PRId64" "
+                       "bytes (%d packets): forcing output\n",
+                       s->internal->interleaved_size, s->max_interleave_size,
+                       s->internal->nb_interleaved_packets);
+            s->internal->interleave_overflow = 1;
+            flush = 1;
+        } else if (s->internal->interleaved_size < s->max_interleave_size / 2) {
+            s->internal->interleave_overflow = 0;
+        }
+    }
+
     if (s->max_interleave_delta > 0 && s->packet_buffer && !flush) {
         AVPacket *top_pkt = &s->packet_buffer->pkt;
         int64_t delta_dts = INT64_MIN;
@@ -574,10 +643,15 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
             stream_count += !!s->streams[i]->last_in_packet_buffer;
     }
 
+    if (s->flags & AVFMT_FLAG_LOW_LATENCY && stream_count && !flush &&
+        stream_count < s->internal->nb_interleaved_streams &&
+        interleave_next_dts_known(s))
+        flush = 1;
 
     if (stream_count && (s->internal->nb_interleaved_streams == stream_count || flush)) {
         pktl = s->packet_buffer;
         *out = pktl->pkt;
+        ff_interleave_remove_packet(s, out);
 
         s->packet_buffer = pktl->next;
         if (!s->packet_buffer)
@@ -0,0 +1,194 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/common.h"
+#include "avformat.h"
+#include "network.h"
+#include "os_support.h"
+
+/* Many TCP sources on the loopback, read in non-blocking mode from a single
+ * thread waiting on the file descriptors returned by avio_get_poll_fd(). The
+ * same thread sends the data of the sources, in chunks of various sizes. */
+
+#define NB_SOURCES 64
+
+typedef struct Source {
+    AVIOContext *pb;
+    int fd;                     ///< sending end of the connection
+    int size;                   ///< size of the data sent
+    int sent;
+    int received;
+    int eof;
+} Source;
+
+static uint8_t byte_at(int source, int pos)
+{
+    return (pos * 7 + (pos >> 8) + source) & 0xff;
+}
+
+static int send_chunk(Source *src, int index)
+{
+    uint8_t buf[8192];
+    int i, ret, len = FFMIN(1000 + (index * 997 + src->sent) % 7000,
+                            src->size - src->sent);
+
+    for (i = 0; i < len; i++)
+        buf[i] = byte_at(index, src->sent + i);
+    ret = send(src->fd, buf, len, 0);
+    if (ret < 0) {
+        ret = ff_neterrno();
+        return ret == AVERROR(EAGAIN) ? 0 : ret;
+    }
+    src->sent += ret;
+    if (src->sent == src->size) {
+        closesocket(src->fd);
+        src->fd = -1;
+    }
+    return 0;
+}
+
+static int receive(Source *src, int index)
+{
+    uint8_t buf[4096];
+    int i, ret;
+
+    /* read everything buffered before waiting again */
+    while ((ret = avio_read(src->pb, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < ret; i++) {
+            if (buf[i] != byte_at(index, src->received + i)) {
+                printf("source %d: wrong data at %d\n", index,
+                       src->received + i);
+                return AVERROR_INVALIDDATA;
+            }
+        }
+        src->received += ret;
+    }
+    if (ret == AVERROR_EOF) {
+        src->eof = 1;
+        return 0;
+    }
+    return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+int main(void)
+{
+    Source sources[NB_SOURCES] = { { 0 } };
+    struct pollfd p[2 * NB_SOURCES];
+    Source *owner[2 * NB_SOURCES];
+    struct sockaddr_in addr = { 0 };
+    socklen_t addr_len = sizeof(addr);
+    char url[100];
+    uint8_t byte;
+    int i, n, fd, ret, events, active, total = 0;
+
+    av_register_all();
+    avformat_network_init();
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(fd, NB_SOURCES) ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len)) {
+        printf("cannot listen on the loopback\n");
+        return 1;
+    }
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+
+    for (i = 0; i < NB_SOURCES; i++) {
+        Source *src = &sources[i];
+        ret = avio_open2(&src->pb, url, AVIO_FLAG_READ | AVIO_FLAG_NONBLOCK,
+                         NULL, NULL);
+        if (ret < 0 || (src->fd = accept(fd, NULL, NULL)) < 0) {
+            printf("cannot connect source %d\n", i);
+            return 1;
+        }
+        ff_socket_nonblock(src->fd, 1);
+        src->size = 50000 + i * 1500;
+        total    += src->size;
+    }
+    closesocket(fd);
+
+    for (i = 0; i < NB_SOURCES; i++) {
+        if (avio_read(sources[i].pb, &byte, 1) != AVERROR(EAGAIN)) {
+            printf("source %d: reading without data did not fail with "
+                   "EAGAIN\n", i);
+            return 1;
+        }
+    }
+    printf("reading the %d sources without data: EAGAIN\n", NB_SOURCES);
+
+    do {
+        active = n = 0;
+        for (i = 0; i < NB_SOURCES; i++) {
+            Source *src = &sources[i];
+            if (src->fd >= 0) {
+                p[n].fd     = src->fd;
+                p[n].events = POLLOUT;
+                owner[n++]  = src;
+            }
+            if (!src->eof) {
+                if (avio_get_poll_fd(src->pb, &p[n].fd, &events) < 0) {
+                    printf("source %d: no file descriptor to wait on\n", i);
+                    return 1;
+                }
+                p[n].events = (events & AVIO_POLL_IN  ? POLLIN  : 0) |
+                              (events & AVIO_POLL_OUT ? POLLOUT : 0);
+                owner[n++]  = src;
+                active++;
+            }
+        }
+        if (!active)
+            break;
+
+        ret = poll(p, n, 5000);
+        if (ret <= 0) {
+            printf("poll() %s\n", ret ? "failed" : "timed out");
+            return 1;
+        }
+        for (i = 0; i < n; i++) {
+            Source *src = owner[i];
+            if (!p[i].revents)
+                continue;
+            if (src->fd >= 0 && p[i].fd == src->fd)
+                ret = send_chunk(src, src - sources);
+            else
+                ret = receive(src, src - sources);
+            if (ret < 0) {
+                printf("source %d: error %d\n", (int)(src - sources), ret);
+                return 1;
+            }
+        }
+    } while (1);
+
+    for (i = 0; i < NB_SOURCES; i++) {
+        if (sources[i].received != sources[i].size) {
+            printf("source %d: %d of %d bytes received\n", i,
+                   sources[i].received, sources[i].size);
+            return 1;
+        }
+        avio_close(sources[i].pb);
+    }
+    printf("%d bytes received from %d sources in a single thread\n",
+           total, NB_SOURCES);
+
+    avformat_network_deinit();
+    return 0;
+}
@@ -261,6 +261,9 @@ static void rtp_parse_addr_list(URLContext *h, char *buf,
  *         'sources=ip[,ip]'  : list allowed source IP addresses
  *         'block=ip[,ip]'    : list disallowed source IP addresses
  *         'write_to_source=0/1' : send packets to the source address of the latest received packet
+ *         'batch=n'          : send the rtp packets n at a time
+ *         'gso=0/1'          : send each batch as a single segmented datagram
+ *         'bitrate=n'        : pace the rtp packets to n bits per second
  * deprecated option:
  *         'localport=n'      : set the local port to n
  *
@@ -275,7 +278,8 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     RTPContext *s = h->priv_data;
     int rtp_port, rtcp_port,
         ttl, connect,
-        local_rtp_port, local_rtcp_port, max_packet_size;
+        local_rtp_port, local_rtcp_port, max_packet_size, batch, gso;
+    int64_t bitrate;
     char hostname[256], include_sources[1024] = "", exclude_sources[1024] = "";
     char buf[1024];
     char path[1024];
@@ -290,6 +294,8 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     local_rtcp_port = -1;
     max_packet_size = -1;
     connect = 0;
+    batch = gso = 0;
+    bitrate = 0;
 
     p = strchr(uri, '?');
     if (p) {
@@ -317,6 +323,15 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "write_to_source", p)) {
             s->write_to_source = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch", p)) {
+            batch = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p)) {
+            gso = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
+            bitrate = strtoll(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p)) {
             av_strlcpy(include_sources, buf, sizeof(include_sources));
             rtp_parse_addr_list(h, buf, &s->ssm_include_addrs, &s->nb_ssm_include_addrs);
@@ -330,6 +345,13 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     build_udp_url(buf, sizeof(buf),
                   hostname, rtp_port, local_rtp_port, ttl, max_packet_size,
                   connect, include_sources, exclude_sources);
+    /* only the rtp packets are batched, rtcp is sent right away */
+    if (batch > 1)
+        url_add_option(buf, sizeof(buf), "batch=%d", batch);
+    if (gso)
+        url_add_option(buf, sizeof(buf), "gso=%d", gso);
+    if (bitrate > 0)
+        url_add_option(buf, sizeof(buf), "bitrate=%"PRId64, bitrate);
     if (ffurl_open(&s->rtp_hd, buf, flags, &h->interrupt_callback, NULL) < 0)
         goto fail;
     if (local_rtp_port>=0 && local_rtcp_port<0)
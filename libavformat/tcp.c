@@ -27,11 +27,126 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if CONFIG_IO_URING
+#include "iouring.h"
+#endif
 
 typedef struct TCPContext {
     int fd;
+#if CONFIG_IO_URING
+    IOURing ring;
+    int uring;
+#endif
 } TCPContext;
 
+#if CONFIG_IO_URING
+enum { REQUEST_POLL = 1, REQUEST_TRANSFER, REQUEST_CANCEL };
+
+static void tcp_uring_init(URLContext *h)
+{
+    TCPContext *s = h->priv_data;
+    char errbuf[128];
+    int ret;
+
+    /* a poll, the transfer linked to it and their cancellations */
+    ret = ff_iouring_init(&s->ring, 4);
+    /* the timed waits need IORING_FEAT_EXT_ARG, which implies RECV/SEND */
+    if (!ret && !(s->ring.features & IORING_FEAT_EXT_ARG)) {
+        ff_iouring_uninit(&s->ring);
+        ret = AVERROR(ENOSYS);
+    }
+    if (ret < 0) {
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        av_log(h, AV_LOG_WARNING, "io_uring is not available (%s), "
+               "using the synchronous system calls.\n", errbuf);
+        return;
+    }
+    s->uring = 1;
+}
+
+static void tcp_uring_cancel(TCPContext *s, uint64_t request)
+{
+    struct io_uring_sqe *sqe = ff_iouring_get_sqe(&s->ring);
+
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = request;
+    sqe->user_data = REQUEST_CANCEL;
+}
+
+/**
+ * Receive or send with a single system call submitting the transfer and
+ * waiting for it. If nothing was transferred after the timeout of
+ * ff_network_wait_fd(), the transfer is cancelled and AVERROR(EAGAIN)
+ * returned, so that the callers check the interrupt callback as usual.
+ *
+ * The socket is non-blocking, on which a receive or send submitted before
+ * the socket is ready may fail with EAGAIN instead of waiting. The transfer
+ * is therefore linked to a poll of the socket, and only started once the
+ * poll completes.
+ */
+static int tcp_uring_transfer(URLContext *h, const uint8_t *buf, int size,
+                              int write)
+{
+    TCPContext *s = h->priv_data;
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    uint32_t events = write ? POLLOUT : POLLIN;
+    int ret, res = AVERROR(EAGAIN), pending = 2;
+    char errbuf[128];
+
+#if HAVE_BIGENDIAN
+    events = events << 16 | events >> 16;
+#endif
+    sqe = ff_iouring_get_sqe(&s->ring);
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->flags         = IOSQE_IO_LINK;
+    sqe->fd            = s->fd;
+    sqe->poll32_events = events;
+    sqe->user_data     = REQUEST_POLL;
+
+    sqe = ff_iouring_get_sqe(&s->ring);
+    sqe->opcode    = write ? IORING_OP_SEND : IORING_OP_RECV;
+    sqe->fd        = s->fd;
+    sqe->addr      = (uintptr_t)buf;
+    sqe->len       = size;
+    sqe->user_data = REQUEST_TRANSFER;
+
+    ret = ff_iouring_submit(&s->ring, 2, POLLING_TIME * 1000);
+    if (ret == AVERROR(ETIMEDOUT)) {
+        /* the buffer must not be used once this function returns */
+        tcp_uring_cancel(s, REQUEST_POLL);
+        tcp_uring_cancel(s, REQUEST_TRANSFER);
+        pending += 2;
+    } else if (ret < 0) {
+        goto fail;
+    }
+    while (pending) {
+        if (!(cqe = ff_iouring_peek_cqe(&s->ring))) {
+            if ((ret = ff_iouring_submit(&s->ring, 1, -1)) < 0)
+                goto fail;
+            continue;
+        }
+        /* a failed poll cancels the transfer */
+        if (cqe->user_data != REQUEST_CANCEL && cqe->res < 0 &&
+            cqe->res != -ECANCELED)
+            res = AVERROR(-cqe->res);
+        else if (cqe->user_data == REQUEST_TRANSFER && cqe->res >= 0)
+            res = cqe->res;
+        ff_iouring_cqe_seen(&s->ring);
+        pending--;
+    }
+    return res;
+
+fail:
+    av_strerror(ret, errbuf, sizeof(errbuf));
+    av_log(h, AV_LOG_WARNING, "io_uring failed (%s), "
+           "using the synchronous system calls.\n", errbuf);
+    ff_iouring_uninit(&s->ring);
+    s->uring = 0;
+    return ret;
+}
+#endif
+
 /* return non zero if error */
 static int tcp_open(URLContext *h, const char *uri, int flags)
 {
@@ -39,6 +154,7 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     int port, fd = -1;
     TCPContext *s = h->priv_data;
     int listen_socket = 0;
+    int use_io_uring = 0;
     const char *p;
     char buf[256];
     int ret;
@@ -64,6 +180,8 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "listen_timeout", p)) {
             listen_timeout = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "io_uring", p))
+            use_io_uring = !buf[0] || strtol(buf, NULL, 10);
     }
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
@@ -112,6 +230,14 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     h->is_streamed = 1;
     s->fd = fd;
     freeaddrinfo(ai);
+
+    if (use_io_uring) {
+#if CONFIG_IO_URING
+        tcp_uring_init(h);
+#else
+        av_log(h, AV_LOG_WARNING, "io_uring is not supported.\n");
+#endif
+    }
     return 0;
 
  fail:
@@ -135,6 +261,10 @@ static int tcp_read(URLContext *h, uint8_t *buf, int size)
     TCPContext *s = h->priv_data;
     int ret;
 
+#if CONFIG_IO_URING
+    if (s->uring && !(h->flags & AVIO_FLAG_NONBLOCK))
+        return tcp_uring_transfer(h, buf, size, 0);
+#endif
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->fd, 0);
         if (ret < 0)
@@ -149,6 +279,10 @@ static int tcp_write(URLContext *h, const uint8_t *buf, int size)
     TCPContext *s = h->priv_data;
     int ret;
 
+#if CONFIG_IO_URING
+    if (s->uring && !(h->flags & AVIO_FLAG_NONBLOCK))
+        return tcp_uring_transfer(h, buf, size, 1);
+#endif
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->fd, 1);
         if (ret < 0)
@@ -177,6 +311,10 @@ static int tcp_shutdown(URLContext *h, int flags)
 static int tcp_close(URLContext *h)
 {
     TCPContext *s = h->priv_data;
+#if CONFIG_IO_URING
+    if (s->uring)
+        ff_iouring_uninit(&s->ring);
+#endif
     closesocket(s->fd);
     return 0;
 }
@@ -0,0 +1,167 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/log.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "network.h"
+#include "os_support.h"
+#include "url.h"
+
+/* A TCP connection on the loopback using io_uring, with the peer run by a
+ * thread. The peer only sends its data after a delay longer than the
+ * timeout of the transfers, so the receives are submitted before there is
+ * anything to read. It then reads the data sent back slowly, so the sends
+ * wait for the socket buffer to drain. A read is also interrupted while
+ * waiting, which must not lose the data received afterwards. Any fallback
+ * to the synchronous system calls is reported. */
+
+#define SIZE (4 << 20)
+
+static uint8_t byte_at(int pos)
+{
+    return (pos * 7 + (pos >> 8) + (pos >> 17)) & 0xff;
+}
+
+static const char *peer_error;
+static int fallbacks, interrupts;
+
+static void log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    if (strstr(fmt, "synchronous system calls"))
+        fallbacks++;
+    av_log_default_callback(avcl, level, fmt, vl);
+}
+
+static int interrupt_cb(void *opaque)
+{
+    return interrupts && !--interrupts;
+}
+
+static void *peer(void *arg)
+{
+    static uint8_t buf[65536];
+    int fd = *(int *)arg, pos, i, ret;
+
+    av_usleep(300000);
+    for (pos = 0; pos < SIZE; pos += ret) {
+        int len = FFMIN(1000 + pos % 50000, SIZE - pos);
+        for (i = 0; i < len; i++)
+            buf[i] = byte_at(pos + i);
+        if ((ret = send(fd, buf, len, 0)) < 0) {
+            peer_error = "send() failed";
+            return NULL;
+        }
+    }
+
+    av_usleep(300000);
+    for (pos = 0; pos < SIZE; pos += ret) {
+        if ((ret = recv(fd, buf, FFMIN(sizeof(buf), SIZE - pos), 0)) <= 0) {
+            peer_error = "recv() failed";
+            return NULL;
+        }
+        for (i = 0; i < ret; i++) {
+            if (buf[i] != byte_at(pos + i)) {
+                peer_error = "wrong data sent";
+                return NULL;
+            }
+        }
+        if (!(pos >> 20 & 1))
+            av_usleep(100);
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    static uint8_t buf[SIZE];
+    AVIOInterruptCB int_cb = { interrupt_cb, NULL };
+    struct sockaddr_in addr = { 0 };
+    socklen_t addr_len = sizeof(addr);
+    URLContext *h;
+    pthread_t thread;
+    char url[100];
+    int i, fd, peer_fd, ret;
+
+    av_register_all();
+    avformat_network_init();
+    av_log_set_callback(log_callback);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(fd, 1) || getsockname(fd, (struct sockaddr *)&addr, &addr_len)) {
+        printf("cannot listen on the loopback\n");
+        return 1;
+    }
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d?io_uring=1",
+             ntohs(addr.sin_port));
+    ret = ffurl_open(&h, url, AVIO_FLAG_READ_WRITE, &int_cb, NULL);
+    if (ret < 0 || (peer_fd = accept(fd, NULL, NULL)) < 0) {
+        printf("cannot connect\n");
+        return 1;
+    }
+    closesocket(fd);
+
+    interrupts = 3;
+    ret = ffurl_read(h, buf, 1);
+    printf("read interrupted while waiting: %s\n",
+           ret == AVERROR_EXIT ? "yes" : "no");
+
+    if (pthread_create(&thread, NULL, peer, &peer_fd)) {
+        printf("cannot create the peer thread\n");
+        return 1;
+    }
+
+    ret = ffurl_read_complete(h, buf, SIZE);
+    if (ret != SIZE) {
+        printf("%d of %d bytes received\n", ret, SIZE);
+        return 1;
+    }
+    for (i = 0; i < SIZE; i++) {
+        if (buf[i] != byte_at(i)) {
+            printf("wrong data received at %d\n", i);
+            return 1;
+        }
+    }
+    printf("%d bytes received\n", SIZE);
+
+    ret = ffurl_write(h, buf, SIZE);
+    if (ret < 0) {
+        printf("sending failed\n");
+        return 1;
+    }
+    pthread_join(thread, NULL);
+    if (peer_error) {
+        printf("peer: %s\n", peer_error);
+        return 1;
+    }
+    printf("%d bytes sent\n", SIZE);
+    printf("fallbacks to the system calls: %d\n", fallbacks);
+
+    ffurl_close(h);
+    closesocket(peer_fd);
+    avformat_network_deinit();
+    return 0;
+}
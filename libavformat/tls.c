@@ -68,6 +68,7 @@ typedef struct {
     SSL *ssl;
 #endif
     int fd;
+    int poll_events;            ///< events the last blocked operation waits for
     char *ca_file;
     int verify;
     char *cert_file;
@@ -125,8 +126,10 @@ static int do_tls_poll(URLContext *h, int ret)
         return AVERROR(EIO);
     }
 #endif
-    if (h->flags & AVIO_FLAG_NONBLOCK)
+    if (h->flags & AVIO_FLAG_NONBLOCK) {
+        c->poll_events = p.events & POLLOUT ? AVIO_POLL_OUT : AVIO_POLL_IN;
         return AVERROR(EAGAIN);
+    }
     while (1) {
         int n = poll(&p, 1, 100);
         if (n > 0)
@@ -347,12 +350,32 @@ static int tls_close(URLContext *h)
     return 0;
 }
 
+static int tls_get_file_handle(URLContext *h)
+{
+    TLSContext *c = h->priv_data;
+    return c->fd;
+}
+
+static int tls_get_poll_fd(URLContext *h, int *fd, int *events)
+{
+    TLSContext *c = h->priv_data;
+
+    /* reading may have to wait for writing during a renegotiation, and
+     * conversely */
+    *fd = c->fd;
+    if (c->poll_events)
+        *events = c->poll_events;
+    return 0;
+}
+
 URLProtocol ff_tls_protocol = {
     .name           = "tls",
     .url_open       = tls_open,
     .url_read       = tls_read,
     .url_write      = tls_write,
     .url_close      = tls_close,
+    .url_get_file_handle = tls_get_file_handle,
+    .url_get_poll_fd     = tls_get_poll_fd,
     .priv_data_size = sizeof(TLSContext),
     .flags          = URL_PROTOCOL_FLAG_NETWORK,
     .priv_data_class = &tls_class,
@@ -25,16 +25,28 @@
  */
 
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
+
+#include "config.h"
 
 #include "avformat.h"
 #include "avio_internal.h"
-#include "libavutil/parseutils.h"
 #include "libavutil/avstring.h"
+#include "libavutil/fifo.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
 #include "internal.h"
 #include "network.h"
 #include "os_support.h"
 #include "url.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+#if HAVE_UDP_SEGMENT
+#include <netinet/udp.h>
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 #define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
@@ -50,10 +62,53 @@ typedef struct {
     struct sockaddr_storage dest_addr;
     int dest_addr_len;
     int is_connected;
+
+    /* receive thread */
+    int fifo_size;              ///< size of the datagram fifo in bytes, 0 for none
+    int overrun_nonfatal;       ///< drop the datagrams not fitting in the fifo
+#if HAVE_PTHREADS
+    AVFifoBuffer *fifo;         ///< received datagrams, each preceded by its size
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int thread_started;
+    int quit;
+    int error;                  ///< error which stopped the receive thread
+    int overrun;                ///< the last datagram was dropped
+    uint64_t nb_received;       ///< datagrams received by the thread
+    uint64_t nb_overruns;       ///< datagrams dropped as the fifo was full
+#endif
+
+    /* batched output */
+    int batch;                  ///< number of datagrams sent with a single call
+    int gso;                    ///< send the batches as a single segmented datagram
+    int64_t bitrate;            ///< pace the output to this many bits per second
+    int64_t batch_timeout;      ///< time an incomplete batch is held, in us
+    uint8_t *tx_buf;            ///< queued datagrams, back to back
+    int *tx_sizes;
+    int nb_tx;                  ///< number of datagrams queued
+    int tx_bytes;               ///< size of the datagrams queued
+    int tx_sent;                ///< number of queued datagrams already sent
+    int tx_offset;              ///< offset of the first datagram not sent yet
+    int64_t send_time;          ///< time before which the next batch is held
+    int64_t tx_time;            ///< time the first queued datagram was written
+    int send_thread_started;    ///< the queue is flushed by a thread on timeout
+    uint64_t nb_sent;           ///< datagrams sent from the queue
+    uint64_t nb_send_calls;     ///< system calls used to send them
 } UDPContext;
 
 #define UDP_TX_BUF_SIZE 32768
 #define UDP_MAX_PKT_SIZE 65536
+/* maximal number of datagrams read with a single call by the receive thread */
+#define UDP_RECV_BATCH 32
+/* maximal number of datagrams sent with a single call */
+#define UDP_SEND_BATCH_MAX 64
+/* maximal payload of a segmented datagram */
+#define UDP_GSO_MAX_SIZE 65507
+/* maximal delay of the paced output before it stops catching up */
+#define UDP_PACING_MAX_LAG 100000
+/* time an incomplete batch is held by default */
+#define UDP_BATCH_TIMEOUT 10000
 
 static void log_net_error(void *ctx, int level, const char* prefix)
 {
@@ -307,6 +362,162 @@ static int udp_port(struct sockaddr_storage *addr, int addr_len)
 }
 
 
+/**
+ * Send the queued datagrams not sent yet, with as few calls as possible.
+ *
+ * @return the number of datagrams sent, or a negative AVERROR code
+ */
+static int udp_send_queued(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    struct sockaddr *dest = s->is_connected ? NULL :
+                            (struct sockaddr *)&s->dest_addr;
+    socklen_t dest_len    = s->is_connected ? 0 : s->dest_addr_len;
+    int ret;
+
+#if HAVE_UDP_SEGMENT
+    if (s->gso && s->nb_tx - s->tx_sent > 1) {
+        union {
+            char buf[CMSG_SPACE(sizeof(uint16_t))];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = { s->tx_buf   + s->tx_offset,
+                             s->tx_bytes - s->tx_offset };
+        struct msghdr msg = { 0 };
+        struct cmsghdr *cmsg;
+
+        msg.msg_name       = dest;
+        msg.msg_namelen    = dest_len;
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        cmsg             = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = IPPROTO_UDP;
+        cmsg->cmsg_type  = UDP_SEGMENT;
+        cmsg->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+        *(uint16_t *)CMSG_DATA(cmsg) = s->tx_sizes[s->tx_sent];
+
+        if (sendmsg(s->udp_fd, &msg, 0) >= 0)
+            return s->nb_tx - s->tx_sent;
+
+        ret = ff_neterrno();
+        if (ret != AVERROR(EINVAL) && ret != AVERROR(EIO) &&
+            ret != AVERROR(ENOPROTOOPT))
+            return ret;
+        /* older kernels and devices without checksum offloading */
+        av_log(h, AV_LOG_WARNING, "Segmentation offload not supported, "
+               "sending the datagrams separately.\n");
+        s->gso = 0;
+    }
+#endif
+
+#if HAVE_SENDMMSG
+    {
+        struct mmsghdr msgs[UDP_SEND_BATCH_MAX];
+        struct iovec iovs[UDP_SEND_BATCH_MAX];
+        int i, n = s->nb_tx - s->tx_sent, offset = s->tx_offset;
+
+        memset(msgs, 0, n * sizeof(*msgs));
+        for (i = 0; i < n; i++) {
+            iovs[i].iov_base           = s->tx_buf + offset;
+            iovs[i].iov_len            = s->tx_sizes[s->tx_sent + i];
+            msgs[i].msg_hdr.msg_name    = dest;
+            msgs[i].msg_hdr.msg_namelen = dest_len;
+            msgs[i].msg_hdr.msg_iov     = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+            offset += iovs[i].iov_len;
+        }
+
+        ret = sendmmsg(s->udp_fd, msgs, n, 0);
+    }
+#else
+    ret = sendto(s->udp_fd, s->tx_buf + s->tx_offset, s->tx_sizes[s->tx_sent],
+                 0, dest, dest_len);
+    if (ret >= 0)
+        ret = 1;
+#endif
+
+    return ret < 0 ? ff_neterrno() : ret;
+}
+
+/**
+ * Send all the queued datagrams, waiting for the pacing if needed.
+ * Must be called with the mutex locked when the send thread runs.
+ */
+static int udp_flush_queue(URLContext *h, int nonblock)
+{
+    UDPContext *s = h->priv_data;
+    int i, ret;
+
+    while (s->tx_sent < s->nb_tx) {
+        if (!s->tx_sent && s->bitrate) {
+            int64_t now = av_gettime();
+            if (now < s->send_time) {
+                if (nonblock)
+                    return AVERROR(EAGAIN);
+                av_usleep(s->send_time - now);
+            } else if (now - s->send_time > UDP_PACING_MAX_LAG) {
+                /* do not burst to catch up after a stall of the input */
+                s->send_time = now;
+            }
+        }
+
+        if (!nonblock) {
+            ret = ff_network_wait_fd(s->udp_fd, 1);
+            if (ret < 0)
+                return ret;
+        }
+
+        ret = udp_send_queued(h);
+        if (ret < 0)
+            return ret;
+        s->nb_send_calls++;
+
+        for (i = 0; i < ret; i++)
+            s->tx_offset += s->tx_sizes[s->tx_sent++];
+    }
+
+    if (s->bitrate)
+        s->send_time += s->tx_bytes * 8 * INT64_C(1000000) / s->bitrate;
+    s->nb_sent += s->nb_tx;
+    s->nb_tx    = s->tx_sent = s->tx_bytes = s->tx_offset = 0;
+
+    return 0;
+}
+
+static void udp_drop_queue(UDPContext *s)
+{
+    s->nb_tx = s->tx_sent = s->tx_bytes = s->tx_offset = 0;
+}
+
+/**
+ * Time at which an incomplete batch is sent: after the batch timeout, but
+ * not before the pacing allows it.
+ */
+static int64_t udp_queue_deadline(UDPContext *s)
+{
+    int64_t t = s->tx_time + s->batch_timeout;
+    return s->bitrate ? FFMAX(t, s->send_time) : t;
+}
+
+static void udp_lock_queue(UDPContext *s)
+{
+#if HAVE_PTHREADS
+    if (s->send_thread_started)
+        pthread_mutex_lock(&s->mutex);
+#endif
+}
+
+static void udp_unlock_queue(UDPContext *s)
+{
+#if HAVE_PTHREADS
+    if (s->send_thread_started)
+        pthread_mutex_unlock(&s->mutex);
+#endif
+}
+
 /**
  * If no filename is given to av_open_input_file because you want to
  * get the local port first, then you must call this function to set
@@ -326,9 +537,18 @@ int ff_udp_set_remote_url(URLContext *h, const char *uri)
 {
     UDPContext *s = h->priv_data;
     char hostname[256], buf[10];
-    int port;
+    int port, ret;
     const char *p;
 
+    /* the queued datagrams are for the previous destination */
+    udp_lock_queue(s);
+    if (s->nb_tx && (ret = udp_flush_queue(h, h->flags & AVIO_FLAG_NONBLOCK)) < 0) {
+        udp_drop_queue(s);
+        udp_unlock_queue(s);
+        return ret;
+    }
+    udp_unlock_queue(s);
+
     av_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &port, NULL, 0, uri);
 
     /* set the destination address */
@@ -378,6 +598,20 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+static int udp_get_poll_fd(URLContext *h, int *fd, int *events)
+{
+    UDPContext *s = h->priv_data;
+
+#if HAVE_PTHREADS
+    /* the socket is read by the receiving thread, its readiness does not
+     * tell whether data is available */
+    if (s->thread_started)
+        return AVERROR(ENOSYS);
+#endif
+    *fd = s->udp_fd;
+    return 0;
+}
+
 static int parse_source_list(char *buf, char **sources, int *num_sources,
                              int max_sources)
 {
@@ -399,6 +633,283 @@ static int parse_source_list(char *buf, char **sources, int *num_sources,
     return 0;
 }
 
+#if HAVE_PTHREADS
+/**
+ * Store a datagram received by the receive thread, or drop it if the fifo
+ * is full. Must be called with the mutex locked.
+ */
+static void fifo_store(URLContext *h, uint8_t *buf, int size)
+{
+    UDPContext *s = h->priv_data;
+
+    s->nb_received++;
+    if (av_fifo_space(s->fifo) < size + (int)sizeof(size)) {
+        s->nb_overruns++;
+        if (!s->overrun_nonfatal) {
+            av_log(h, AV_LOG_ERROR, "Receive fifo overrun. Increase the "
+                   "fifo_size option, or set overrun_nonfatal to drop "
+                   "datagrams instead.\n");
+            s->error = AVERROR(EIO);
+        } else if (!s->overrun) {
+            av_log(h, AV_LOG_WARNING, "Receive fifo overrun, dropping "
+                   "datagrams.\n");
+        }
+        s->overrun = 1;
+        return;
+    }
+    s->overrun = 0;
+
+    av_fifo_generic_write(s->fifo, &size, sizeof(size), NULL);
+    av_fifo_generic_write(s->fifo, buf, size, NULL);
+}
+
+static void *receive_thread(void *arg)
+{
+    URLContext *h = arg;
+    UDPContext *s = h->priv_data;
+    int pkt_size  = h->max_packet_size;
+    uint8_t *bufs;
+    int i, n, ret = 0;
+#if HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_RECV_BATCH];
+    struct iovec iovs[UDP_RECV_BATCH];
+    int nb_bufs = UDP_RECV_BATCH;
+#else
+    int nb_bufs = 1;
+#endif
+
+    bufs = av_malloc(nb_bufs * pkt_size);
+    if (!bufs) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+#if HAVE_RECVMMSG
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < nb_bufs; i++) {
+        iovs[i].iov_base           = bufs + i * pkt_size;
+        iovs[i].iov_len            = pkt_size;
+        msgs[i].msg_hdr.msg_iov    = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+
+    for (;;) {
+        ret = ff_network_wait_fd(s->udp_fd, 0);
+
+        pthread_mutex_lock(&s->mutex);
+        if (s->quit || s->error) {
+            pthread_mutex_unlock(&s->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&s->mutex);
+
+        if (ret == AVERROR(EAGAIN))
+            continue;
+        if (ret < 0)
+            goto end;
+
+        /* drain everything the socket has in as few calls as possible */
+        do {
+#if HAVE_RECVMMSG
+            n = recvmmsg(s->udp_fd, msgs, nb_bufs, MSG_DONTWAIT, NULL);
+#else
+            n = recv(s->udp_fd, bufs, pkt_size, 0);
+            if (n >= 0) {
+                ret = n;
+                n   = 1;
+            }
+#endif
+            if (n < 0) {
+                ret = ff_neterrno();
+                if (ret == AVERROR(EAGAIN))
+                    break;
+                goto end;
+            }
+
+            pthread_mutex_lock(&s->mutex);
+            for (i = 0; i < n && !s->error; i++) {
+#if HAVE_RECVMMSG
+                ret = msgs[i].msg_len;
+#endif
+                fifo_store(h, bufs + i * pkt_size, ret);
+            }
+            pthread_cond_signal(&s->cond);
+            pthread_mutex_unlock(&s->mutex);
+        } while (n == nb_bufs && !s->error);
+    }
+    ret = 0;
+
+end:
+    av_free(bufs);
+    pthread_mutex_lock(&s->mutex);
+    if (ret < 0)
+        s->error = ret;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+static int start_receive_thread(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int ret;
+
+    s->fifo = av_fifo_alloc(s->fifo_size);
+    if (!s->fifo)
+        return AVERROR(ENOMEM);
+
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+
+    ret = pthread_create(&s->thread, NULL, receive_thread, h);
+    if (ret) {
+        av_log(h, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        pthread_mutex_destroy(&s->mutex);
+        pthread_cond_destroy(&s->cond);
+        av_fifo_free(s->fifo);
+        s->fifo = NULL;
+        return AVERROR(ret);
+    }
+    s->thread_started = 1;
+
+    return 0;
+}
+
+static void stop_receive_thread(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+
+    if (!s->thread_started)
+        return;
+
+    pthread_mutex_lock(&s->mutex);
+    s->quit = 1;
+    pthread_mutex_unlock(&s->mutex);
+    pthread_join(s->thread, NULL);
+
+    pthread_mutex_destroy(&s->mutex);
+    pthread_cond_destroy(&s->cond);
+    av_fifo_free(s->fifo);
+    s->fifo           = NULL;
+    s->thread_started = 0;
+
+    av_log(h, s->nb_overruns ? AV_LOG_WARNING : AV_LOG_VERBOSE,
+           "%"PRIu64" datagrams received, %"PRIu64" dropped on fifo "
+           "overrun.\n", s->nb_received, s->nb_overruns);
+}
+
+static int fifo_read(URLContext *h, uint8_t *buf, int size)
+{
+    UDPContext *s = h->priv_data;
+    int len, ret;
+
+    pthread_mutex_lock(&s->mutex);
+    if (!av_fifo_size(s->fifo) && !s->error &&
+        !(h->flags & AVIO_FLAG_NONBLOCK)) {
+        /* wake up regularly for the caller to check the interrupt
+         * callback */
+        int64_t t = av_gettime() + POLLING_TIME * 1000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+    }
+
+    if (av_fifo_size(s->fifo)) {
+        av_fifo_generic_read(s->fifo, &len, sizeof(len), NULL);
+        ret = FFMIN(len, size);
+        av_fifo_generic_read(s->fifo, buf, ret, NULL);
+        av_fifo_drain(s->fifo, len - ret);
+    } else
+        ret = s->error ? s->error : AVERROR(EAGAIN);
+    pthread_mutex_unlock(&s->mutex);
+
+    return ret;
+}
+
+/**
+ * Send the incomplete batches when they time out, so that a low rate output
+ * is not held until the next write.
+ */
+static void *send_thread(void *arg)
+{
+    URLContext *h = arg;
+    UDPContext *s = h->priv_data;
+    int64_t now, t;
+    int ret;
+
+    pthread_mutex_lock(&s->mutex);
+    while (!s->quit) {
+        if (!s->nb_tx || s->error) {
+            pthread_cond_wait(&s->cond, &s->mutex);
+            continue;
+        }
+
+        now = av_gettime();
+        t   = udp_queue_deadline(s);
+        if (now >= t) {
+            ret = udp_flush_queue(h, 1);
+            if (ret != AVERROR(EAGAIN)) {
+                if (ret < 0) {
+                    s->error = ret;
+                    udp_drop_queue(s);
+                }
+                continue;
+            }
+            /* the socket buffer is full, retry shortly */
+            t = now + 1000;
+        }
+
+        {
+            struct timespec tv = { .tv_sec  =  t / 1000000,
+                                   .tv_nsec = (t % 1000000) * 1000 };
+            pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+        }
+    }
+    pthread_mutex_unlock(&s->mutex);
+
+    return NULL;
+}
+
+static int start_send_thread(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int ret;
+
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+
+    ret = pthread_create(&s->thread, NULL, send_thread, h);
+    if (ret) {
+        av_log(h, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        pthread_mutex_destroy(&s->mutex);
+        pthread_cond_destroy(&s->cond);
+        return AVERROR(ret);
+    }
+    s->send_thread_started = 1;
+
+    return 0;
+}
+
+static void stop_send_thread(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+
+    if (!s->send_thread_started)
+        return;
+
+    pthread_mutex_lock(&s->mutex);
+    s->quit = 1;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    pthread_join(s->thread, NULL);
+
+    pthread_mutex_destroy(&s->mutex);
+    pthread_cond_destroy(&s->cond);
+    s->send_thread_started = 0;
+}
+#endif
+
 /* put it in UDP context */
 /* return non zero if error */
 static int udp_open(URLContext *h, const char *uri, int flags)
@@ -422,6 +933,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->ttl = 16;
     s->buffer_size = is_output ? UDP_TX_BUF_SIZE : UDP_MAX_PKT_SIZE;
+    s->batch_timeout = UDP_BATCH_TIMEOUT;
 
     p = strchr(uri, '?');
     if (p) {
@@ -451,6 +963,24 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_strlcpy(localaddr, buf, sizeof(localaddr));
         }
+        if (av_find_info_tag(buf, sizeof(buf), "fifo_size", p)) {
+            s->fifo_size = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "overrun_nonfatal", p)) {
+            s->overrun_nonfatal = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "batch", p)) {
+            s->batch = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p)) {
+            s->gso = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
+            s->bitrate = strtoll(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_timeout", p)) {
+            s->batch_timeout = strtoll(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p)) {
             if (parse_source_list(buf, include_sources, &num_include_sources,
                                   FF_ARRAY_ELEMS(include_sources)))
@@ -566,10 +1096,39 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         av_freep(&exclude_sources[i]);
 
     s->udp_fd = udp_fd;
+
+    if (is_output && (s->batch > 1 || s->bitrate > 0)) {
+        s->batch    = av_clip(s->batch, 1, UDP_SEND_BATCH_MAX);
+        s->tx_buf   = av_malloc(s->batch * h->max_packet_size);
+        s->tx_sizes = av_malloc(s->batch * sizeof(*s->tx_sizes));
+        if (!s->tx_buf || !s->tx_sizes)
+            goto fail;
+#if !HAVE_UDP_SEGMENT
+        if (s->gso)
+            av_log(h, AV_LOG_WARNING, "Segmentation offload not supported.\n");
+#endif
+#if HAVE_PTHREADS
+        if (s->batch > 1 && start_send_thread(h) < 0)
+            goto fail;
+#endif
+    }
+
+    if (!is_output && s->fifo_size > 0) {
+#if HAVE_PTHREADS
+        if (start_receive_thread(h) < 0)
+            goto fail;
+#else
+        av_log(h, AV_LOG_WARNING, "The receive fifo is not supported without "
+               "threads, reading from the socket directly.\n");
+#endif
+    }
+
     return 0;
  fail:
     if (udp_fd >= 0)
         closesocket(udp_fd);
+    av_freep(&s->tx_buf);
+    av_freep(&s->tx_sizes);
     for (i = 0; i < num_include_sources; i++)
         av_freep(&include_sources[i]);
     for (i = 0; i < num_exclude_sources; i++)
@@ -582,6 +1141,11 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     UDPContext *s = h->priv_data;
     int ret;
 
+#if HAVE_PTHREADS
+    if (s->thread_started)
+        return fifo_read(h, buf, size);
+#endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
         if (ret < 0)
@@ -591,11 +1155,76 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     return ret < 0 ? ff_neterrno() : ret;
 }
 
+/**
+ * Queue a datagram, sending the queue first if needed.
+ * @return size if the datagram was queued, 0 if it must be sent directly,
+ *         or a negative error
+ */
+static int udp_queue_write(URLContext *h, const uint8_t *buf, int size)
+{
+    UDPContext *s = h->priv_data;
+    int nonblock  = h->flags & AVIO_FLAG_NONBLOCK;
+    /* a segmented datagram is cut in segments of the size of the first
+     * one, only the last segment can be shorter */
+    int flush = s->nb_tx == s->batch || s->tx_sent ||
+                size > h->max_packet_size;
+    int ret;
+
+#if HAVE_PTHREADS
+    if (s->send_thread_started && s->error)
+        return s->error;
+#endif
+
+    if (s->gso && s->nb_tx)
+        flush |= size > s->tx_sizes[0] ||
+                 s->tx_sizes[s->nb_tx - 1] < s->tx_sizes[0] ||
+                 s->tx_bytes + size > UDP_GSO_MAX_SIZE;
+    /* without the send thread, an incomplete batch which timed out is sent
+     * on the next write */
+    if (!s->send_thread_started && s->nb_tx)
+        flush |= av_gettime() >= udp_queue_deadline(s);
+
+    if (flush && (ret = udp_flush_queue(h, nonblock)) < 0) {
+        if (ret != AVERROR(EAGAIN))
+            udp_drop_queue(s);
+        return ret;
+    }
+
+    if (size > h->max_packet_size)
+        return 0;
+
+    if (!s->nb_tx) {
+        s->tx_time = av_gettime();
+#if HAVE_PTHREADS
+        if (s->send_thread_started)
+            pthread_cond_signal(&s->cond);
+#endif
+    }
+    memcpy(s->tx_buf + s->tx_bytes, buf, size);
+    s->tx_sizes[s->nb_tx++] = size;
+    s->tx_bytes += size;
+
+    if (s->nb_tx == s->batch && (ret = udp_flush_queue(h, nonblock)) < 0 &&
+        ret != AVERROR(EAGAIN)) {
+        udp_drop_queue(s);
+        return ret;
+    }
+    return size;
+}
+
 static int udp_write(URLContext *h, const uint8_t *buf, int size)
 {
     UDPContext *s = h->priv_data;
     int ret;
 
+    if (s->tx_buf) {
+        udp_lock_queue(s);
+        ret = udp_queue_write(h, buf, size);
+        udp_unlock_queue(s);
+        if (ret)
+            return ret;
+    }
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
         if (ret < 0)
@@ -616,6 +1245,25 @@ static int udp_close(URLContext *h)
 {
     UDPContext *s = h->priv_data;
 
+#if HAVE_PTHREADS
+    stop_receive_thread(h);
+    stop_send_thread(h);
+#endif
+
+    if (s->tx_buf) {
+        int ret;
+
+        h->flags &= ~AVIO_FLAG_NONBLOCK;
+        do {
+            ret = udp_flush_queue(h, 0);
+        } while (ret == AVERROR(EAGAIN) &&
+                 !ff_check_interrupt(&h->interrupt_callback));
+        av_log(h, AV_LOG_VERBOSE, "%"PRIu64" datagrams sent in %"PRIu64
+               " calls.\n", s->nb_sent, s->nb_send_calls);
+        av_freep(&s->tx_buf);
+        av_freep(&s->tx_sizes);
+    }
+
     if (s->is_multicast && (h->flags & AVIO_FLAG_READ))
         udp_leave_multicast_group(s->udp_fd, (struct sockaddr *)&s->dest_addr);
     closesocket(s->udp_fd);
@@ -629,6 +1277,7 @@ URLProtocol ff_udp_protocol = {
     .url_write           = udp_write,
     .url_close           = udp_close,
     .url_get_file_handle = udp_get_file_handle,
+    .url_get_poll_fd     = udp_get_poll_fd,
     .priv_data_size      = sizeof(UDPContext),
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
 };
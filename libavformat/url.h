@@ -28,6 +28,7 @@
 #include "avio.h"
 #include "libavformat/version.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -48,8 +49,22 @@ typedef struct URLContext {
     int is_streamed;            /**< true if streamed (no seek possible), default = false */
     int is_connected;
     AVIOInterruptCB interrupt_callback;
+    int io_buffer_size;         /**< size of the AVIOContext buffer, 0 for the default */
 } URLContext;
 
+/**
+ * Data block of a vectored write.
+ */
+typedef struct URLIOVec {
+    const uint8_t *data;
+    int size;
+} URLIOVec;
+
+/**
+ * Maximum number of blocks passed to URLProtocol.url_writev().
+ */
+#define URL_IOV_MAX 16
+
 typedef struct URLProtocol {
     const char *name;
     int     (*url_open)( URLContext *h, const char *url, int flags);
@@ -88,6 +103,26 @@ typedef struct URLProtocol {
     const AVClass *priv_data_class;
     int flags;
     int (*url_check)(URLContext *h, int mask);
+    /**
+     * Return a reference to size bytes of the resource starting at pos,
+     * without copying them and without moving the read position. The data
+     * must be followed by FF_INPUT_BUFFER_PADDING_SIZE zeroed bytes, and
+     * must be writable without affecting the resource or the other reads.
+     * Return AVERROR(ENOSYS) if the range has to be read instead.
+     */
+    int (*url_get_buffer)(URLContext *h, int64_t pos, int size,
+                          AVBufferRef **buf);
+    /**
+     * Write the iovcnt blocks of iov in order, in a single operation if
+     * possible. Return the number of bytes written, which may be less than
+     * the total size of the blocks, or a negative error code.
+     */
+    int (*url_writev)(URLContext *h, const URLIOVec *iov, int iovcnt);
+    /**
+     * Get the file descriptor to wait on before retrying an operation which
+     * returned AVERROR(EAGAIN). See ffurl_get_poll_fd().
+     */
+    int (*url_get_poll_fd)(URLContext *h, int *fd, int *events);
 } URLProtocol;
 
 /**
@@ -163,6 +198,16 @@ int ffurl_read_complete(URLContext *h, unsigned char *buf, int size);
  */
 int ffurl_write(URLContext *h, const unsigned char *buf, int size);
 
+/**
+ * Write the iovcnt blocks of iov to the resource, in order. The blocks are
+ * handed to the protocol at once if it supports it, and written one by one
+ * otherwise.
+ *
+ * @param iovcnt number of blocks, at most URL_IOV_MAX
+ * @return the total number of bytes written, or a negative error code
+ */
+int ffurl_writev(URLContext *h, const URLIOVec *iov, int iovcnt);
+
 /**
  * Change the position that will be used by the next read/write
  * operation on the resource accessed by h.
@@ -203,6 +248,29 @@ int64_t ffurl_size(URLContext *h);
  */
 int ffurl_get_file_handle(URLContext *h);
 
+/**
+ * Get the file descriptor to wait on before retrying an operation which
+ * returned AVERROR(EAGAIN) in non-blocking mode.
+ *
+ * @param fd     set to the file descriptor
+ * @param events on input, AVIO_POLL_IN if the operation was a read and
+ *               AVIO_POLL_OUT if it was a write; on output, the
+ *               AVIO_POLL_* events to wait for, which may differ
+ * @return 0 on success, AVERROR(ENOSYS) if the protocol has no file
+ *         descriptor to wait on
+ */
+int ffurl_get_poll_fd(URLContext *h, int *fd, int *events);
+
+/**
+ * Get a reference to the data of the resource in the range
+ * [pos, pos + size), if the protocol can do it without copying it.
+ * The data is writable and followed by FF_INPUT_BUFFER_PADDING_SIZE
+ * zeroed bytes, as for URLProtocol.url_get_buffer.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the data has to be read
+ */
+int ffurl_get_buffer(URLContext *h, int64_t pos, int size, AVBufferRef **buf);
+
 /**
  * Return the file descriptors associated with this URL.
  *
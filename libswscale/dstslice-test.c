@@ -0,0 +1,180 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Scale images split into destination slices with sws_scale_dst_slice(),
+ * the way vf_scale does it, and compare them to the output of sws_scale()
+ * for the whole image. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "swscale.h"
+
+static const enum AVPixelFormat formats[] = {
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUVA420P, AV_PIX_FMT_YUV420P10LE,
+    AV_PIX_FMT_NV12, AV_PIX_FMT_GRAY8, AV_PIX_FMT_RGB24, AV_PIX_FMT_BGRA,
+};
+
+static const struct {
+    int src_w, src_h, dst_w, dst_h;
+} sizes[] = {
+    { 177, 131, 177, 131 },
+    { 177, 131,  96,  67 },
+    { 96,   67, 200, 151 },
+};
+
+static const int slice_counts[] = { 2, 3, 4 };
+
+/**
+ * Compare the visible part of two images.
+ * @return the index of the first different plane, with its first different
+ *         line in *line, or -1 if the images are identical
+ */
+static int compare(uint8_t *a[4], int a_stride[4], uint8_t *b[4],
+                   int b_stride[4], enum AVPixelFormat fmt, int w, int h,
+                   int *line)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+    int i, y;
+
+    for (i = 0; i < 4 && a[i]; i++) {
+        int linesize = av_image_get_linesize(fmt, w, i);
+        int lines    = i == 1 || i == 2 ? -(-h >> desc->log2_chroma_h) : h;
+
+        for (y = 0; y < lines; y++)
+            if (memcmp(a[i] + y * a_stride[i], b[i] + y * b_stride[i], linesize)) {
+                *line = y;
+                return i;
+            }
+    }
+    return -1;
+}
+
+static int run(enum AVPixelFormat src_fmt, enum AVPixelFormat dst_fmt,
+               int src_w, int src_h, int dst_w, int dst_h, AVLFG *lfg)
+{
+    uint8_t *src[4], *ref[4], *dst[4];
+    int src_stride[4], ref_stride[4], dst_stride[4];
+    struct SwsContext *c = NULL;
+    int i, j, n, p, y, src_size, dst_size, ret = 1;
+    char buf[128] = "";
+
+    if ((src_size = av_image_alloc(src, src_stride, src_w, src_h, src_fmt, 16)) < 0)
+        return 1;
+    if ((dst_size = av_image_alloc(ref, ref_stride, dst_w, dst_h, dst_fmt, 16)) < 0) {
+        av_freep(&src[0]);
+        return 1;
+    }
+    if (av_image_alloc(dst, dst_stride, dst_w, dst_h, dst_fmt, 16) < 0) {
+        av_freep(&src[0]);
+        av_freep(&ref[0]);
+        return 1;
+    }
+
+    for (i = 0; i < src_size; i++)
+        src[0][i] = av_lfg_get(lfg);
+    /* some converters leave the last chroma column or line untouched */
+    memset(ref[0], 0, dst_size);
+
+    c = sws_getContext(src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt,
+                       SWS_BICUBIC, NULL, NULL, NULL);
+    if (!c)
+        goto end;
+    sws_scale(c, (const uint8_t * const *)src, src_stride, 0, src_h,
+              ref, ref_stride);
+    sws_freeContext(c);
+
+    for (n = 0; n < FF_ARRAY_ELEMS(slice_counts); n++) {
+        int nb_slices = slice_counts[n];
+        int nb_rows   = dst_h / SWS_DST_SLICE_ALIGN;
+
+        if (nb_slices > nb_rows)
+            break;
+
+        memset(dst[0], 0, dst_size);
+        for (j = 0; j < nb_slices; j++) {
+            int start = (nb_rows *  j      / nb_slices) * SWS_DST_SLICE_ALIGN;
+            int end   = (nb_rows * (j + 1) / nb_slices) * SWS_DST_SLICE_ALIGN;
+
+            if (j == nb_slices - 1)
+                end = dst_h;
+
+            c = sws_getContext(src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt,
+                               SWS_BICUBIC, NULL, NULL, NULL);
+            if (!c)
+                goto end;
+            ret = sws_scale_dst_slice(c, (const uint8_t * const *)src,
+                                      src_stride, dst, dst_stride,
+                                      start, end - start);
+            sws_freeContext(c);
+            if (ret == AVERROR(ENOSYS)) {
+                snprintf(buf, sizeof(buf), " not supported");
+                ret = 0;
+                goto print;
+            }
+            if (ret != end - start) {
+                snprintf(buf, sizeof(buf), " slice %d failed", j);
+                ret = 1;
+                goto print;
+            }
+        }
+        p = compare(ref, ref_stride, dst, dst_stride, dst_fmt, dst_w, dst_h, &y);
+        if (p >= 0) {
+            snprintf(buf, sizeof(buf), " %d slices differ in plane %d line %d",
+                     nb_slices, p, y);
+            ret = 1;
+            goto print;
+        }
+        av_strlcatf(buf, sizeof(buf), " %d", nb_slices);
+    }
+    ret = 0;
+
+print:
+    printf("%s %dx%d -> %s %dx%d:%s\n",
+           av_get_pix_fmt_name(src_fmt), src_w, src_h,
+           av_get_pix_fmt_name(dst_fmt), dst_w, dst_h, buf);
+end:
+    av_freep(&src[0]);
+    av_freep(&ref[0]);
+    av_freep(&dst[0]);
+    return ret;
+}
+
+int main(void)
+{
+    AVLFG lfg;
+    int i, j, k, ret = 0;
+
+    av_lfg_init(&lfg, 1);
+
+    for (k = 0; k < FF_ARRAY_ELEMS(sizes); k++)
+        for (i = 0; i < FF_ARRAY_ELEMS(formats); i++)
+            for (j = 0; j < FF_ARRAY_ELEMS(formats); j++)
+                ret |= run(formats[i], formats[j],
+                           sizes[k].src_w, sizes[k].src_h,
+                           sizes[k].dst_w, sizes[k].dst_h, &lfg);
+
+    return ret;
+}
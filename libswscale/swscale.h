@@ -225,6 +225,42 @@ int sws_scale(struct SwsContext *c, const uint8_t *const srcSlice[],
               const int srcStride[], int srcSliceY, int srcSliceH,
               uint8_t *const dst[], const int dstStride[]);
 
+/**
+ * Required alignment of the destination slices passed to sws_scale_dst_slice().
+ */
+#define SWS_DST_SLICE_ALIGN 32
+
+/**
+ * Scale the whole source image and put the lines [dstSliceY,
+ * dstSliceY + dstSliceH) of the scaled image in dst. The other lines of dst
+ * are not touched.
+ *
+ * The output is identical to the corresponding lines of the output of
+ * sws_scale() for the whole image, so a destination image may be split into
+ * slices scaled concurrently, each with its own context created with the same
+ * parameters.
+ *
+ * @param c         the scaling context previously created with
+ *                  sws_getContext()
+ * @param src       the array containing the pointers to the planes of
+ *                  the whole source image
+ * @param srcStride the array containing the strides for each plane of
+ *                  the source image
+ * @param dst       the array containing the pointers to the planes of
+ *                  the whole destination image
+ * @param dstStride the array containing the strides for each plane of
+ *                  the destination image
+ * @param dstSliceY the first line of the destination slice, it must be a
+ *                  multiple of SWS_DST_SLICE_ALIGN
+ * @param dstSliceH the number of lines of the destination slice, it must be a
+ *                  multiple of SWS_DST_SLICE_ALIGN unless the slice ends at
+ *                  the bottom of the image
+ * @return          the height of the output slice or a negative error code
+ */
+int sws_scale_dst_slice(struct SwsContext *c, const uint8_t *const src[],
+                        const int srcStride[], uint8_t *const dst[],
+                        const int dstStride[], int dstSliceY, int dstSliceH);
+
 /**
  * @param inv_table the yuv2rgb coefficients, normally ff_yuv2rgb_coeffs[x]
  * @return -1 if not supported
@@ -349,6 +349,8 @@ typedef struct SwsContext {
     int canMMXEXTBeUsed;
 
     int dstY;                     ///< Last destination vertical line output from last slice.
+    int dstSliceY;                ///< First destination line to output, see sws_scale_dst_slice().
+    int dstSliceH;                ///< Number of destination lines to output, 0 for the whole image.
     int flags;                    ///< Flags passed by the user to select scaler algorithm, optimizations, subsampling, etc...
     void *yuvTable;             // pointer to the yuv->rgb table start so it can be freed()
     uint8_t *table_rV[256];
@@ -1150,6 +1150,72 @@ static int check_image_pointers(uint8_t *data[4], enum AVPixelFormat pix_fmt,
     return 1;
 }
 
+static void update_palette(SwsContext *c, const uint8_t *const srcSlice[])
+{
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        int r, g, b, y, u, v;
+        if (c->srcFormat == AV_PIX_FMT_PAL8) {
+            uint32_t p = ((const uint32_t *)(srcSlice[1]))[i];
+            r = (p >> 16) & 0xFF;
+            g = (p >>  8) & 0xFF;
+            b =  p        & 0xFF;
+        } else if (c->srcFormat == AV_PIX_FMT_RGB8) {
+            r = ( i >> 5     ) * 36;
+            g = ((i >> 2) & 7) * 36;
+            b = ( i       & 3) * 85;
+        } else if (c->srcFormat == AV_PIX_FMT_BGR8) {
+            b = ( i >> 6     ) * 85;
+            g = ((i >> 3) & 7) * 36;
+            r = ( i       & 7) * 36;
+        } else if (c->srcFormat == AV_PIX_FMT_RGB4_BYTE) {
+            r = ( i >> 3     ) * 255;
+            g = ((i >> 1) & 3) * 85;
+            b = ( i       & 1) * 255;
+        } else if (c->srcFormat == AV_PIX_FMT_GRAY8 ||
+                  c->srcFormat == AV_PIX_FMT_Y400A) {
+            r = g = b = i;
+        } else {
+            assert(c->srcFormat == AV_PIX_FMT_BGR4_BYTE);
+            b = ( i >> 3     ) * 255;
+            g = ((i >> 1) & 3) * 85;
+            r = ( i       & 1) * 255;
+        }
+        y = av_clip_uint8((RY * r + GY * g + BY * b + ( 33 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
+        u = av_clip_uint8((RU * r + GU * g + BU * b + (257 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
+        v = av_clip_uint8((RV * r + GV * g + BV * b + (257 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
+        c->pal_yuv[i] = y + (u << 8) + (v << 16) + (0xFFU << 24);
+
+        switch (c->dstFormat) {
+        case AV_PIX_FMT_BGR32:
+#if !HAVE_BIGENDIAN
+        case AV_PIX_FMT_RGB24:
+#endif
+            c->pal_rgb[i] =  r + (g << 8) + (b << 16) + (0xFFU << 24);
+            break;
+        case AV_PIX_FMT_BGR32_1:
+#if HAVE_BIGENDIAN
+        case AV_PIX_FMT_BGR24:
+#endif
+            c->pal_rgb[i] = 0xFF + (r << 8) + (g << 16) + ((unsigned)b << 24);
+            break;
+        case AV_PIX_FMT_RGB32_1:
+#if HAVE_BIGENDIAN
+        case AV_PIX_FMT_RGB24:
+#endif
+            c->pal_rgb[i] = 0xFF + (b << 8) + (g << 16) + ((unsigned)r << 24);
+            break;
+        case AV_PIX_FMT_RGB32:
+#if !HAVE_BIGENDIAN
+        case AV_PIX_FMT_BGR24:
+#endif
+        default:
+            c->pal_rgb[i] =  b + (g << 8) + (r << 16) + (0xFFU << 24);
+        }
+    }
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
@@ -1160,7 +1226,6 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
                                   int srcSliceH, uint8_t *const dst[],
                                   const int dstStride[])
 {
-    int i;
     const uint8_t *src2[4] = { srcSlice[0], srcSlice[1], srcSlice[2], srcSlice[3] };
     uint8_t *dst2[4] = { dst[0], dst[1], dst[2], dst[3] };
 
@@ -1185,68 +1250,8 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         if (srcSliceY == 0) c->sliceDir = 1; else c->sliceDir = -1;
     }
 
-    if (usePal(c->srcFormat)) {
-        for (i = 0; i < 256; i++) {
-            int r, g, b, y, u, v;
-            if (c->srcFormat == AV_PIX_FMT_PAL8) {
-                uint32_t p = ((const uint32_t *)(srcSlice[1]))[i];
-                r = (p >> 16) & 0xFF;
-                g = (p >>  8) & 0xFF;
-                b =  p        & 0xFF;
-            } else if (c->srcFormat == AV_PIX_FMT_RGB8) {
-                r = ( i >> 5     ) * 36;
-                g = ((i >> 2) & 7) * 36;
-                b = ( i       & 3) * 85;
-            } else if (c->srcFormat == AV_PIX_FMT_BGR8) {
-                b = ( i >> 6     ) * 85;
-                g = ((i >> 3) & 7) * 36;
-                r = ( i       & 7) * 36;
-            } else if (c->srcFormat == AV_PIX_FMT_RGB4_BYTE) {
-                r = ( i >> 3     ) * 255;
-                g = ((i >> 1) & 3) * 85;
-                b = ( i       & 1) * 255;
-            } else if (c->srcFormat == AV_PIX_FMT_GRAY8 ||
-                      c->srcFormat == AV_PIX_FMT_Y400A) {
-                r = g = b = i;
-            } else {
-                assert(c->srcFormat == AV_PIX_FMT_BGR4_BYTE);
-                b = ( i >> 3     ) * 255;
-                g = ((i >> 1) & 3) * 85;
-                r = ( i       & 1) * 255;
-            }
-            y = av_clip_uint8((RY * r + GY * g + BY * b + ( 33 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
-            u = av_clip_uint8((RU * r + GU * g + BU * b + (257 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
-            v = av_clip_uint8((RV * r + GV * g + BV * b + (257 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
-            c->pal_yuv[i] = y + (u << 8) + (v << 16) + (0xFFU << 24);
-
-            switch (c->dstFormat) {
-            case AV_PIX_FMT_BGR32:
-#if !HAVE_BIGENDIAN
-            case AV_PIX_FMT_RGB24:
-#endif
-                c->pal_rgb[i] =  r + (g << 8) + (b << 16) + (0xFFU << 24);
-                break;
-            case AV_PIX_FMT_BGR32_1:
-#if HAVE_BIGENDIAN
-            case AV_PIX_FMT_BGR24:
-#endif
-                c->pal_rgb[i] = 0xFF + (r << 8) + (g << 16) + ((unsigned)b << 24);
-                break;
-            case AV_PIX_FMT_RGB32_1:
-#if HAVE_BIGENDIAN
-            case AV_PIX_FMT_RGB24:
-#endif
-                c->pal_rgb[i] = 0xFF + (b << 8) + (g << 16) + ((unsigned)r << 24);
-                break;
-            case AV_PIX_FMT_RGB32:
-#if !HAVE_BIGENDIAN
-            case AV_PIX_FMT_BGR24:
-#endif
-            default:
-                c->pal_rgb[i] =  b + (g << 8) + (r << 16) + (0xFFU << 24);
-            }
-        }
-    }
+    if (usePal(c->srcFormat))
+        update_palette(c, srcSlice);
 
     // copy strides, so they can safely be modified
     if (c->sliceDir == 1) {
@@ -1294,6 +1299,78 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     }
 }
 
+int attribute_align_arg sws_scale_dst_slice(struct SwsContext *c,
+                                            const uint8_t *const src[],
+                                            const int srcStride[],
+                                            uint8_t *const dst[],
+                                            const int dstStride[],
+                                            int dstSliceY, int dstSliceH)
+{
+    const uint8_t *src2[4] = { src[0], src[1], src[2], src[3] };
+    uint8_t *dst2[4] = { dst[0], dst[1], dst[2], dst[3] };
+    int srcStride2[4] = { srcStride[0], srcStride[1], srcStride[2],
+                          srcStride[3] };
+    int dstStride2[4] = { dstStride[0], dstStride[1], dstStride[2],
+                          dstStride[3] };
+    int i, ret;
+
+    /* the special converters process lines in pairs and their dithering
+     * depends on the line position in the slice, so the slices have to be
+     * aligned to the dither period of the subsampled chroma planes to get
+     * the same output as sws_scale() */
+    if (dstSliceY < 0 || dstSliceH <= 0 || dstSliceY + dstSliceH > c->dstH ||
+        dstSliceY % SWS_DST_SLICE_ALIGN ||
+        (dstSliceH % SWS_DST_SLICE_ALIGN && dstSliceY + dstSliceH != c->dstH)) {
+        av_log(c, AV_LOG_ERROR, "Invalid destination slice %d+%d\n",
+               dstSliceY, dstSliceH);
+        return AVERROR(EINVAL);
+    }
+    if (!check_image_pointers(src, c->srcFormat, srcStride)) {
+        av_log(c, AV_LOG_ERROR, "bad src image pointers\n");
+        return AVERROR(EINVAL);
+    }
+    if (!check_image_pointers(dst, c->dstFormat, dstStride)) {
+        av_log(c, AV_LOG_ERROR, "bad dst image pointers\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (usePal(c->srcFormat))
+        update_palette(c, src);
+
+    /* the special converters are only used when neither scaling nor vertical
+     * filtering is needed, so each destination line only depends on the
+     * source line at the same position */
+    if (!c->vLumFilter) {
+        /* these converters treat the last lines of a slice specially */
+        if (c->swscale == yvu9ToYv12Wrapper ||
+            c->swscale == bgr24ToYv12Wrapper)
+            return AVERROR(ENOSYS);
+
+        for (i = 0; i < 4; i++) {
+            int y = (i == 1 || i == 2) ? dstSliceY >> c->chrSrcVSubSample
+                                       : dstSliceY;
+            if (src2[i] && !(i == 1 && usePal(c->srcFormat)))
+                src2[i] += y * srcStride[i];
+        }
+        reset_ptr(src2, c->srcFormat);
+        reset_ptr((const uint8_t **) dst2, c->dstFormat);
+
+        return c->swscale(c, src2, srcStride2, dstSliceY, dstSliceH,
+                          dst2, dstStride2);
+    }
+
+    reset_ptr(src2, c->srcFormat);
+    reset_ptr((const uint8_t **) dst2, c->dstFormat);
+
+    c->dstSliceY = dstSliceY;
+    c->dstSliceH = dstSliceH;
+    ret = c->swscale(c, src2, srcStride2, 0, c->srcH, dst2, dstStride2);
+    c->dstSliceY = 0;
+    c->dstSliceH = 0;
+
+    return ret;
+}
+
 /* Convert the palette to the same packed 32-bit format as the palette */
 void sws_convertPalette8ToPacked32(const uint8_t *src, uint8_t *dst,
                                    int num_pixels, const uint8_t *palette)
@@ -81,5 +81,38 @@ fate-filter-volume: CMD = md5 -i $(SRC) -af volume=precision=fixed:volume=0.5 -f
 fate-filter-volume: CMP = oneline
 fate-filter-volume: REF = 4d6ba75ef3e32d305d066b9bc771d6f4
 
+# The planar frames are split by channel between the threads of the graph
+# once they are large enough, which -filter_frame_size ensures, so the
+# threaded runs must output the same samples as the unthreaded ones.
+AFILTER_THREADS = -filter_threads 4 -filter_frame_size 16384
+
+FATE_AFILTER_THREADS-$(call FILTERDEMDECENCMUX, AFORMAT VOLUME, WAV, PCM_S16LE, PCM_S16LE, PCM_S16LE) += fate-filter-volume-planar fate-filter-volume-planar-threads
+fate-filter-volume-planar-threads: OPTS = $(AFILTER_THREADS)
+fate-filter-volume-planar fate-filter-volume-planar-threads: CMD = md5 $(OPTS) -i $(SRC) -af aformat=sample_fmts=fltp,volume=0.5 -f s16le
+fate-filter-volume-planar fate-filter-volume-planar-threads: REF = b2346d9225cd471144b28607f7ccc617
+
+FATE_AFILTER_THREADS-$(call FILTERDEMDECENCMUX, AFORMAT COMPAND, WAV, PCM_S16LE, PCM_S16LE, PCM_S16LE) += fate-filter-compand fate-filter-compand-threads
+fate-filter-compand-threads: OPTS = $(AFILTER_THREADS)
+fate-filter-compand fate-filter-compand-threads: CMD = md5 $(OPTS) -i $(SRC) -af "aformat=sample_fmts=fltp,compand=.3|.3:1|1:-90/-60|-60/-40|-40/-30|-20/-20:6:0:-90:0.2" -f s16le
+fate-filter-compand fate-filter-compand-threads: REF = 53ce0421d0c449e217fbdca668bcd3c4
+
+FATE_AFILTER_THREADS-$(call FILTERDEMDECENCMUX, AFORMAT AMIX, WAV, PCM_S16LE, PCM_F32LE, PCM_F32LE) += fate-filter-amix-planar fate-filter-amix-planar-threads
+fate-filter-amix-planar fate-filter-amix-planar-threads: tests/data/asynth-44100-2-2.wav
+fate-filter-amix-planar-threads: OPTS = $(AFILTER_THREADS)
+fate-filter-amix-planar fate-filter-amix-planar-threads: SRC1 = $(TARGET_PATH)/tests/data/asynth-44100-2-2.wav
+fate-filter-amix-planar fate-filter-amix-planar-threads: CMD = md5 $(OPTS) -i $(SRC) -i $(SRC1) -filter_complex amix,aformat=sample_fmts=fltp -f f32le
+fate-filter-amix-planar fate-filter-amix-planar-threads: REF = 8326d89ffc0ceffb37dd2d34bdba9a2f
+
+# the samples are regrouped into frames of 10000 samples, except the last one
+FATE_AFILTER_THREADS-$(call FILTERDEMDECENCMUX, ANULL, WAV, PCM_S16LE, PCM_S16LE, FRAMECRC) += fate-filter-abuffer-frame-size
+fate-filter-abuffer-frame-size: CMD = framecrc -filter_frame_size 10000 -i $(SRC) -af anull
+
+$(FATE_AFILTER_THREADS-yes): tests/data/asynth-44100-2.wav
+$(FATE_AFILTER_THREADS-yes): SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+$(filter-out fate-filter-abuffer-frame-size, $(FATE_AFILTER_THREADS-yes)): CMP = oneline
+
+FATE_AVCONV += $(FATE_AFILTER_THREADS-yes)
+fate-afilter-threads: $(FATE_AFILTER_THREADS-yes)
+
 FATE_SAMPLES_AVCONV += $(FATE_AFILTER-yes)
 fate-afilter: $(FATE_AFILTER-yes)
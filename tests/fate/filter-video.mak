@@ -18,6 +18,15 @@ fate-filter-boxblur: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf boxblur=2:1
 FATE_FILTER_VSYNTH-$(CONFIG_DRAWBOX_FILTER) += fate-filter-drawbox
 fate-filter-drawbox: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf drawbox=10:20:200:60:red@0.5
 
+# a bitmap font, rendered the same by any version of freetype
+DRAWTEXT = drawtext=fontfile=$(TARGET_PATH)/tests/data/drawtext.bdf:fontsize=9:box=1
+DRAWTEXT_TEXT = LIBAV%n0123456789-ABCDEFGHIJ-KLMNOPQRST-UVWXYZ-0123456789-ABCDEFGHIJ-KLMNOPQRST%n%tTAB%t%tS
+
+FATE_FILTER_VSYNTH-$(CONFIG_DRAWTEXT_FILTER) += fate-filter-drawtext fate-filter-drawtext-rgb
+fate-filter-drawtext fate-filter-drawtext-rgb: tests/data/drawtext.bdf
+fate-filter-drawtext: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf $(DRAWTEXT):text=$(DRAWTEXT_TEXT):x=10:y=20:shadowx=2:shadowy=1:fontcolor=red@0.7
+fate-filter-drawtext-rgb: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf format=rgb24,$(DRAWTEXT):text=$(DRAWTEXT_TEXT):boxcolor=blue@0.5:x=n*5:y=n*3
+
 FATE_FILTER_VSYNTH-$(CONFIG_FADE_FILTER) += fate-filter-fade
 fate-filter-fade: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf fade=in:0:25,fade=out:25:25
 
@@ -48,6 +57,15 @@ FATE_FILTER_VSYNTH-$(CONFIG_OVERLAY_FILTER) += fate-filter-overlay
 fate-filter-overlay: tests/data/filtergraphs/overlay
 fate-filter-overlay: CMD = framecrc -c:v pgmyuv -i $(SRC) -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay
 
+# blended with the SIMD and the C functions, against the same reference
+FATE_OVERLAY_ALPHA = fate-filter-overlay-alpha fate-filter-overlay-alpha-c
+$(FATE_OVERLAY_ALPHA): tests/data/filtergraphs/overlay-alpha
+$(FATE_OVERLAY_ALPHA): CMD = framecrc -c:v pgmyuv -i $(SRC) -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay-alpha
+fate-filter-overlay-alpha-c: CPUFLAGS = 0
+fate-filter-overlay-alpha-c: REF = $(SRC_PATH)/tests/ref/fate/filter-overlay-alpha
+
+FATE_FILTER_VSYNTH-$(call ALLYES, CROP_FILTER FORMAT_FILTER LUTYUV_FILTER OVERLAY_FILTER SHUFFLEPLANES_FILTER) += $(FATE_OVERLAY_ALPHA)
+
 FATE_FILTER_VSYNTH-$(CONFIG_SELECT_FILTER) += fate-filter-select-alternate
 fate-filter-select-alternate: tests/data/filtergraphs/select-alternate
 fate-filter-select-alternate: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_script $(TARGET_PATH)/tests/data/filtergraphs/select-alternate
@@ -84,6 +102,23 @@ FATE_FILTER_VSYNTH-$(CONFIG_TRIM_FILTER) += $(FATE_TRIM)
 FATE_FILTER_VSYNTH-$(CONFIG_UNSHARP_FILTER) += fate-filter-unsharp
 fate-filter-unsharp: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf unsharp
 
+# each test is also run with the C functions, against the same reference
+FATE_YADIF_VSYNTH += fate-filter-yadif-10bit
+fate-filter-yadif-10bit fate-filter-yadif-10bit-c: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf interlace,format=yuv420p10le,yadif=1 -sws_flags +accurate_rnd+bitexact
+
+# the widths are not a multiple of the SIMD versions' step
+FATE_YADIF_VSYNTH += fate-filter-yadif-8bit
+fate-filter-yadif-8bit fate-filter-yadif-8bit-c: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf interlace,crop=346:288:2:0,yadif=0
+
+FATE_YADIF_VSYNTH += fate-filter-yadif-10bit-nospatial
+fate-filter-yadif-10bit-nospatial fate-filter-yadif-10bit-nospatial-c: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf interlace,crop=346:288:2:0,format=yuv420p10le,yadif=3 -sws_flags +accurate_rnd+bitexact
+
+FATE_YADIF_VSYNTH_C = $(FATE_YADIF_VSYNTH:%=%-c)
+$(FATE_YADIF_VSYNTH_C): CPUFLAGS = 0
+$(FATE_YADIF_VSYNTH_C): REF = $(SRC_PATH)/tests/ref/fate/$(@:fate-%-c=%)
+
+FATE_FILTER_VSYNTH-$(call ALLYES, CROP_FILTER FORMAT_FILTER INTERLACE_FILTER YADIF_FILTER) += $(FATE_YADIF_VSYNTH) $(FATE_YADIF_VSYNTH_C)
+
 
 FATE_FILTER_VSYNTH-$(CONFIG_CROP_FILTER) += fate-filter-crop
 fate-filter-crop: CMD = video_filter "crop=iw-100:ih-100:100:100"
@@ -144,12 +179,105 @@ fate-filter-pixfmts-vflip: CMD = pixfmts
 $(FATE_FILTER_PIXFMTS): libavfilter/filtfmts-test$(EXESUF)
 FATE_FILTER_VSYNTH-$(CONFIG_FORMAT_FILTER) += $(FATE_FILTER_PIXFMTS)
 
+FATE_FILTER_FORMATS += fate-filter-formats-common
+fate-filter-formats-common: CMD = run libavfilter/graphfmts-test "color,format=rgba|yuv420p,hflip,format=yuv420p|yuva420p|rgb24,nullsink"
+
+FATE_FILTER_FORMATS += fate-filter-formats-source
+fate-filter-formats-source: CMD = run libavfilter/graphfmts-test "color,hflip,scale=32:32,format=yuv422p|bgr24|gray,nullsink"
+
+FATE_FILTER_FORMATS += fate-filter-formats-scale
+fate-filter-formats-scale: CMD = run libavfilter/graphfmts-test "color,format=rgb24|yuv444p,scale=32:32,format=yuv420p|bgr24,nullsink"
+
+FATE_FILTER_FORMATS += fate-filter-formats-autoscale
+fate-filter-formats-autoscale: CMD = run libavfilter/graphfmts-test "color,format=rgb24|yuv420p,hflip,format=yuv444p|bgr24,nullsink"
+
+$(FATE_FILTER_FORMATS): libavfilter/graphfmts-test$(EXESUF)
+FATE_FILTER_FORMATS-$(call ALLYES, COLOR_FILTER FORMAT_FILTER HFLIP_FILTER SCALE_FILTER NULLSINK_FILTER) += $(FATE_FILTER_FORMATS)
+FATE-yes += $(FATE_FILTER_FORMATS-yes)
+
+# the slice threaded filters, run with 1 and 4 threads and pipelined against
+# the same reference; the sources are cropped so that the frames have odd
+# sizes without any uninitialized pixels past their edges
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER CROP_FILTER SCALE_FILTER FORMAT_FILTER) += fate-filter-threads-scale-down
+fate-filter-threads-scale-down fate-filter-threads-scale-down-4 fate-filter-threads-scale-down-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,scale=96:67,format=yuv420p
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER CROP_FILTER SCALE_FILTER FORMAT_FILTER) += fate-filter-threads-scale-up
+fate-filter-threads-scale-up fate-filter-threads-scale-up-4 fate-filter-threads-scale-up-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv422p,scale=200:151,format=yuv410p
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER CROP_FILTER SCALE_FILTER FORMAT_FILTER) += fate-filter-threads-scale-unscaled
+fate-filter-threads-scale-unscaled fate-filter-threads-scale-unscaled-4 fate-filter-threads-scale-unscaled-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,scale=177:131,format=bgra
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER HQDN3D_FILTER) += fate-filter-threads-hqdn3d
+fate-filter-threads-hqdn3d fate-filter-threads-hqdn3d-4 fate-filter-threads-hqdn3d-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p,hqdn3d=4:3:6:4.5
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER HQDN3D_FILTER) += fate-filter-threads-hqdn3d-10bit
+fate-filter-threads-hqdn3d-10bit fate-filter-threads-hqdn3d-10bit-4 fate-filter-threads-hqdn3d-10bit-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p10le,hqdn3d=4:3:6:4.5
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER HQDN3D_FILTER) += fate-filter-threads-hqdn3d-temporal
+fate-filter-threads-hqdn3d-temporal fate-filter-threads-hqdn3d-temporal-4 fate-filter-threads-hqdn3d-temporal-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv444p16le,hqdn3d=0:0:6:4.5
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER BOXBLUR_FILTER) += fate-filter-threads-boxblur
+fate-filter-threads-boxblur fate-filter-threads-boxblur-4 fate-filter-threads-boxblur-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p,boxblur=2:1
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER UNSHARP_FILTER) += fate-filter-threads-unsharp
+fate-filter-threads-unsharp fate-filter-threads-unsharp-4 fate-filter-threads-unsharp-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p,unsharp
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER GRADFUN_FILTER) += fate-filter-threads-gradfun
+fate-filter-threads-gradfun fate-filter-threads-gradfun-4 fate-filter-threads-gradfun-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p,gradfun
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER LUTYUV_FILTER) += fate-filter-threads-lutyuv
+fate-filter-threads-lutyuv fate-filter-threads-lutyuv-4 fate-filter-threads-lutyuv-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p,lutyuv=y=negval:u=val/2
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER CROP_FILTER LUTRGB_FILTER) += fate-filter-threads-lutrgb
+fate-filter-threads-lutrgb fate-filter-threads-lutrgb-4 fate-filter-threads-lutrgb-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,lutrgb=r=negval
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER TRANSPOSE_FILTER) += fate-filter-threads-transpose
+fate-filter-threads-transpose fate-filter-threads-transpose-4 fate-filter-threads-transpose-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p,transpose=1
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER CROP_FILTER TRANSPOSE_FILTER) += fate-filter-threads-transpose-rgb
+fate-filter-threads-transpose-rgb fate-filter-threads-transpose-rgb-4 fate-filter-threads-transpose-rgb-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,transpose=2
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER COLOR_FILTER OVERLAY_FILTER) += fate-filter-threads-overlay
+fate-filter-threads-overlay fate-filter-threads-overlay-4 fate-filter-threads-overlay-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p[a];color=color=red@0.5:size=62x44,format=yuva420p[b];[a][b]overlay=13:7
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER HQDN3D_FILTER PAD_FILTER) += fate-filter-threads-pad
+fate-filter-threads-pad fate-filter-threads-pad-4 fate-filter-threads-pad-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p,hqdn3d,pad=200:150:12:8:red
+
+# the buffers are requested across the pipeline stages by pad, fps and trim
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER HQDN3D_FILTER FPS_FILTER TRIM_FILTER GRADFUN_FILTER PAD_FILTER) += fate-filter-threads-pad-chain
+fate-filter-threads-pad-chain fate-filter-threads-pad-chain-4 fate-filter-threads-pad-chain-pipeline: GRAPH = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p,hqdn3d,fps=fps=30,trim=start_frame=1,gradfun,pad=200:150:12:8:red
+
+# an even size, padded in place in the frames allocated by unsharp, except
+# when pipelined, as the buffers are then not requested across the stages
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER UNSHARP_FILTER PAD_FILTER) += fate-filter-threads-pad-inplace
+fate-filter-threads-pad-inplace fate-filter-threads-pad-inplace-4 fate-filter-threads-pad-inplace-pipeline: GRAPH = testsrc=size=176x132,format=yuv420p,unsharp,pad=200:150:12:8:red
+
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER UNSHARP_FILTER FPS_FILTER TRIM_FILTER GRADFUN_FILTER PAD_FILTER) += fate-filter-threads-pad-inplace-chain
+fate-filter-threads-pad-inplace-chain fate-filter-threads-pad-inplace-chain-4 fate-filter-threads-pad-inplace-chain-pipeline: GRAPH = testsrc=size=176x132,format=yuv420p,unsharp,fps=fps=30,trim=start_frame=1,gradfun,pad=200:150:12:8:red
+
+# fed through a buffer source one frame at a time, as avconv does
+FATE_FILTER_THREADS-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER CROP_FILTER UNSHARP_FILTER FPS_FILTER TRIM_FILTER GRADFUN_FILTER PAD_FILTER) += fate-filter-threads-buffersrc
+fate-filter-threads-buffersrc fate-filter-threads-buffersrc-4 fate-filter-threads-buffersrc-pipeline: SOURCE = testsrc=size=178x132,crop=177:131:0:0,format=yuv420p
+fate-filter-threads-buffersrc fate-filter-threads-buffersrc-4 fate-filter-threads-buffersrc-pipeline: GRAPH = unsharp,fps=fps=30,trim=start_frame=1,gradfun,pad=200:150:12:8:red
+
+FATE_FILTER_THREADS_4 = $(FATE_FILTER_THREADS-yes:%=%-4)
+FATE_FILTER_THREADS_PIPELINE = $(FATE_FILTER_THREADS-yes:%=%-pipeline)
+FATE_FILTER_THREADS_ALL = $(FATE_FILTER_THREADS-yes) $(FATE_FILTER_THREADS_4) $(FATE_FILTER_THREADS_PIPELINE)
+$(FATE_FILTER_THREADS_ALL): libavfilter/graphthreads-test$(EXESUF)
+$(FATE_FILTER_THREADS_ALL): CMD = run libavfilter/graphthreads-test -t $(THREADS) $(PIPELINE) $(if $(SOURCE),-s "$(SOURCE)") "$(GRAPH)"
+$(FATE_FILTER_THREADS-yes): THREADS = 1
+$(FATE_FILTER_THREADS_4) $(FATE_FILTER_THREADS_PIPELINE): THREADS = 4
+$(FATE_FILTER_THREADS_PIPELINE): PIPELINE = -p
+$(FATE_FILTER_THREADS_4): REF = $(SRC_PATH)/tests/ref/fate/$(@:fate-%-4=%)
+$(FATE_FILTER_THREADS_PIPELINE): REF = $(SRC_PATH)/tests/ref/fate/$(@:fate-%-pipeline=%)
+FATE-yes += $(FATE_FILTER_THREADS_ALL)
+
 
 $(FATE_FILTER_VSYNTH-yes): $(VREF)
 $(FATE_FILTER_VSYNTH-yes): SRC = $(TARGET_PATH)/tests/vsynth1/%02d.pgm
 
 FATE_AVCONV-$(call DEMDEC, IMAGE2, PGMYUV) += $(FATE_FILTER_VSYNTH-yes)
 
-fate-vfilter: $(FATE_FILTER-yes) $(FATE_FILTER_VSYNTH-yes)
+fate-vfilter: $(FATE_FILTER-yes) $(FATE_FILTER_VSYNTH-yes) $(FATE_FILTER_FORMATS-yes) $(FATE_FILTER_THREADS_ALL)
 
 fate-filter: fate-afilter fate-vfilter
@@ -1,7 +1,56 @@
+FATE_LIBAVFORMAT-$(CONFIG_ASYNC_PROTOCOL) += fate-async
+fate-async: libavformat/async-test$(EXESUF)
+fate-async: CMD = run libavformat/async-test
+
+FATE_LIBAVFORMAT-$(CONFIG_CACHE_PROTOCOL) += fate-cache
+fate-cache: libavformat/cache-test$(EXESUF)
+fate-cache: CMD = run libavformat/cache-test
+
+FATE_HLS-$(call ALLYES, HLS_DEMUXER WAV_DEMUXER PCM_S16LE_DECODER) += fate-hls-prefetch
+fate-hls-prefetch: libavformat/hls-test$(EXESUF)
+fate-hls-prefetch: CMD = run libavformat/hls-test
+FATE_LIBAVFORMAT-$(HAVE_PTHREADS) += $(FATE_HLS-yes)
+
+FATE_HTTP-$(call ALLYES, HTTP_PROTOCOL TCP_PROTOCOL) += fate-http-pool
+fate-http-pool: libavformat/http-test$(EXESUF)
+fate-http-pool: CMD = run libavformat/http-test
+FATE_LIBAVFORMAT-$(HAVE_PTHREADS) += $(FATE_HTTP-yes)
+
+FATE_LIBAVFORMAT-$(CONFIG_IO_URING) += fate-iouring
+fate-iouring: libavformat/iouring-test$(EXESUF)
+fate-iouring: CMD = run libavformat/iouring-test tests/data/fate/iouring
+
+FATE_LIBAVFORMAT-$(call ALLYES, IO_URING TCP_PROTOCOL) += fate-iouring-tcp
+fate-iouring-tcp: libavformat/tcpuring-test$(EXESUF)
+fate-iouring-tcp: CMD = run libavformat/tcpuring-test
+
+FATE_IOURING-$(call ALLYES, IO_URING RAWVIDEO_DEMUXER RAWVIDEO_DECODER RAWVIDEO_ENCODER AVI_MUXER AVI_DEMUXER) += fate-iouring-remux fate-iouring-seek
+fate-iouring-remux: tests/data/vsynth1.yuv
+fate-iouring-remux: CMD = enc_dec "rawvideo -s 352x288 -pix_fmt yuv420p -io_uring 1" tests/data/vsynth1.yuv avi "-c rawvideo -io_uring 1 -io_uring_depth 1" rawvideo "-s 352x288 -pix_fmt yuv420p -io_uring 1" -keep
+
+fate-iouring-seek: fate-iouring-remux
+fate-iouring-seek: CMD = framecrc -io_uring 1 -io_uring_depth 1 -ss 0.3 -i $(TARGET_PATH)/tests/data/fate/iouring-remux.avi -frames:v 5 -c copy
+
+FATE_AVCONV += $(FATE_IOURING-yes)
+
+# the packets of 64 KiB or more are mapped from the file instead of read
+FATE_MMAP-$(call ALLYES, FILE_PROTOCOL RAWVIDEO_DEMUXER RAWVIDEO_DECODER RAWVIDEO_ENCODER AVI_MUXER AVI_DEMUXER) += fate-mmap-remux fate-mmap-seek
+fate-mmap-remux: tests/data/vsynth1.yuv
+fate-mmap-remux: CMD = enc_dec "rawvideo -s 352x288 -pix_fmt yuv420p -mmap 1" tests/data/vsynth1.yuv avi "-c rawvideo" rawvideo "-s 352x288 -pix_fmt yuv420p" -keep
+
+fate-mmap-seek: fate-mmap-remux
+fate-mmap-seek: CMD = framecrc -mmap 1 -ss 0.3 -i $(TARGET_PATH)/tests/data/fate/mmap-remux.avi -frames:v 5
+
+FATE_AVCONV += $(FATE_MMAP-yes)
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/noproxy-test$(EXESUF)
 fate-noproxy: CMD = run libavformat/noproxy-test
 
+FATE_LIBAVFORMAT-$(CONFIG_TCP_PROTOCOL) += fate-nonblock
+fate-nonblock: libavformat/nonblock-test$(EXESUF)
+fate-nonblock: CMD = run libavformat/nonblock-test
+
 FATE_LIBAVFORMAT-yes += fate-srtp
 fate-srtp: libavformat/srtp-test$(EXESUF)
 fate-srtp: CMD = run libavformat/srtp-test
@@ -0,0 +1,6 @@
+FATE_LIBSWSCALE += fate-sws-dst-slice
+fate-sws-dst-slice: libswscale/dstslice-test$(EXESUF)
+fate-sws-dst-slice: CMD = run libswscale/dstslice-test
+
+FATE-$(CONFIG_SWSCALE) += $(FATE_LIBSWSCALE)
+fate-libswscale: $(FATE_LIBSWSCALE)
@@ -0,0 +1,145 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the throughput and the cpu cost of writing then reading several
+ * files at the same time, in chunks of MPEG-TS packets, e.g. comparing
+ * filebench -n 32 -o io_uring=1 /tmp/seg to filebench -n 32 /tmp/seg
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_GETRUSAGE
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "libavutil/dict.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+#define MAX_FILES 256
+#define CHUNK_SIZE (188 * 7 * 20)
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-n files] [-s size_per_file] [-o options] "
+            "[-r] [-w] prefix\n", argv0);
+    return ret;
+}
+
+static int64_t get_cpu_time(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return (rusage.ru_utime.tv_sec  + rusage.ru_stime.tv_sec) * 1000000LL +
+            rusage.ru_utime.tv_usec + rusage.ru_stime.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+static int run(const char *prefix, int nb_files, int64_t size,
+               const char *options, int writing)
+{
+    static uint8_t buf[CHUNK_SIZE];
+    AVIOContext *pb[MAX_FILES];
+    int64_t start_time, start_cpu, wall, cpu, done;
+    char filename[1024], errbuf[50];
+    int i, ret;
+
+    start_time = av_gettime();
+    start_cpu  = get_cpu_time();
+    for (i = 0; i < nb_files; i++) {
+        AVDictionary *opts = NULL;
+        av_dict_parse_string(&opts, options, "=", ":", 0);
+        snprintf(filename, sizeof(filename), "%s%03d.ts", prefix, i);
+        ret = avio_open2(&pb[i], filename,
+                         writing ? AVIO_FLAG_WRITE : AVIO_FLAG_READ, NULL, &opts);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            av_strerror(ret, errbuf, sizeof(errbuf));
+            fprintf(stderr, "Unable to open %s: %s\n", filename, errbuf);
+            return 1;
+        }
+    }
+
+    memset(buf, 0x47, sizeof(buf));
+    for (done = 0; done < size; done += CHUNK_SIZE) {
+        for (i = 0; i < nb_files; i++) {
+            if (writing) {
+                avio_write(pb[i], buf, CHUNK_SIZE);
+            } else if (avio_read(pb[i], buf, CHUNK_SIZE) != CHUNK_SIZE) {
+                fprintf(stderr, "Short read in file %d\n", i);
+                return 1;
+            }
+        }
+    }
+    for (i = 0; i < nb_files; i++)
+        avio_close(pb[i]);
+    wall = av_gettime() - start_time;
+    cpu  = get_cpu_time() - start_cpu;
+
+    printf("%s %d files of %"PRId64" bytes in %.3f s: %.1f MB/s",
+           writing ? "wrote" : "read", nb_files, done, wall / 1000000.0,
+           (double)done * nb_files / FFMAX(wall, 1));
+    if (HAVE_GETRUSAGE)
+        printf(", cpu %.3f s", cpu / 1000000.0);
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_files = 16, do_read = 1, do_write = 1, i;
+    int64_t size = 32 << 20;
+    const char *prefix = NULL, *options = "";
+
+    av_register_all();
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            nb_files = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            size = strtoll(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            options = argv[++i];
+        } else if (!strcmp(argv[i], "-r")) {
+            do_write = 0;
+        } else if (!strcmp(argv[i], "-w")) {
+            do_read = 0;
+        } else if (!prefix) {
+            prefix = argv[i];
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (!prefix || nb_files <= 0 || nb_files > MAX_FILES || size <= 0)
+        return usage(argv[0], 1);
+
+    if (do_write && run(prefix, nb_files, size, options, 1))
+        return 1;
+    if (do_read && run(prefix, nb_files, size, options, 0))
+        return 1;
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the throughput and the cpu cost of a packet output protocol,
+ * e.g. with udp://127.0.0.1:1234?pkt_size=1316&batch=32
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_GETRUSAGE
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-n packets] [-s packet_size] output_url\n", argv0);
+    return ret;
+}
+
+static int64_t get_cpu_time(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return (rusage.ru_utime.tv_sec  + rusage.ru_stime.tv_sec) * 1000000LL +
+            rusage.ru_utime.tv_usec + rusage.ru_stime.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    int nb_packets = 100000, packet_size = 1316, ret, i;
+    const char *output_url = NULL;
+    int64_t start_time, start_cpu, wall, cpu;
+    double mbits;
+    uint8_t buf[65536];
+    char errbuf[50];
+    AVIOContext *output;
+
+    av_register_all();
+    avformat_network_init();
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            nb_packets = atoi(argv[i + 1]);
+            i++;
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            packet_size = atoi(argv[i + 1]);
+            i++;
+        } else if (!output_url) {
+            output_url = argv[i];
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (!output_url || packet_size <= 0 || packet_size > sizeof(buf))
+        return usage(argv[0], 1);
+
+    ret = avio_open2(&output, output_url, AVIO_FLAG_WRITE, NULL, NULL);
+    if (ret) {
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        fprintf(stderr, "Unable to open %s: %s\n", output_url, errbuf);
+        return 1;
+    }
+
+    memset(buf, 0x47, packet_size);
+    start_time = av_gettime();
+    start_cpu  = get_cpu_time();
+    for (i = 0; i < nb_packets; i++) {
+        avio_write(output, buf, packet_size);
+        avio_flush(output);
+    }
+    avio_close(output);
+    wall = av_gettime() - start_time;
+    cpu  = get_cpu_time() - start_cpu;
+
+    mbits = (double)nb_packets * packet_size * 8 / 1000000;
+    printf("%d packets of %d bytes in %.3f s: %.0f packets/s, %.1f Mbit/s\n",
+           nb_packets, packet_size, wall / 1000000.0,
+           nb_packets * 1000000.0 / FFMAX(wall, 1), mbits * 1000000 / FFMAX(wall, 1));
+    if (HAVE_GETRUSAGE)
+        printf("cpu: %.3f s, %.3f ms per Mbit\n", cpu / 1000000.0,
+               cpu / 1000.0 / mbits);
+
+    avformat_network_deinit();
+    return 0;
+}